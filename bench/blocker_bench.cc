@@ -0,0 +1,139 @@
+// Throughput and latency benchmark for the whole blocker: every layer,
+// without the decision cache, run through the batch API on a growing
+// number of threads over a corpus of recorded requests.
+//
+// Usage: blocker_bench [corpus.tsv] [requests]
+
+#include "network_blocker.h"
+#include "adblockplus_integration.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+  gchar **fields;       // origin, type, url
+  RequestContext context;
+} CorpusEntry;
+
+static guint64 now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000000ull + (guint64)ts.tv_nsec;
+}
+
+// Corpus lines are "origin<TAB>type<TAB>url"
+static GArray* load_corpus(const char *path) {
+  gchar *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return NULL;
+  }
+
+  GArray *entries = g_array_new(FALSE, FALSE, sizeof(CorpusEntry));
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  for (int i = 0; lines[i] != NULL; i++) {
+    if (lines[i][0] == '\0' || lines[i][0] == '#') continue;
+    gchar **fields = g_strsplit(lines[i], "\t", 3);
+    if (g_strv_length(fields) != 3) {
+      g_strfreev(fields);
+      continue;
+    }
+
+    CorpusEntry entry;
+    entry.fields = fields;
+    entry.context.first_party = fields[0];
+    entry.context.type = network_blocker_type_from_destination(fields[1]);
+    entry.context.uri = fields[2];
+    entry.context.third_party = -1;
+    g_array_append_val(entries, entry);
+  }
+  g_strfreev(lines);
+  g_free(contents);
+  return entries;
+}
+
+static gint compare_guint64(gconstpointer a, gconstpointer b) {
+  guint64 x = *(const guint64 *)a, y = *(const guint64 *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Single requests one at a time: the latency a caller sees per decision
+static void measure_latency(const AbpEngine *engine, const RequestContext *contexts, guint count) {
+  guint64 *samples = g_new(guint64, count);
+  for (guint i = 0; i < count; i++) {
+    BlockVerdict verdict;
+    guint64 start = now_ns();
+    should_block_requests(engine, &contexts[i], &verdict, 1, 1);
+    samples[i] = now_ns() - start;
+  }
+  qsort(samples, count, sizeof(guint64), compare_guint64);
+  printf("latency          p50 %6lu ns   p99 %6lu ns   max %7lu ns\n", samples[count / 2],
+         samples[(gsize)count * 99 / 100], samples[count - 1]);
+  g_free(samples);
+}
+
+// One batch on n_threads. Verdicts are compared with the single-threaded
+// run so a data race shows up as a mismatch count.
+static void measure_throughput(const AbpEngine *engine, const RequestContext *contexts, guint count,
+                               guint n_threads, gboolean *reference) {
+  BlockVerdict *verdicts = g_new(BlockVerdict, count);
+  guint64 start = now_ns();
+  should_block_requests(engine, contexts, verdicts, count, n_threads);
+  guint64 elapsed = now_ns() - start;
+
+  guint blocked = 0, mismatches = 0;
+  for (guint i = 0; i < count; i++) {
+    blocked += verdicts[i].blocked;
+    if (reference[i] == -1) reference[i] = verdicts[i].blocked;
+    else if (reference[i] != verdicts[i].blocked) mismatches++;
+  }
+  printf("threads %3u  %12.0f URLs/s   blocked %u/%u  mismatches %u\n", n_threads,
+         count * 1e9 / (elapsed > 0 ? elapsed : 1), blocked, count, mismatches);
+  g_free(verdicts);
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "bench/corpus.tsv";
+  int requests_arg = argc > 2 ? atoi(argv[2]) : 200000;
+  if (requests_arg <= 0) {
+    fprintf(stderr, "blocker_bench: requests must be a positive number\n");
+    return 1;
+  }
+  guint requests = (guint)requests_arg;
+
+  GArray *corpus = load_corpus(path);
+  if (!corpus || corpus->len == 0) {
+    fprintf(stderr, "blocker_bench: cannot read corpus %s\n", path);
+    return 1;
+  }
+
+  network_blocker_init();
+  adblockplus_init();
+  AbpEngine *engine = adblockplus_acquire_engine();
+
+  // Repeat the corpus up to the requested size
+  RequestContext *contexts = g_new(RequestContext, requests);
+  for (guint i = 0; i < requests; i++) {
+    contexts[i] = g_array_index(corpus, CorpusEntry, i % corpus->len).context;
+  }
+  printf("Corpus: %u requests, replayed to %u\n", corpus->len, requests);
+
+  measure_latency(engine, contexts, MIN(requests, 20000u));
+
+  gboolean *reference = g_new(gboolean, requests);
+  for (guint i = 0; i < requests; i++) reference[i] = -1;
+  guint cpus = g_get_num_processors();
+  for (guint n_threads = 1; ; n_threads *= 2) {
+    measure_throughput(engine, contexts, requests, MIN(n_threads, cpus), reference);
+    if (n_threads >= cpus) break;
+  }
+
+  g_free(reference);
+  g_free(contexts);
+  abp_engine_unref(engine);
+  for (guint i = 0; i < corpus->len; i++) {
+    g_strfreev(g_array_index(corpus, CorpusEntry, i).fields);
+  }
+  g_array_free(corpus, TRUE);
+  return 0;
+}
@@ -0,0 +1,168 @@
+// Microbenchmark for the URL and script pattern layers: the original
+// strcasestr loops, the Aho-Corasick automaton and every literal matcher
+// kernel the CPU supports, run over a corpus of recorded request URLs.
+//
+// Usage: pattern_bench [corpus.tsv] [rounds]
+
+#include "pattern_matcher.h"
+#include "literal_matcher.h"
+#include "url_patterns.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define LAYER_URL 1
+#define LAYER_SCRIPT 2
+#define RULE_ID(layer, index) (((guint32)(layer) << 24) | (guint32)(index))
+#define RULE_LAYER(id) ((id) >> 24)
+
+typedef gboolean (*MatchFunc)(gpointer matcher, const char *url, gsize len);
+
+// Corpus lines are "origin<TAB>type<TAB>url"; only the URL is used here
+static GPtrArray* load_corpus(const char *path, gsize *total_bytes) {
+  gchar *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return NULL;
+  }
+
+  GPtrArray *urls = g_ptr_array_new_with_free_func(g_free);
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  *total_bytes = 0;
+  for (int i = 0; lines[i] != NULL; i++) {
+    if (lines[i][0] == '\0' || lines[i][0] == '#') continue;
+    const char *url = strrchr(lines[i], '\t');
+    url = url ? url + 1 : lines[i];
+    g_ptr_array_add(urls, g_strdup(url));
+    *total_bytes += strlen(url);
+  }
+  g_strfreev(lines);
+  g_free(contents);
+  return urls;
+}
+
+// Original layer code: one strcasestr per pattern, script patterns only
+// for URLs containing ".js"
+static gboolean match_strcasestr(gpointer, const char *url, gsize) {
+  for (int i = 0; BLOCKED_URL_PATTERNS[i] != NULL; i++) {
+    if (strcasestr(url, BLOCKED_URL_PATTERNS[i]) != NULL) return TRUE;
+  }
+  if (strstr(url, ".js")) {
+    for (int i = 0; BLOCKED_SCRIPT_PATTERNS[i] != NULL; i++) {
+      if (strcasestr(url, BLOCKED_SCRIPT_PATTERNS[i]) != NULL) return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+typedef struct {
+  gboolean is_script;
+  gboolean found;
+} ScanState;
+
+static gboolean on_match(guint32 id, gsize, gpointer user_data) {
+  ScanState *state = (ScanState *)user_data;
+  if (RULE_LAYER(id) == LAYER_SCRIPT && !state->is_script) return FALSE;
+  state->found = TRUE;
+  return TRUE;
+}
+
+static gboolean match_automaton(gpointer matcher, const char *url, gsize len) {
+  ScanState state = { strstr(url, ".js") != NULL, FALSE };
+  pattern_matcher_scan((const PatternMatcher *)matcher, url, len, on_match, &state);
+  return state.found;
+}
+
+static gboolean match_literals(gpointer matcher, const char *url, gsize len) {
+  ScanState state = { strstr(url, ".js") != NULL, FALSE };
+  literal_matcher_scan((const LiteralMatcher *)matcher, url, len, on_match, &state);
+  return state.found;
+}
+
+static void add_patterns(gpointer matcher, gboolean literal) {
+  const char **layers[] = { BLOCKED_URL_PATTERNS, BLOCKED_SCRIPT_PATTERNS };
+  for (int layer = 0; layer < 2; layer++) {
+    for (int i = 0; layers[layer][i] != NULL; i++) {
+      guint32 id = RULE_ID(layer + 1, i);
+      if (literal) literal_matcher_add((LiteralMatcher *)matcher, layers[layer][i], id);
+      else pattern_matcher_add((PatternMatcher *)matcher, layers[layer][i], id);
+    }
+  }
+}
+
+// Run func over the corpus and print its cost. Verdicts are compared with
+// the reference run so a kernel bug shows up as a mismatch count.
+static void run(const char *name, MatchFunc func, gpointer matcher, GPtrArray *urls,
+                gsize total_bytes, int rounds, gboolean *reference) {
+  gsize *lens = g_new(gsize, urls->len);
+  for (guint i = 0; i < urls->len; i++) {
+    lens[i] = strlen((const char *)g_ptr_array_index(urls, i));
+  }
+
+  guint blocked = 0, mismatches = 0;
+  for (guint i = 0; i < urls->len; i++) {
+    gboolean verdict = func(matcher, (const char *)g_ptr_array_index(urls, i), lens[i]);
+    blocked += verdict;
+    if (verdict != reference[i]) mismatches++;
+  }
+
+  volatile guint sink = 0;
+  gint64 start = g_get_monotonic_time();
+  for (int r = 0; r < rounds; r++) {
+    for (guint i = 0; i < urls->len; i++) {
+      sink += func(matcher, (const char *)g_ptr_array_index(urls, i), lens[i]);
+    }
+  }
+  gint64 elapsed = g_get_monotonic_time() - start;
+
+  double lookups = (double)rounds * urls->len;
+  printf("%-16s %9.1f ns/url %9.1f MB/s   blocked %u/%u  mismatches %u\n", name,
+         elapsed * 1000.0 / lookups, (double)total_bytes * rounds / (elapsed > 0 ? elapsed : 1),
+         blocked, urls->len, mismatches);
+  g_free(lens);
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "bench/corpus.tsv";
+  int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+
+  gsize total_bytes = 0;
+  GPtrArray *urls = load_corpus(path, &total_bytes);
+  if (!urls || urls->len == 0) {
+    fprintf(stderr, "pattern_bench: cannot read corpus %s\n", path);
+    return 1;
+  }
+  printf("Corpus: %u URLs, %.1f bytes average, %d rounds\n", urls->len,
+         (double)total_bytes / urls->len, rounds);
+
+  gboolean *reference = g_new(gboolean, urls->len);
+  for (guint i = 0; i < urls->len; i++) {
+    const char *url = (const char *)g_ptr_array_index(urls, i);
+    reference[i] = match_strcasestr(NULL, url, strlen(url));
+  }
+
+  PatternMatcher *automaton = pattern_matcher_new();
+  add_patterns(automaton, FALSE);
+  pattern_matcher_compile(automaton);
+
+  LiteralMatcher *literals = literal_matcher_new();
+  add_patterns(literals, TRUE);
+  literal_matcher_compile(literals);
+  LiteralScanImpl best = literal_matcher_get_impl(literals);
+
+  run("strcasestr", match_strcasestr, NULL, urls, total_bytes, rounds, reference);
+  run("aho-corasick", match_automaton, automaton, urls, total_bytes, rounds, reference);
+  for (int impl = LITERAL_SCAN_SCALAR; impl <= LITERAL_SCAN_AVX2; impl++) {
+    if (!literal_matcher_set_impl(literals, (LiteralScanImpl)impl)) continue;
+    gchar *name = g_strdup_printf("literal-%s%s", literal_scan_impl_name((LiteralScanImpl)impl),
+                                  impl == (int)best ? "*" : "");
+    run(name, match_literals, literals, urls, total_bytes, rounds, reference);
+    g_free(name);
+  }
+
+  pattern_matcher_free(automaton);
+  literal_matcher_free(literals);
+  g_free(reference);
+  g_ptr_array_free(urls, TRUE);
+  return 0;
+}
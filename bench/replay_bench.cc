@@ -0,0 +1,206 @@
+// Replay benchmark for the blocking pipeline: every request of the corpus
+// goes through each layer on its own (tracker domains, the URL and script
+// pattern layers, EasyList) and through the whole pipeline without the
+// decision cache. Requests run in corpus order on one thread, so the match
+// counts and the verdict digest only change when lists or engines do and
+// can be compared across commits; timings and allocations are the measured
+// part. The filter lists (EasyList, EasyPrivacy, unbreak) are read from
+// fang/ relative to the working directory, the optional tracker list and
+// the snapshots from ~/.local/share/vaxp-browser/adblock, so compare runs
+// from the same directory with the same HOME (an empty one skips the
+// tracker list).
+//
+// Usage: replay_bench [corpus.tsv] [rounds]
+
+#include "network_blocker.h"
+#include "tracker_domains.h"
+#include "adblockplus_integration.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Count heap allocations by interposing the allocator. glib allocates
+// through malloc, so every g_new and g_strdup is seen.
+static guint64 allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void *ptr, size_t size);
+
+void* malloc(size_t size) {
+  allocations++;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+  allocations++;
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void *ptr, size_t size) {
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+}
+#define COUNTS_ALLOCATIONS TRUE
+#else
+#define COUNTS_ALLOCATIONS FALSE
+#endif
+
+typedef struct {
+  gchar **fields;       // origin, type, url
+  RequestContext context;
+  ParsedUrl url;
+  gboolean parsed;
+} CorpusEntry;
+
+static guint64 now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000000ull + (guint64)ts.tv_nsec;
+}
+
+// Corpus lines are "origin<TAB>type<TAB>url". Entries are parsed in place
+// since a ParsedUrl points into itself.
+static CorpusEntry* load_corpus(const char *path, guint *count) {
+  gchar *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return NULL;
+  }
+
+  gchar **lines = g_strsplit(contents, "\n", -1);
+  CorpusEntry *entries = g_new0(CorpusEntry, g_strv_length(lines));
+  guint n = 0;
+  for (int i = 0; lines[i] != NULL; i++) {
+    if (lines[i][0] == '\0' || lines[i][0] == '#') continue;
+    gchar **fields = g_strsplit(lines[i], "\t", 3);
+    if (g_strv_length(fields) != 3) {
+      g_strfreev(fields);
+      continue;
+    }
+
+    CorpusEntry *entry = &entries[n++];
+    entry->fields = fields;
+    entry->context.first_party = fields[0];
+    entry->context.type = network_blocker_type_from_destination(fields[1]);
+    entry->context.uri = fields[2];
+    entry->context.third_party = -1;
+    entry->parsed = url_parser_parse(&entry->url, fields[2]);
+  }
+  g_strfreev(lines);
+  g_free(contents);
+  *count = n;
+  return entries;
+}
+
+typedef enum {
+  BENCH_TRACKER,
+  BENCH_PATTERNS,
+  BENCH_EASYLIST,
+  BENCH_PIPELINE,
+  N_BENCH_LAYERS
+} BenchLayer;
+
+static const char *LAYER_NAMES[N_BENCH_LAYERS] = {
+  "tracker domains", "url/script patterns", "easylist", "full pipeline"
+};
+
+static AbpEngine *engine = NULL;
+
+// Run one layer on one request. Unparsable URLs are allowed by every layer.
+static gboolean run_layer(BenchLayer layer, const CorpusEntry *entry) {
+  switch (layer) {
+    case BENCH_TRACKER:
+      return entry->parsed && network_blocker_match_layer(BLOCK_LAYER_TRACKER_DOMAIN, &entry->url,
+                                                          entry->context.type, NULL);
+    case BENCH_PATTERNS:
+      return entry->parsed && network_blocker_match_layer(BLOCK_LAYER_URL_PATTERN, &entry->url,
+                                                          entry->context.type, NULL);
+    case BENCH_EASYLIST:
+      return entry->parsed && network_blocker_match_layer(BLOCK_LAYER_EASYLIST, &entry->url,
+                                                          entry->context.type, NULL);
+    default: {
+      BlockVerdict verdict;
+      should_block_requests(engine, &entry->context, &verdict, 1, 1);
+      return verdict.blocked;
+    }
+  }
+}
+
+static gint compare_guint64(gconstpointer a, gconstpointer b) {
+  guint64 x = *(const guint64 *)a, y = *(const guint64 *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Replay the corpus rounds times through layer. Verdicts of the first round
+// are folded into digest, in corpus order.
+static void replay_layer(BenchLayer layer, const CorpusEntry *entries, guint count, guint rounds,
+                         guint32 *digest) {
+  guint total = count * rounds;
+  guint64 *samples = g_new(guint64, total);
+  guint blocked = 0;
+
+  // One untimed pass warms caches and lazily built state
+  for (guint i = 0; i < count; i++) run_layer(layer, &entries[i]);
+
+  guint64 allocations_before = allocations;
+  guint64 start = now_ns();
+  for (guint r = 0; r < rounds; r++) {
+    for (guint i = 0; i < count; i++) {
+      guint64 t = now_ns();
+      gboolean hit = run_layer(layer, &entries[i]);
+      samples[r * count + i] = now_ns() - t;
+      if (r == 0) {
+        blocked += hit;
+        *digest = (*digest ^ (guint32)(hit + 1)) * 16777619u;
+      }
+    }
+  }
+  guint64 elapsed = now_ns() - start;
+  guint64 allocated = allocations - allocations_before;
+
+  qsort(samples, total, sizeof(guint64), compare_guint64);
+  printf("%-20s  blocked %5u  allowed %5u  %10.0f req/s  p50 %6lu  p90 %6lu  p99 %6lu  max %7lu ns",
+         LAYER_NAMES[layer], blocked, count - blocked, total * 1e9 / (elapsed > 0 ? elapsed : 1),
+         samples[total / 2], samples[(gsize)total * 9 / 10], samples[(gsize)total * 99 / 100],
+         samples[total - 1]);
+  if (COUNTS_ALLOCATIONS) printf("  %.2f allocs/req", (double)allocated / total);
+  printf("\n");
+  g_free(samples);
+}
+
+int main(int argc, char **argv) {
+  const char *path = argc > 1 ? argv[1] : "bench/corpus.tsv";
+  guint rounds = argc > 2 ? (guint)MAX(atoi(argv[2]), 1) : 200;
+
+  guint count = 0;
+  CorpusEntry *entries = load_corpus(path, &count);
+  if (!entries || count == 0) {
+    fprintf(stderr, "replay_bench: cannot read corpus %s\n", path);
+    return 1;
+  }
+
+  network_blocker_init();
+  adblockplus_init();
+
+  engine = adblockplus_acquire_engine();
+  printf("Corpus: %u requests x %u rounds, %d tracker domains, %u EasyList filters\n", count, rounds,
+         tracker_domains_get_count(), abp_engine_get_filter_count(engine));
+
+  guint32 digest = 2166136261u;
+  for (int layer = 0; layer < N_BENCH_LAYERS; layer++) {
+    replay_layer((BenchLayer)layer, entries, count, rounds, &digest);
+  }
+  printf("Verdict digest: %08x\n", digest);
+
+  abp_engine_unref(engine);
+  for (guint i = 0; i < count; i++) {
+    url_parser_clear(&entries[i].url);
+    g_strfreev(entries[i].fields);
+  }
+  g_free(entries);
+  return 0;
+}
@@ -0,0 +1,1279 @@
+#include "abp_engine.h"
+#include "snapshot.h"
+#include "rule_profiler.h"
+#include "bloom_filter.h"
+#include "lazy_dfa.h"
+#include "redirect_resources.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ABP_NONE G_MAXUINT32
+// URL tokens kept on the stack; longer URLs move them to the heap
+#define URL_TOKENS_INLINE 128
+
+// Bytes of DFA states kept for regex and untokenized wildcard filters
+#define AUTOMATON_MEMORY_LIMIT (2 * 1024 * 1024)
+
+enum {
+  FILTER_EXCEPTION    = 1 << 0,
+  FILTER_HOST_ANCHOR  = 1 << 1,  // ||
+  FILTER_START_ANCHOR = 1 << 2,  // leading |
+  FILTER_END_ANCHOR   = 1 << 3,  // trailing |
+  FILTER_MATCH_CASE   = 1 << 4,
+  FILTER_IMPORTANT    = 1 << 5,
+  FILTER_THIRD_PARTY  = 1 << 6,
+  FILTER_FIRST_PARTY  = 1 << 7,
+  FILTER_PLAIN        = 1 << 8,  // no '*' or '^' in the pattern
+  FILTER_REGEX        = 1 << 9,  // /regex/, pattern holds the expression
+  FILTER_AUTOMATON    = 1 << 10  // matched by the automaton, not the index
+};
+
+// Fixed-size filter record. Strings live in the pool: the pattern usually
+// points into the original line, and filters with the same $domain= list
+// share one run of AbpDomain entries.
+typedef struct {
+  guint32 text;         // pool offset of the original filter line
+  guint32 pattern;      // pool offset of the normalized pattern, not terminated
+  guint32 domains;      // first AbpDomain of the $domain= option
+  guint16 pattern_len;
+  guint16 n_domains;
+  guint16 flags;
+  guint16 types;        // AbpResourceType mask
+} AbpFilter;
+
+typedef struct {
+  guint32 name;         // pool offset, lowercase
+  guint16 len;
+  guint16 exclude;      // ~example.com
+} AbpDomain;
+
+// Slot of the open-addressed token index: the filters bucketed under a
+// token are ids[start .. start + count). count 0 marks an empty slot.
+typedef struct {
+  guint32 hash;
+  guint32 start;
+  guint32 count;
+} TokenBucket;
+
+// Index 0 holds blocking filters, index 1 exceptions
+enum { KIND_BLOCK = 0, KIND_EXCEPTION = 1 };
+
+// Filters are indexed per request partition: the resource type they apply
+// to and the party they are restricted to. A request only probes its own
+// partitions and the catch-all ones, so a navigation never visits
+// image-only or script-only filters. Type slot 0 holds filters for more
+// than PARTITION_MAX_TYPES types, slot n + 1 those for type bit n.
+#define PARTITION_TYPE_SLOTS 13
+#define PARTITION_MAX_TYPES 3
+enum { PARTY_ANY = 0, PARTY_FIRST = 1, PARTY_THIRD = 2 };
+
+// Index key of filters without a usable token
+#define UNTOKENIZED_HASH 0u
+
+// Sizes and positions of the compiled tables. Stored as is in snapshots.
+typedef struct {
+  guint32 n_filters;
+  guint32 n_domains;
+  guint32 n_buckets[2];       // power of two
+  guint32 n_ids;
+  guint32 unsupported;
+  guint32 has_important;
+
+  // Pool bytes by use, and bytes saved by sharing strings
+  guint32 pool_text;
+  guint32 pool_patterns;
+  guint32 pool_domains;
+  guint32 pool_shared;
+} AbpTables;
+
+enum {
+  SECTION_TABLES = 1,
+  SECTION_FILTERS,
+  SECTION_DOMAINS,
+  SECTION_POOL,
+  SECTION_BLOCK_BUCKETS,
+  SECTION_EXCEPTION_BUCKETS,
+  SECTION_IDS
+};
+
+struct AbpEngine {
+  // Build state. After compile the arrays back the tables below; they
+  // are NULL for an engine opened from a snapshot.
+  GArray *filters;
+  GArray *domains;
+  GString *pool;
+  gboolean compiled;
+
+  // Interned pool strings and $domain= runs while building, dropped by
+  // compile. Keys are the text, values the offset or run start plus one.
+  GHashTable *strings;
+  GHashTable *domain_runs;
+
+  // Compiled tables. Everything is referenced by offset so the same arrays
+  // can be written to a snapshot and used from its mapping. Buckets and ids
+  // are heap allocated unless snapshot is set.
+  AbpTables tables;
+  const AbpFilter *filter_table;
+  const AbpDomain *domain_table;
+  const char *pool_data;
+  gsize pool_len;
+  const TokenBucket *buckets[2];
+  const guint32 *ids;
+  Snapshot *snapshot;
+
+  // Keys of the non-empty blocking buckets. Most URLs allowed by the lists
+  // have no token with a blocking bucket and never touch the index.
+  BloomFilter *block_prefilter;
+  gboolean has_exceptions;
+
+  // Regex filters and wildcard filters without a token, searched in one
+  // pass over the URL instead of one by one on every request. Rebuilt from
+  // the FILTER_AUTOMATON filters when opening a snapshot.
+  LazyDfa *automaton;
+
+  // Readers may hold an engine while a reload replaces it
+  gint ref_count;
+};
+
+// Request data shared by every filter test
+typedef struct {
+  const char *url;
+  const char *lower;          // lowercased copy of url
+  gsize len;
+  gsize host_start;
+  gsize host_end;
+  const char *document_host;
+  gsize document_host_len;
+  guint type;
+  gint third_party;
+} UrlInfo;
+
+static const struct {
+  const char *name;
+  guint type;
+} TYPE_OPTIONS[] = {
+  { "other", ABP_TYPE_OTHER },
+  { "script", ABP_TYPE_SCRIPT },
+  { "image", ABP_TYPE_IMAGE },
+  { "stylesheet", ABP_TYPE_STYLESHEET },
+  { "css", ABP_TYPE_STYLESHEET },
+  { "object", ABP_TYPE_OBJECT },
+  { "object-subrequest", ABP_TYPE_OBJECT },
+  { "subdocument", ABP_TYPE_SUBDOCUMENT },
+  { "frame", ABP_TYPE_SUBDOCUMENT },
+  { "document", ABP_TYPE_DOCUMENT },
+  { "doc", ABP_TYPE_DOCUMENT },
+  { "xmlhttprequest", ABP_TYPE_XMLHTTPREQUEST },
+  { "xhr", ABP_TYPE_XMLHTTPREQUEST },
+  { "media", ABP_TYPE_MEDIA },
+  { "font", ABP_TYPE_FONT },
+  { "websocket", ABP_TYPE_WEBSOCKET },
+  { "ping", ABP_TYPE_PING },
+  { "beacon", ABP_TYPE_PING },
+  { NULL, 0 }
+};
+
+// Tokens present in almost every URL make poor index keys
+static const char *BAD_TOKENS[] = {
+  "com", "http", "https", "icon", "images", "img", "js", "net", "news", "www", "html", "org",
+  NULL
+};
+
+static inline guchar fold(guchar c) {
+  return (c >= 'A' && c <= 'Z') ? (guchar)(c + ('a' - 'A')) : c;
+}
+
+static inline gboolean is_token_char(guchar c) {
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '%';
+}
+
+// "^" matches anything but a letter, a digit or one of _ - . %
+static inline gboolean is_separator(guchar c) {
+  return !((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-' || c == '.' || c == '%');
+}
+
+static inline guint32 hash_step(guint32 h, guchar c) {
+  return (h ^ c) * 16777619u;
+}
+
+static guint32 hash_token(const char *s) {
+  guint32 h = 2166136261u;
+  for (; *s; s++) h = hash_step(h, (guchar)*s);
+  return h;
+}
+
+// Salt mixed into token hashes to key a partition. The catch-all
+// partition has salt 0, so its keys are the plain token hashes.
+static inline guint32 partition_salt(guint type_slot, guint party) {
+  return (type_slot * 3 + party) * 0x9e3779b9u;
+}
+
+static guint32 pool_add(GString *pool, const char *s, gsize len) {
+  guint32 offset = (guint32)pool->len;
+  g_string_append_len(pool, s, len);
+  g_string_append_c(pool, '\0');
+  return offset;
+}
+
+// Pool offset of a string, stored once however many filters use it.
+// counter is charged for the bytes actually added.
+static guint32 pool_intern(AbpEngine *engine, const char *s, gsize len, guint32 *counter) {
+  gchar *key = g_strndup(s, len);
+  gpointer found = g_hash_table_lookup(engine->strings, key);
+  if (found) {
+    g_free(key);
+    engine->tables.pool_shared += (guint32)len + 1;
+    return GPOINTER_TO_UINT(found) - 1;
+  }
+
+  guint32 offset = pool_add(engine->pool, s, len);
+  *counter += (guint32)len + 1;
+  g_hash_table_insert(engine->strings, key, GUINT_TO_POINTER(offset + 1));
+  return offset;
+}
+
+// Share the $domain= run just appended for filter with an identical
+// earlier one
+static void intern_domain_run(AbpEngine *engine, AbpFilter *filter) {
+  GString *key = g_string_new(NULL);
+  for (guint32 i = 0; i < filter->n_domains; i++) {
+    const AbpDomain *d = &g_array_index(engine->domains, AbpDomain, filter->domains + i);
+    g_string_append_printf(key, "%s%u|", d->exclude ? "~" : "", d->name);
+  }
+
+  gpointer found = g_hash_table_lookup(engine->domain_runs, key->str);
+  if (found) {
+    g_array_set_size(engine->domains, filter->domains);
+    filter->domains = GPOINTER_TO_UINT(found) - 1;
+    engine->tables.pool_shared += filter->n_domains * sizeof(AbpDomain);
+    g_string_free(key, TRUE);
+  } else {
+    g_hash_table_insert(engine->domain_runs, g_string_free(key, FALSE),
+                        GUINT_TO_POINTER(filter->domains + 1));
+  }
+}
+
+AbpEngine* abp_engine_new() {
+  AbpEngine *engine = g_new0(AbpEngine, 1);
+  engine->ref_count = 1;
+  engine->filters = g_array_new(FALSE, FALSE, sizeof(AbpFilter));
+  engine->domains = g_array_new(FALSE, FALSE, sizeof(AbpDomain));
+  engine->pool = g_string_new(NULL);
+  engine->strings = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  engine->domain_runs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  return engine;
+}
+
+// Element hiding and snippet filters: "##", "#@#", "#?#", "#$#", "#@$#", ...
+static gboolean is_cosmetic_filter(const char *text) {
+  for (const char *p = strchr(text, '#'); p; p = strchr(p + 1, '#')) {
+    const char *q = p + 1;
+    if (*q == '@') q++;
+    if (*q == '?' || *q == '$' || *q == '%') q++;
+    if (*q == '#') return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean parse_domain_option(AbpEngine *engine, AbpFilter *filter, const char *value) {
+  gchar **names = g_strsplit(value, "|", -1);
+  if (filter->n_domains == 0) filter->domains = engine->domains->len;
+
+  for (int i = 0; names[i] != NULL && filter->n_domains < G_MAXUINT16; i++) {
+    const char *name = names[i];
+    AbpDomain domain;
+    domain.exclude = name[0] == '~';
+    if (domain.exclude) name++;
+    if (!name[0] || strlen(name) > G_MAXUINT16) continue;
+
+    gchar *lower = g_ascii_strdown(name, -1);
+    domain.len = (guint16)strlen(lower);
+    domain.name = pool_intern(engine, lower, domain.len, &engine->tables.pool_domains);
+    g_free(lower);
+    g_array_append_val(engine->domains, domain);
+    filter->n_domains++;
+  }
+
+  g_strfreev(names);
+  return filter->n_domains > 0;
+}
+
+static gboolean parse_options(AbpEngine *engine, AbpFilter *filter, const char *options) {
+  guint include_types = 0;
+  guint exclude_types = 0;
+  gboolean ok = TRUE;
+  gchar **parts = g_strsplit(options, ",", -1);
+
+  for (int i = 0; ok && parts[i] != NULL; i++) {
+    const char *name = g_strstrip(parts[i]);
+    gboolean negated = name[0] == '~';
+    if (negated) name++;
+
+    guint type = 0;
+    for (int t = 0; TYPE_OPTIONS[t].name != NULL; t++) {
+      if (g_ascii_strcasecmp(name, TYPE_OPTIONS[t].name) == 0) {
+        type = TYPE_OPTIONS[t].type;
+        break;
+      }
+    }
+
+    if (type) {
+      if (negated) exclude_types |= type;
+      else include_types |= type;
+    } else if (strcmp(name, "third-party") == 0 || strcmp(name, "3p") == 0) {
+      filter->flags |= negated ? FILTER_FIRST_PARTY : FILTER_THIRD_PARTY;
+    } else if (strcmp(name, "first-party") == 0 || strcmp(name, "1p") == 0) {
+      filter->flags |= negated ? FILTER_THIRD_PARTY : FILTER_FIRST_PARTY;
+    } else if (!negated && (g_str_has_prefix(name, "domain=") || g_str_has_prefix(name, "from="))) {
+      ok = parse_domain_option(engine, filter, strchr(name, '=') + 1);
+    } else if (!negated && strcmp(name, "match-case") == 0) {
+      filter->flags |= FILTER_MATCH_CASE;
+    } else if (!negated && strcmp(name, "important") == 0) {
+      filter->flags |= FILTER_IMPORTANT;
+    } else if (!negated && g_str_has_prefix(name, "redirect=")) {
+      // Blocks like any other filter; the web process answers the request
+      // with the resource, found again from the filter text
+      ok = redirect_resource_lookup(name + 9, strcspn(name + 9, ":")) != NULL;
+    } else if (strcmp(name, "collapse") == 0) {
+      // Legacy ABP option with no effect on matching
+    } else {
+      // csp=, rewrite=, popup, elemhide, ... are not network blocking rules
+      // we can honour, so the whole filter is dropped.
+      ok = FALSE;
+    }
+  }
+
+  g_strfreev(parts);
+
+  filter->types = (guint16)((include_types ? include_types : ABP_TYPE_ALL) & ~exclude_types);
+  return ok && filter->types != 0;
+}
+
+gboolean abp_engine_add_filter(AbpEngine *engine, const char *line) {
+  if (!engine || engine->compiled || !line) return FALSE;
+
+  gchar *text = g_strstrip(g_strdup(line));
+  if (text[0] == '\0' || text[0] == '!' || text[0] == '[' || is_cosmetic_filter(text)) {
+    g_free(text);
+    return FALSE;
+  }
+
+  AbpFilter filter;
+  memset(&filter, 0, sizeof(filter));
+  filter.domains = ABP_NONE;
+  filter.types = ABP_TYPE_ALL;
+
+  gchar *pattern = g_strdup(text);
+  gchar *p = pattern;
+  gboolean ok = TRUE;
+
+  if (g_str_has_prefix(p, "@@")) {
+    filter.flags |= FILTER_EXCEPTION;
+    p += 2;
+  }
+
+  // A '$' followed by the closing '/' of a regex is an end anchor
+  char *dollar = strrchr(p, '$');
+  if (dollar && p[0] == '/' && strchr(dollar + 1, '/')) {
+    dollar = NULL;
+  }
+  if (dollar) {
+    *dollar = '\0';
+    ok = parse_options(engine, &filter, dollar + 1);
+  }
+
+  gsize len = strlen(p);
+  if (ok && len >= 2 && p[0] == '/' && p[len - 1] == '/') {
+    // Kept as written; case is handled when the expression is compiled
+    p[--len] = '\0';
+    p++;
+    len--;
+    ok = lazy_dfa_check(p, len);
+    filter.flags |= FILTER_REGEX;
+  }
+
+  if (ok && !(filter.flags & FILTER_REGEX)) {
+    if (g_str_has_prefix(p, "||")) {
+      filter.flags |= FILTER_HOST_ANCHOR;
+      p += 2;
+    } else if (p[0] == '|') {
+      filter.flags |= FILTER_START_ANCHOR;
+      p += 1;
+    }
+    len = strlen(p);
+    if (len > 0 && p[len - 1] == '|') {
+      filter.flags |= FILTER_END_ANCHOR;
+      p[--len] = '\0';
+    }
+
+    // Leading and trailing wildcards only cancel the anchors
+    while (p[0] == '*') {
+      filter.flags &= ~(FILTER_HOST_ANCHOR | FILTER_START_ANCHOR);
+      p++;
+      len--;
+    }
+    while (len > 0 && p[len - 1] == '*') {
+      filter.flags &= ~FILTER_END_ANCHOR;
+      p[--len] = '\0';
+    }
+
+    // Collapse runs of '*' and fold case
+    gsize out = 0;
+    for (gsize i = 0; i < len; i++) {
+      if (p[i] == '*' && out > 0 && p[out - 1] == '*') continue;
+      p[out++] = (filter.flags & FILTER_MATCH_CASE) ? p[i] : (char)fold((guchar)p[i]);
+    }
+    p[out] = '\0';
+    len = out;
+
+    if (!strpbrk(p, "*^")) {
+      filter.flags |= FILTER_PLAIN;
+    }
+    if (len == 0) {
+      filter.flags &= ~(FILTER_HOST_ANCHOR | FILTER_START_ANCHOR | FILTER_END_ANCHOR);
+    }
+  }
+
+  if (ok && len > G_MAXUINT16) {
+    ok = FALSE;
+  }
+
+  if (ok) {
+    gsize text_len = strlen(text);
+    filter.text = pool_add(engine->pool, text, text_len);
+    engine->tables.pool_text += (guint32)text_len + 1;
+
+    // Most patterns are already spelled out in the line
+    const char *inside = (const char *)memmem(text, text_len, p, len);
+    if (inside) {
+      filter.pattern = filter.text + (guint32)(inside - text);
+      engine->tables.pool_shared += (guint32)len + 1;
+    } else {
+      filter.pattern = pool_intern(engine, p, len, &engine->tables.pool_patterns);
+    }
+    filter.pattern_len = (guint16)len;
+    if (filter.n_domains > 0) intern_domain_run(engine, &filter);
+    if (filter.flags & FILTER_IMPORTANT) {
+      engine->tables.has_important = TRUE;
+    }
+    g_array_append_val(engine->filters, filter);
+  } else {
+    // Drop the $domain= entries parsed for it
+    if (filter.n_domains > 0) g_array_set_size(engine->domains, filter.domains);
+    engine->tables.unsupported++;
+  }
+
+  g_free(pattern);
+  g_free(text);
+  return ok;
+}
+
+guint abp_engine_add_filters(AbpEngine *engine, const char *text) {
+  if (!engine || !text) return 0;
+
+  guint added = 0;
+  gchar *copy = g_strdup(text);
+  gchar *line = copy;
+  while (line) {
+    gchar *next = strchr(line, '\n');
+    if (next) *next++ = '\0';
+    if (abp_engine_add_filter(engine, line)) added++;
+    line = next;
+  }
+  g_free(copy);
+  return added;
+}
+
+guint abp_engine_load_file(AbpEngine *engine, const char *path) {
+  gchar *contents = NULL;
+  if (!engine || !g_file_get_contents(path, &contents, NULL, NULL)) {
+    return 0;
+  }
+  guint added = abp_engine_add_filters(engine, contents);
+  g_free(contents);
+  return added;
+}
+
+// Report every token of a pattern that must appear as a whole URL token:
+// bounded on both sides by a separator, an anchor or the pattern edge of
+// an anchored filter. Tokens next to '*' or an open edge may be partial.
+typedef void (*TokenFunc)(guint32 hash, gsize len, gpointer user_data);
+
+static void for_each_pattern_token(const char *p, gsize len, guint32 flags, TokenFunc func,
+                                   gpointer user_data) {
+  gsize i = 0;
+  while (i < len) {
+    if (!is_token_char(fold((guchar)p[i]))) {
+      i++;
+      continue;
+    }
+
+    gsize start = i;
+    guint32 h = 2166136261u;
+    while (i < len && is_token_char(fold((guchar)p[i]))) {
+      h = hash_step(h, fold((guchar)p[i]));
+      i++;
+    }
+
+    gboolean left_ok = start > 0 ? p[start - 1] != '*'
+                                 : (flags & (FILTER_HOST_ANCHOR | FILTER_START_ANCHOR)) != 0;
+    gboolean right_ok = i < len ? p[i] != '*' : (flags & FILTER_END_ANCHOR) != 0;
+    if (left_ok && right_ok) {
+      func(h, i - start, user_data);
+    }
+  }
+}
+
+static void count_token(guint32 hash, gsize, gpointer user_data) {
+  GHashTable *counts = (GHashTable *)user_data;
+  gpointer key = GUINT_TO_POINTER(hash);
+  guint count = GPOINTER_TO_UINT(g_hash_table_lookup(counts, key));
+  g_hash_table_insert(counts, key, GUINT_TO_POINTER(count + 1));
+}
+
+typedef struct {
+  GHashTable *counts;
+  GHashTable *bad;
+  guint32 best_hash;
+  guint64 best_score;
+  gsize best_len;
+} TokenChoice;
+
+static void choose_token(guint32 hash, gsize len, gpointer user_data) {
+  TokenChoice *choice = (TokenChoice *)user_data;
+  guint64 score = GPOINTER_TO_UINT(g_hash_table_lookup(choice->counts, GUINT_TO_POINTER(hash)));
+  if (g_hash_table_contains(choice->bad, GUINT_TO_POINTER(hash))) {
+    score += G_MAXUINT32;
+  }
+  if (score < choice->best_score || (score == choice->best_score && len > choice->best_len)) {
+    choice->best_hash = hash;
+    choice->best_score = score;
+    choice->best_len = len;
+  }
+}
+
+// Flatten token -> filter id buckets into an open-addressed table and the
+// shared id array
+static TokenBucket* build_buckets(GHashTable *index, GArray *ids, guint32 *n_buckets) {
+  guint32 capacity = 8;
+  while (capacity < g_hash_table_size(index) * 2) capacity *= 2;
+
+  TokenBucket *buckets = g_new0(TokenBucket, capacity);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, index);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    guint32 hash = GPOINTER_TO_UINT(key);
+    GArray *bucket = (GArray *)value;
+    guint32 i = hash & (capacity - 1);
+    while (buckets[i].count != 0) i = (i + 1) & (capacity - 1);
+    buckets[i].hash = hash;
+    buckets[i].start = ids->len;
+    buckets[i].count = bucket->len;
+    g_array_append_vals(ids, bucket->data, bucket->len);
+  }
+
+  *n_buckets = capacity;
+  return buckets;
+}
+
+// The prefilter is rebuilt from the buckets rather than stored, so
+// snapshots keep their format
+static void build_prefilter(AbpEngine *engine) {
+  const TokenBucket *buckets = engine->buckets[KIND_BLOCK];
+  guint32 n_buckets = engine->tables.n_buckets[KIND_BLOCK];
+  guint32 used = 0;
+  for (guint32 i = 0; i < n_buckets; i++) {
+    if (buckets[i].count > 0) used++;
+  }
+  engine->block_prefilter = bloom_filter_new(used);
+  for (guint32 i = 0; i < n_buckets; i++) {
+    if (buckets[i].count > 0) bloom_filter_add(engine->block_prefilter, buckets[i].hash);
+  }
+
+  // Lets abp_engine_match_exception skip lists without exceptions. They
+  // may sit in the automaton rather than the index.
+  engine->has_exceptions = FALSE;
+  for (guint32 i = 0; i < engine->tables.n_filters && !engine->has_exceptions; i++) {
+    engine->has_exceptions = (engine->filter_table[i].flags & FILTER_EXCEPTION) != 0;
+  }
+}
+
+// Regular expression for a wildcard pattern: '*' is any run of characters,
+// '^' a separator or the end of the URL
+static GString* glob_to_regex(const AbpFilter *f, const char *p) {
+  GString *regex = g_string_new(NULL);
+  if (f->flags & FILTER_START_ANCHOR) g_string_append_c(regex, '^');
+  for (guint32 i = 0; i < f->pattern_len; i++) {
+    guchar c = (guchar)p[i];
+    if (c == '*') {
+      g_string_append(regex, ".*");
+    } else if (c == '^') {
+      g_string_append(regex, "(?:[^a-zA-Z0-9_.%-]|$)");
+    } else {
+      if (c < 0x80 && !g_ascii_isalnum(c)) g_string_append_c(regex, '\\');
+      g_string_append_c(regex, (char)c);
+    }
+  }
+  if (f->flags & FILTER_END_ANCHOR) g_string_append_c(regex, '$');
+  return regex;
+}
+
+// Regex filters, and wildcard filters without a token that would otherwise
+// be tried one by one on every request. Host-anchored filters stay in the
+// index, where the anchor rejects most URLs after a few bytes.
+static gboolean wants_automaton(const AbpFilter *f, guint32 token) {
+  if (f->flags & FILTER_REGEX) return TRUE;
+  return token == UNTOKENIZED_HASH && f->pattern_len > 0 && !(f->flags & FILTER_HOST_ANCHOR);
+}
+
+// Add filter id to the automaton. Returns FALSE if its pattern is too
+// large to compile.
+static gboolean add_to_automaton(LazyDfa *automaton, const AbpFilter *f, const char *pool, guint32 id) {
+  const char *p = pool + f->pattern;
+  gboolean ignore_case = !(f->flags & FILTER_MATCH_CASE);
+  if (f->flags & FILTER_REGEX) {
+    return lazy_dfa_add(automaton, p, f->pattern_len, id, ignore_case);
+  }
+
+  GString *regex = glob_to_regex(f, p);
+  gboolean ok = lazy_dfa_add(automaton, regex->str, regex->len, id, ignore_case);
+  g_string_free(regex, TRUE);
+  return ok;
+}
+
+// The automaton is rebuilt from the flagged filters rather than stored,
+// like the prefilter
+static void build_automaton(AbpEngine *engine) {
+  engine->automaton = lazy_dfa_new(AUTOMATON_MEMORY_LIMIT);
+  for (guint32 i = 0; i < engine->tables.n_filters; i++) {
+    const AbpFilter *f = &engine->filter_table[i];
+    if (f->flags & FILTER_AUTOMATON) add_to_automaton(engine->automaton, f, engine->pool_data, i);
+  }
+  lazy_dfa_compile(engine->automaton);
+}
+
+void abp_engine_compile(AbpEngine *engine) {
+  if (!engine || engine->compiled) return;
+
+  const char *pool = engine->pool->str;
+  GHashTable *counts = g_hash_table_new(g_direct_hash, g_direct_equal);
+  GHashTable *bad = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for (int i = 0; BAD_TOKENS[i] != NULL; i++) {
+    g_hash_table_add(bad, GUINT_TO_POINTER(hash_token(BAD_TOKENS[i])));
+  }
+
+  for (guint i = 0; i < engine->filters->len; i++) {
+    const AbpFilter *f = &g_array_index(engine->filters, AbpFilter, i);
+    if (f->flags & FILTER_REGEX) continue;
+    for_each_pattern_token(pool + f->pattern, f->pattern_len, f->flags, count_token, counts);
+  }
+
+  // Bucket every filter under its rarest token, in each of its partitions,
+  // unless the automaton takes it
+  engine->automaton = lazy_dfa_new(AUTOMATON_MEMORY_LIMIT);
+  GHashTable *index[2];
+  for (int kind = 0; kind < 2; kind++) {
+    index[kind] = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                        (GDestroyNotify)g_array_unref);
+  }
+
+  for (guint32 i = 0; i < engine->filters->len; i++) {
+    AbpFilter *f = &g_array_index(engine->filters, AbpFilter, i);
+    int kind = (f->flags & FILTER_EXCEPTION) ? KIND_EXCEPTION : KIND_BLOCK;
+
+    TokenChoice choice;
+    choice.counts = counts;
+    choice.bad = bad;
+    choice.best_hash = UNTOKENIZED_HASH;
+    choice.best_score = G_MAXUINT64;
+    choice.best_len = 0;
+    if (!(f->flags & FILTER_REGEX)) {
+      for_each_pattern_token(pool + f->pattern, f->pattern_len, f->flags, choose_token, &choice);
+    }
+
+    // Regex filters were checked when added, so only an oversized
+    // wildcard pattern falls back to the index
+    if (wants_automaton(f, choice.best_hash) &&
+        (add_to_automaton(engine->automaton, f, pool, i) || (f->flags & FILTER_REGEX))) {
+      f->flags |= FILTER_AUTOMATON;
+      continue;
+    }
+
+    guint party = (f->flags & FILTER_THIRD_PARTY) ? PARTY_THIRD
+                : (f->flags & FILTER_FIRST_PARTY) ? PARTY_FIRST : PARTY_ANY;
+    gboolean any_type = __builtin_popcount(f->types) > PARTITION_MAX_TYPES;
+    for (guint slot = 0; slot < PARTITION_TYPE_SLOTS; slot++) {
+      if (slot == 0 ? !any_type : (any_type || !(f->types & (1u << (slot - 1))))) continue;
+
+      gpointer key = GUINT_TO_POINTER(choice.best_hash ^ partition_salt(slot, party));
+      GArray *bucket = (GArray *)g_hash_table_lookup(index[kind], key);
+      if (!bucket) {
+        bucket = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_hash_table_insert(index[kind], key, bucket);
+      }
+      g_array_append_val(bucket, i);
+    }
+  }
+
+  g_hash_table_destroy(counts);
+  g_hash_table_destroy(bad);
+
+  // Freeze everything into flat tables
+  AbpTables *tables = &engine->tables;
+  tables->n_filters = engine->filters->len;
+  tables->n_domains = engine->domains->len;
+  g_hash_table_destroy(engine->strings);
+  g_hash_table_destroy(engine->domain_runs);
+  engine->strings = NULL;
+  engine->domain_runs = NULL;
+
+  GArray *ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+  for (int kind = 0; kind < 2; kind++) {
+    engine->buckets[kind] = build_buckets(index[kind], ids, &tables->n_buckets[kind]);
+    g_hash_table_destroy(index[kind]);
+  }
+  tables->n_ids = ids->len;
+
+  engine->pool_len = engine->pool->len;
+  engine->pool_data = engine->pool->str;
+  engine->filter_table = (const AbpFilter *)(void *)engine->filters->data;
+  engine->domain_table = (const AbpDomain *)(void *)engine->domains->data;
+  engine->ids = (const guint32 *)(void *)g_array_free(ids, FALSE);
+  build_prefilter(engine);
+  lazy_dfa_compile(engine->automaton);
+  engine->compiled = TRUE;
+}
+
+// Wildcard match of p against s starting at start. '*' matches any run of
+// characters, '^' a separator or the end of the URL.
+static gboolean glob_match(const char *p, gsize plen, const char *s, gsize slen, gsize start,
+                           gboolean anchored, gboolean end_anchor) {
+  gsize pi = 0;
+  gsize si = start;
+  gssize star_p = anchored ? -1 : 0;
+  gsize star_s = start;
+
+  for (;;) {
+    if (pi < plen) {
+      char pc = p[pi];
+      if (pc == '*') {
+        star_p = (gssize)++pi;
+        star_s = si;
+        continue;
+      }
+      if (si < slen && (pc == '^' ? is_separator((guchar)s[si]) : pc == s[si])) {
+        pi++;
+        si++;
+        continue;
+      }
+      if (pc == '^' && si == slen) {
+        pi++;
+        continue;
+      }
+    } else if (!end_anchor || si == slen) {
+      return TRUE;
+    }
+
+    // Mismatch: let the last '*' absorb one more character
+    if (star_p < 0 || star_s >= slen) return FALSE;
+    si = ++star_s;
+    pi = (gsize)star_p;
+  }
+}
+
+static gboolean pattern_matches(const AbpFilter *f, const char *p, const char *s, const UrlInfo *u) {
+  gsize plen = f->pattern_len;
+  gsize slen = u->len;
+  gboolean end_anchor = (f->flags & FILTER_END_ANCHOR) != 0;
+  gboolean plain = (f->flags & FILTER_PLAIN) != 0;
+
+  if (f->flags & FILTER_HOST_ANCHOR) {
+    // Match at the start of the host or of any of its labels
+    for (gsize pos = u->host_start; pos < u->host_end; pos++) {
+      if (pos != u->host_start && s[pos - 1] != '.') continue;
+      if (plain && !end_anchor) {
+        if (slen - pos >= plen && memcmp(s + pos, p, plen) == 0) return TRUE;
+      } else if (glob_match(p, plen, s, slen, pos, TRUE, end_anchor)) {
+        return TRUE;
+      }
+    }
+    return FALSE;
+  }
+
+  if (f->flags & FILTER_START_ANCHOR) {
+    return glob_match(p, plen, s, slen, 0, TRUE, end_anchor);
+  }
+
+  if (plain && !end_anchor) {
+    return memmem(s, slen, p, plen) != NULL;
+  }
+  return glob_match(p, plen, s, slen, 0, FALSE, end_anchor);
+}
+
+static gboolean host_matches_domain(const char *host, gsize host_len, const char *domain,
+                                    gsize domain_len) {
+  if (host_len < domain_len) return FALSE;
+  if (memcmp(host + host_len - domain_len, domain, domain_len) != 0) return FALSE;
+  return host_len == domain_len || host[host_len - domain_len - 1] == '.';
+}
+
+// The most specific listed domain decides; with no listed domain matching,
+// the filter applies only if it has no positive domains.
+static gboolean domains_match(const AbpEngine *engine, const AbpFilter *f, const UrlInfo *u) {
+  const AbpDomain *best = NULL;
+  gboolean has_include = FALSE;
+
+  for (guint32 i = 0; i < f->n_domains; i++) {
+    const AbpDomain *d = &engine->domain_table[f->domains + i];
+    if (!d->exclude) has_include = TRUE;
+    if (u->document_host &&
+        host_matches_domain(u->document_host, u->document_host_len,
+                            engine->pool_data + d->name, d->len) &&
+        (!best || d->len > best->len)) {
+      best = d;
+    }
+  }
+
+  if (best) return !best->exclude;
+  return !has_include;
+}
+
+// Type, party and $domain= restrictions of a filter
+static gboolean options_match(const AbpEngine *engine, const AbpFilter *f, const UrlInfo *u) {
+  if (!(f->types & u->type)) return FALSE;
+  if ((f->flags & FILTER_THIRD_PARTY) && u->third_party != 1) return FALSE;
+  if ((f->flags & FILTER_FIRST_PARTY) && u->third_party != 0) return FALSE;
+  return f->n_domains == 0 || domains_match(engine, f, u);
+}
+
+static gboolean filter_matches(const AbpEngine *engine, guint32 id, const UrlInfo *u) {
+  const AbpFilter *f = &engine->filter_table[id];
+  if (!options_match(engine, f, u)) return FALSE;
+
+  const char *text = (f->flags & FILTER_MATCH_CASE) ? u->url : u->lower;
+  return pattern_matches(f, engine->pool_data + f->pattern, text, u);
+}
+
+// filter_matches with its time charged to the filter, in profiling mode
+static gboolean profile_filter(const AbpEngine *engine, guint32 id, const UrlInfo *u) {
+  guint64 start = rule_profiler_now();
+  gboolean matched = filter_matches(engine, id, u);
+  rule_profiler_record_rule("easylist", engine->pool_data + engine->filter_table[id].text, start);
+  return matched;
+}
+
+static const TokenBucket* find_bucket(const AbpEngine *engine, int kind, guint32 hash) {
+  const TokenBucket *buckets = engine->buckets[kind];
+  guint32 mask = engine->tables.n_buckets[kind] - 1;
+  for (guint32 i = hash & mask; ; i = (i + 1) & mask) {
+    if (buckets[i].count == 0) return NULL;
+    if (buckets[i].hash == hash) return &buckets[i];
+  }
+}
+
+// Salts of the partitions a request can match: the catch-all type slot and
+// one per requested type bit, each for any party and for the request's own
+// party when it is known
+static guint request_partitions(const UrlInfo *u, guint32 *salts) {
+  guint n = 0;
+  guint parties[2] = { PARTY_ANY, PARTY_ANY };
+  guint n_parties = 1;
+  if (u->third_party >= 0) parties[n_parties++] = u->third_party ? PARTY_THIRD : PARTY_FIRST;
+
+  for (guint slot = 0; slot < PARTITION_TYPE_SLOTS; slot++) {
+    if (slot > 0 && !(u->type & (1u << (slot - 1)))) continue;
+    for (guint p = 0; p < n_parties; p++) {
+      salts[n++] = partition_salt(slot, parties[p]);
+    }
+  }
+  return n;
+}
+
+// URL tokens and index partitions of a request, gathered once for every
+// index probe
+typedef struct {
+  UrlInfo u;
+  guint32 *tokens;            // inline_tokens, or a heap array for long URLs
+  guint n_tokens;
+  guint tokens_capacity;
+  guint32 inline_tokens[URL_TOKENS_INLINE];
+  guint32 salts[2 * PARTITION_TYPE_SLOTS];
+  guint n_salts;
+
+  // Automaton matches per kind, from one scan made on first use
+  gboolean scanned;
+  guint32 automaton_match[2];
+} RequestKeys;
+
+typedef struct {
+  const AbpEngine *engine;
+  const UrlInfo *u;
+  guint32 *best;              // per kind
+} AutomatonScan;
+
+// Keep the first filter of each kind whose options match, preferring
+// $important blocking filters
+static gboolean on_automaton_match(guint32 id, gsize, gpointer user_data) {
+  AutomatonScan *scan = (AutomatonScan *)user_data;
+  const AbpFilter *f = &scan->engine->filter_table[id];
+  int kind = (f->flags & FILTER_EXCEPTION) ? KIND_EXCEPTION : KIND_BLOCK;
+  guint32 best = scan->best[kind];
+
+  if (best != ABP_NONE && (kind == KIND_EXCEPTION || !(f->flags & FILTER_IMPORTANT) ||
+                           (scan->engine->filter_table[best].flags & FILTER_IMPORTANT))) {
+    return FALSE;
+  }
+  if (options_match(scan->engine, f, scan->u)) scan->best[kind] = id;
+  return FALSE;
+}
+
+static guint32 find_automaton_filter(const AbpEngine *engine, int kind, RequestKeys *keys) {
+  if (!keys->scanned) {
+    keys->scanned = TRUE;
+    keys->automaton_match[KIND_BLOCK] = ABP_NONE;
+    keys->automaton_match[KIND_EXCEPTION] = ABP_NONE;
+
+    gboolean profiling = rule_profiler_enabled();
+    guint64 start = profiling ? rule_profiler_now() : 0;
+    AutomatonScan scan = { engine, &keys->u, keys->automaton_match };
+    lazy_dfa_scan(engine->automaton, keys->u.url, keys->u.len, on_automaton_match, &scan);
+    if (profiling) rule_profiler_record_rule("easylist", "(regex automaton)", start);
+  }
+  return keys->automaton_match[kind];
+}
+
+// Find a matching filter of the given kind among the buckets of the URL's
+// tokens and the untokenized filters, in each partition of the request,
+// then in the automaton. A blocking filter without $important is only
+// returned once no $important filter matches.
+static guint32 find_filter(const AbpEngine *engine, int kind, RequestKeys *keys) {
+  const UrlInfo *u = &keys->u;
+  const guint32 *salts = keys->salts;
+  const guint32 *tokens = keys->tokens;
+  guint n_salts = keys->n_salts;
+  guint n_tokens = keys->n_tokens;
+  gboolean want_important = kind == KIND_BLOCK && engine->tables.has_important;
+  gboolean profiling = rule_profiler_enabled();
+  guint32 found = ABP_NONE;
+
+  for (guint s = 0; s < n_salts; s++) {
+    for (guint t = 0; t <= n_tokens; t++) {
+      guint32 token = t == 0 ? UNTOKENIZED_HASH : tokens[t - 1];
+      if (kind == KIND_BLOCK && !bloom_filter_may_contain(engine->block_prefilter, token ^ salts[s])) {
+        continue;
+      }
+      const TokenBucket *bucket = find_bucket(engine, kind, token ^ salts[s]);
+      if (!bucket) continue;
+
+      for (guint32 i = bucket->start; i < bucket->start + bucket->count; i++) {
+        guint32 id = engine->ids[i];
+        if (!(profiling ? profile_filter(engine, id, u) : filter_matches(engine, id, u))) continue;
+
+        if (!want_important || (engine->filter_table[id].flags & FILTER_IMPORTANT)) {
+          return id;
+        }
+        if (found == ABP_NONE) found = id;
+      }
+    }
+  }
+
+  guint32 id = find_automaton_filter(engine, kind, keys);
+  if (id != ABP_NONE && (found == ABP_NONE || (engine->filter_table[id].flags & FILTER_IMPORTANT))) {
+    return id;
+  }
+  return found;
+}
+
+static int compare_tokens(const void *a, const void *b) {
+  guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+// Gather the keys of a request; release them with clear_request
+static void prepare_request(const AbpRequest *request, RequestKeys *keys) {
+  const ParsedUrl *url = request->url;
+  const ParsedUrl *document = request->document;
+
+  UrlInfo u;
+  u.url = url->url;
+  u.lower = url->lower;
+  u.len = url->len;
+  u.host_start = url->host.start;
+  u.host_end = url->host.start + url->host.len;
+  u.type = request->type ? request->type : (guint)ABP_TYPE_OTHER;
+  u.document_host = document && document->host.len ? url_span_lower(document, document->host) : NULL;
+  u.document_host_len = u.document_host ? document->host.len : 0;
+
+  u.third_party = request->third_party;
+  if (u.third_party < 0 && u.document_host) {
+    u.third_party = !(url->domain.len == document->domain.len &&
+                      memcmp(url_span_lower(url, url->domain), url_span_lower(document, document->domain),
+                             url->domain.len) == 0);
+  }
+  const char *lower = u.lower;
+
+  // Collect every token of the URL, then drop the duplicates
+  keys->tokens = keys->inline_tokens;
+  keys->tokens_capacity = URL_TOKENS_INLINE;
+  guint n_tokens = 0;
+  for (gsize i = 0; i < u.len;) {
+    if (!is_token_char((guchar)lower[i])) {
+      i++;
+      continue;
+    }
+    guint32 h = 2166136261u;
+    while (i < u.len && is_token_char((guchar)lower[i])) {
+      h = hash_step(h, (guchar)lower[i++]);
+    }
+    if (n_tokens == keys->tokens_capacity) {
+      keys->tokens_capacity *= 2;
+      if (keys->tokens == keys->inline_tokens) {
+        keys->tokens = g_new(guint32, keys->tokens_capacity);
+        memcpy(keys->tokens, keys->inline_tokens, sizeof(keys->inline_tokens));
+      } else {
+        keys->tokens = g_renew(guint32, keys->tokens, keys->tokens_capacity);
+      }
+    }
+    keys->tokens[n_tokens++] = h;
+  }
+  if (n_tokens > 1) {
+    qsort(keys->tokens, n_tokens, sizeof(guint32), compare_tokens);
+    guint distinct = 1;
+    for (guint t = 1; t < n_tokens; t++) {
+      if (keys->tokens[t] != keys->tokens[distinct - 1]) keys->tokens[distinct++] = keys->tokens[t];
+    }
+    n_tokens = distinct;
+  }
+  keys->u = u;
+  keys->n_tokens = n_tokens;
+  keys->scanned = FALSE;
+  keys->n_salts = request_partitions(&u, keys->salts);
+}
+
+static void clear_request(RequestKeys *keys) {
+  if (keys->tokens != keys->inline_tokens) g_free(keys->tokens);
+}
+
+gboolean abp_engine_match(const AbpEngine *engine, const AbpRequest *request, AbpMatch *match) {
+  if (!engine || !engine->compiled || !request || !request->url) return FALSE;
+
+  RequestKeys keys;
+  prepare_request(request, &keys);
+
+  gboolean blocked = FALSE;
+  guint32 id = find_filter(engine, KIND_BLOCK, &keys);
+  if (id != ABP_NONE) {
+    blocked = TRUE;
+    if (!(engine->filter_table[id].flags & FILTER_IMPORTANT)) {
+      guint32 exception = find_filter(engine, KIND_EXCEPTION, &keys);
+      if (exception != ABP_NONE) {
+        id = exception;
+        blocked = FALSE;
+      }
+    }
+
+    if (match) {
+      match->filter_id = id;
+      match->text = engine->pool_data + engine->filter_table[id].text;
+      match->exception = !blocked;
+    }
+  }
+
+  clear_request(&keys);
+  return blocked;
+}
+
+gboolean abp_engine_match_exception(const AbpEngine *engine, const AbpRequest *request,
+                                    AbpMatch *match) {
+  if (!engine || !engine->compiled || !request || !request->url) return FALSE;
+
+  if (!engine->has_exceptions) return FALSE;
+
+  RequestKeys keys;
+  prepare_request(request, &keys);
+  guint32 id = find_filter(engine, KIND_EXCEPTION, &keys);
+  clear_request(&keys);
+  if (id == ABP_NONE) return FALSE;
+
+  if (match) {
+    match->filter_id = id;
+    match->text = engine->pool_data + engine->filter_table[id].text;
+    match->exception = TRUE;
+  }
+  return TRUE;
+}
+
+const char* abp_engine_get_filter_text(const AbpEngine *engine, guint32 id) {
+  if (!engine || !engine->compiled || id >= engine->tables.n_filters) return NULL;
+  return engine->pool_data + engine->filter_table[id].text;
+}
+
+void abp_engine_get_prefilter_stats(const AbpEngine *engine, gsize *size, double *fpr) {
+  const BloomFilter *prefilter = engine ? engine->block_prefilter : NULL;
+  if (size) *size = bloom_filter_get_size(prefilter);
+  if (fpr) *fpr = bloom_filter_measure_fpr(prefilter);
+}
+
+void abp_engine_get_automaton_stats(const AbpEngine *engine, LazyDfaStats *stats) {
+  lazy_dfa_get_stats(engine ? engine->automaton : NULL, stats);
+}
+
+void abp_engine_get_memory_report(const AbpEngine *engine, AbpMemoryReport *report) {
+  memset(report, 0, sizeof(*report));
+  if (!engine || !engine->compiled) return;
+
+  const AbpTables *tables = &engine->tables;
+  report->n_filters = tables->n_filters;
+  report->filters = tables->n_filters * sizeof(AbpFilter);
+  report->domains = tables->n_domains * sizeof(AbpDomain);
+  report->rule_text = tables->pool_text;
+  report->patterns = tables->pool_patterns;
+  report->domain_names = tables->pool_domains;
+  report->shared = tables->pool_shared;
+  report->index = (tables->n_buckets[KIND_BLOCK] + tables->n_buckets[KIND_EXCEPTION]) * sizeof(TokenBucket) +
+                  tables->n_ids * sizeof(guint32);
+  report->prefilter = bloom_filter_get_size(engine->block_prefilter);
+
+  LazyDfaStats automaton;
+  lazy_dfa_get_stats(engine->automaton, &automaton);
+  report->automaton = automaton.program_size + automaton.memory;
+  report->mapped = engine->snapshot != NULL;
+
+  report->total = report->filters + report->domains + engine->pool_len + report->index +
+                  report->prefilter + report->automaton;
+}
+
+guint abp_engine_get_filter_count(const AbpEngine *engine) {
+  if (!engine) return 0;
+  return engine->compiled ? engine->tables.n_filters : engine->filters->len;
+}
+
+guint abp_engine_get_unsupported_count(const AbpEngine *engine) {
+  return engine ? engine->tables.unsupported : 0;
+}
+
+gboolean abp_engine_save_snapshot(const AbpEngine *engine, const char *path, guint64 source_key) {
+  if (!engine || !engine->compiled) return FALSE;
+
+  const AbpTables *tables = &engine->tables;
+  gsize n_ids = tables->n_ids;
+  gsize n_domains = tables->n_domains;
+
+  SnapshotWriter *writer = snapshot_writer_new(SNAPSHOT_KIND_ABP_ENGINE, source_key);
+  snapshot_writer_add(writer, SECTION_TABLES, tables, sizeof(AbpTables));
+  snapshot_writer_add(writer, SECTION_FILTERS, engine->filter_table,
+                      tables->n_filters * sizeof(AbpFilter));
+  snapshot_writer_add(writer, SECTION_DOMAINS, engine->domain_table, n_domains * sizeof(AbpDomain));
+  snapshot_writer_add(writer, SECTION_POOL, engine->pool_data, engine->pool_len);
+  snapshot_writer_add(writer, SECTION_BLOCK_BUCKETS, engine->buckets[KIND_BLOCK],
+                      tables->n_buckets[KIND_BLOCK] * sizeof(TokenBucket));
+  snapshot_writer_add(writer, SECTION_EXCEPTION_BUCKETS, engine->buckets[KIND_EXCEPTION],
+                      tables->n_buckets[KIND_EXCEPTION] * sizeof(TokenBucket));
+  snapshot_writer_add(writer, SECTION_IDS, engine->ids, n_ids * sizeof(guint32));
+  gboolean ok = snapshot_writer_save(writer, path);
+  snapshot_writer_free(writer);
+  return ok;
+}
+
+AbpEngine* abp_engine_open_snapshot(const char *path, guint64 source_key) {
+  Snapshot *snapshot = snapshot_open(path, SNAPSHOT_KIND_ABP_ENGINE, source_key);
+  if (!snapshot) return NULL;
+
+  gsize len[8] = { 0 };
+  const AbpTables *tables =
+      (const AbpTables *)snapshot_get_section(snapshot, SECTION_TABLES, &len[SECTION_TABLES]);
+  gconstpointer data[8] = { NULL };
+  for (guint32 section = SECTION_FILTERS; section <= SECTION_IDS; section++) {
+    data[section] = snapshot_get_section(snapshot, section, &len[section]);
+  }
+
+  // Every offset the matcher follows must stay inside its section
+  gboolean valid = tables && len[SECTION_TABLES] == sizeof(AbpTables) &&
+                   data[SECTION_POOL] && len[SECTION_POOL] > 0 &&
+                   ((const char *)data[SECTION_POOL])[len[SECTION_POOL] - 1] == '\0' &&
+                   len[SECTION_FILTERS] == tables->n_filters * sizeof(AbpFilter);
+  gsize n_domains = len[SECTION_DOMAINS] / sizeof(AbpDomain);
+  gsize n_ids = len[SECTION_IDS] / sizeof(guint32);
+  valid = valid && tables->n_domains == n_domains;
+  for (int kind = 0; valid && kind < 2; kind++) {
+    guint32 n_buckets = tables->n_buckets[kind];
+    const TokenBucket *buckets = (const TokenBucket *)data[SECTION_BLOCK_BUCKETS + kind];
+    valid = n_buckets > 0 && (n_buckets & (n_buckets - 1)) == 0 &&
+            len[SECTION_BLOCK_BUCKETS + kind] == n_buckets * sizeof(TokenBucket) &&
+            tables->n_ids == n_ids;
+    // The index must keep an empty slot or lookups would not terminate
+    guint32 empty = 0;
+    for (guint32 i = 0; valid && i < n_buckets; i++) {
+      valid = (gsize)buckets[i].start + buckets[i].count <= n_ids;
+      if (buckets[i].count == 0) empty++;
+    }
+    valid = valid && empty > 0;
+  }
+  const guint32 *ids = (const guint32 *)data[SECTION_IDS];
+  for (gsize i = 0; valid && i < n_ids; i++) {
+    valid = ids[i] < tables->n_filters;
+  }
+  const AbpFilter *filters = (const AbpFilter *)data[SECTION_FILTERS];
+  for (guint32 i = 0; valid && i < tables->n_filters; i++) {
+    valid = filters[i].text < len[SECTION_POOL] &&
+            (gsize)filters[i].pattern + filters[i].pattern_len < len[SECTION_POOL] &&
+            (filters[i].n_domains == 0 || (gsize)filters[i].domains + filters[i].n_domains <= n_domains);
+  }
+  const AbpDomain *domains = (const AbpDomain *)data[SECTION_DOMAINS];
+  for (gsize i = 0; valid && i < n_domains; i++) {
+    valid = (gsize)domains[i].name + domains[i].len < len[SECTION_POOL];
+  }
+
+  if (!valid) {
+    snapshot_close(snapshot);
+    return NULL;
+  }
+
+  AbpEngine *engine = g_new0(AbpEngine, 1);
+  engine->ref_count = 1;
+  engine->tables = *tables;
+  engine->filter_table = filters;
+  engine->domain_table = domains;
+  engine->pool_data = (const char *)data[SECTION_POOL];
+  engine->pool_len = len[SECTION_POOL];
+  engine->buckets[KIND_BLOCK] = (const TokenBucket *)data[SECTION_BLOCK_BUCKETS];
+  engine->buckets[KIND_EXCEPTION] = (const TokenBucket *)data[SECTION_EXCEPTION_BUCKETS];
+  engine->ids = ids;
+  engine->snapshot = snapshot;
+  build_prefilter(engine);
+  build_automaton(engine);
+  engine->compiled = TRUE;
+  return engine;
+}
+
+AbpEngine* abp_engine_ref(AbpEngine *engine) {
+  if (engine) g_atomic_int_inc(&engine->ref_count);
+  return engine;
+}
+
+void abp_engine_unref(AbpEngine *engine) {
+  if (engine && g_atomic_int_dec_and_test(&engine->ref_count)) {
+    abp_engine_free(engine);
+  }
+}
+
+void abp_engine_free(AbpEngine *engine) {
+  if (!engine) return;
+  if (engine->snapshot) {
+    snapshot_close(engine->snapshot);
+  } else {
+    g_free((gpointer)engine->buckets[KIND_BLOCK]);
+    g_free((gpointer)engine->buckets[KIND_EXCEPTION]);
+    g_free((gpointer)engine->ids);
+  }
+  if (engine->filters) g_array_free(engine->filters, TRUE);
+  if (engine->domains) g_array_free(engine->domains, TRUE);
+  if (engine->pool) g_string_free(engine->pool, TRUE);
+  if (engine->strings) g_hash_table_destroy(engine->strings);
+  if (engine->domain_runs) g_hash_table_destroy(engine->domain_runs);
+  bloom_filter_free(engine->block_prefilter);
+  lazy_dfa_free(engine->automaton);
+  g_free(engine);
+}
@@ -0,0 +1,126 @@
+#ifndef ABP_ENGINE_H
+#define ABP_ENGINE_H
+
+#include <glib.h>
+#include "url_parser.h"
+#include "lazy_dfa.h"
+
+// Adblock Plus network filter engine. Supports "||host^" and "|" anchors,
+// "*" wildcards, "^" separators, "/regex/" filters, "@@" exceptions and the
+// $third-party, resource type, $domain=, $match-case, $important and
+// $redirect= (naming a bundled resource) options. Filters are bucketed by
+// their rarest token so a URL only tests a few candidates; regex filters
+// and wildcard filters without a token are compiled into one lazily built
+// DFA searched once per request.
+typedef struct AbpEngine AbpEngine;
+
+// Resource types a filter can be restricted to ($script, $image, ...)
+typedef enum {
+  ABP_TYPE_OTHER          = 1 << 0,
+  ABP_TYPE_SCRIPT         = 1 << 1,
+  ABP_TYPE_IMAGE          = 1 << 2,
+  ABP_TYPE_STYLESHEET     = 1 << 3,
+  ABP_TYPE_OBJECT         = 1 << 4,
+  ABP_TYPE_SUBDOCUMENT    = 1 << 5,
+  ABP_TYPE_DOCUMENT       = 1 << 6,
+  ABP_TYPE_XMLHTTPREQUEST = 1 << 7,
+  ABP_TYPE_MEDIA          = 1 << 8,
+  ABP_TYPE_FONT           = 1 << 9,
+  ABP_TYPE_WEBSOCKET      = 1 << 10,
+  ABP_TYPE_PING           = 1 << 11
+} AbpResourceType;
+
+#define ABP_TYPE_ALL 0x0fff
+
+// Request being checked. Unknown fields make context-dependent filters
+// ($third-party, $domain=, type options) fail closed, i.e. not match.
+typedef struct {
+  const ParsedUrl *url;
+  const ParsedUrl *document;  // first-party page, NULL if unknown
+  guint type;                 // AbpResourceType, 0 if unknown
+  gint third_party;           // 1 or 0, -1 to derive from document
+} AbpRequest;
+
+// Filter that decided the request
+typedef struct {
+  guint32 filter_id;
+  const char *text;           // original filter text
+  gboolean exception;         // an @@ filter allowed the request
+} AbpMatch;
+
+// Create an empty engine
+AbpEngine* abp_engine_new();
+
+// Parse and add one filter line. Returns FALSE for comments, cosmetic
+// filters and filters using unsupported syntax.
+gboolean abp_engine_add_filter(AbpEngine *engine, const char *line);
+
+// Add every line of a filter list buffer. Returns the number of filters added.
+guint abp_engine_add_filters(AbpEngine *engine, const char *text);
+
+// Load a filter list file (easylist.txt, easyprivacy.txt, ...)
+guint abp_engine_load_file(AbpEngine *engine, const char *path);
+
+// Build the token index. Must be called once after adding filters.
+void abp_engine_compile(AbpEngine *engine);
+
+// Returns TRUE if the request is blocked. match describes the deciding
+// filter, also when an exception allowed the request.
+gboolean abp_engine_match(const AbpEngine *engine, const AbpRequest *request, AbpMatch *match);
+
+// Returns TRUE if an @@ filter allows the request, whether or not a
+// blocking filter matches it. Lets the other blocking layers honor
+// exceptions from the filter lists.
+gboolean abp_engine_match_exception(const AbpEngine *engine, const AbpRequest *request,
+                                    AbpMatch *match);
+
+// Write the compiled engine to a snapshot file. source_key identifies the
+// filter lists it was built from.
+gboolean abp_engine_save_snapshot(const AbpEngine *engine, const char *path, guint64 source_key);
+
+// Open a compiled engine from a snapshot without parsing. The tables are
+// used straight from the mapping. Returns NULL if the snapshot is missing,
+// stale or damaged.
+AbpEngine* abp_engine_open_snapshot(const char *path, guint64 source_key);
+
+// Original text of filter id (0 .. filter count - 1), NULL if out of range
+const char* abp_engine_get_filter_text(const AbpEngine *engine, guint32 id);
+
+// Memory and measured false-positive rate of the Bloom filter consulted
+// before the blocking index
+void abp_engine_get_prefilter_stats(const AbpEngine *engine, gsize *size, double *fpr);
+
+// Size and state cache figures of the regex automaton
+void abp_engine_get_automaton_stats(const AbpEngine *engine, LazyDfaStats *stats);
+
+// Bytes held by a compiled engine, by what they store
+typedef struct {
+  guint n_filters;
+  gsize filters;              // fixed-size filter records
+  gsize domains;              // $domain= entries
+  gsize rule_text;            // original filter lines in the string pool
+  gsize patterns;             // patterns not found inside their line
+  gsize domain_names;
+  gsize shared;               // bytes saved by storing equal strings and domain lists once
+  gsize index;                // token buckets and filter id lists
+  gsize prefilter;
+  gsize automaton;            // NFA program and cached DFA states
+  gsize total;
+  gboolean mapped;            // tables are shared pages of a snapshot file
+} AbpMemoryReport;
+
+void abp_engine_get_memory_report(const AbpEngine *engine, AbpMemoryReport *report);
+
+// Number of network filters loaded, and lines skipped as unsupported
+guint abp_engine_get_filter_count(const AbpEngine *engine);
+guint abp_engine_get_unsupported_count(const AbpEngine *engine);
+
+// Take and drop a reference. A new engine holds one; the last unref frees
+// it. Both are safe to call from any thread.
+AbpEngine* abp_engine_ref(AbpEngine *engine);
+void abp_engine_unref(AbpEngine *engine);
+
+// Free engine regardless of references
+void abp_engine_free(AbpEngine *engine);
+
+#endif // ABP_ENGINE_H
@@ -3,44 +3,809 @@
 #include "privacy_script.h"
 #include "network_blocker.h"
 #include "adblockplus_integration.h"
+#include "web_extension.h"
+#include "snapshot.h"
+#include "rule_profiler.h"
+#include "site_allowlist.h"
+#include "cosmetic_filter.h"
+#include "redirect_resources.h"
+#include "url_parser.h"
 #include <stdio.h>
 #include <string.h>
 
 // Enhanced ad blocking rules based on EasyList, EasyPrivacy, Fanboy Lists
 static const char *DEFAULT_ADS_JSON = "[]"; // Fallback empty
 
+// Content filter lists compiled from fang/blocked_content_<name>.json
+static const char *CONTENT_FILTERS[] = {"ads", "privacy", "annoyance", "unbreak", NULL};
+
 static void on_filter_loaded(WebKitUserContentFilterStore *store, GAsyncResult *result, BrowserApp *app);
 
+// Hashes of the JSON (allowlist rule included) each list in the filter
+// store was compiled from, so lists that did not change are loaded as
+// compiled instead of compiled again at every launch
+#define CONTENT_FILTER_MANIFEST "content_filters.manifest"
+
+static GHashTable *filter_manifest = NULL;   // list name -> SHA-256 of its JSON
+
+// Manifest lines are "name<TAB>hash"; a missing or damaged file is empty
+static GHashTable* get_filter_manifest() {
+  if (filter_manifest) return filter_manifest;
+  
+  filter_manifest = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  gchar *path = snapshot_build_path(CONTENT_FILTER_MANIFEST);
+  gchar *contents = NULL;
+  if (g_file_get_contents(path, &contents, NULL, NULL)) {
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    for (int i = 0; lines[i] != NULL; i++) {
+      gchar **fields = g_strsplit(lines[i], "\t", 2);
+      if (g_strv_length(fields) == 2) {
+        g_hash_table_replace(filter_manifest, g_strdup(fields[0]), g_strdup(fields[1]));
+      }
+      g_strfreev(fields);
+    }
+    g_strfreev(lines);
+    g_free(contents);
+  }
+  g_free(path);
+  return filter_manifest;
+}
+
+static void set_filter_manifest_entry(const char *name, const char *hash) {
+  GHashTable *manifest = get_filter_manifest();
+  if (hash) g_hash_table_replace(manifest, g_strdup(name), g_strdup(hash));
+  else g_hash_table_remove(manifest, name);
+  
+  GString *out = g_string_new(NULL);
+  for (int i = 0; CONTENT_FILTERS[i] != NULL; i++) {
+    const char *entry = (const char *)g_hash_table_lookup(manifest, CONTENT_FILTERS[i]);
+    if (entry) g_string_append_printf(out, "%s\t%s\n", CONTENT_FILTERS[i], entry);
+  }
+  gchar *path = snapshot_build_path(CONTENT_FILTER_MANIFEST);
+  GError *error = NULL;
+  if (!g_file_set_contents(path, out->str, out->len, &error)) {
+    g_warning("AdBlocker: Cannot write %s: %s", path, error->message);
+    g_error_free(error);
+  }
+  g_free(path);
+  g_string_free(out, TRUE);
+}
+
+// One round of content filter compilation. Once every list is saved, the
+// tabs showing site are reloaded so they pick up the new filters.
+typedef struct {
+  BrowserApp *app;
+  gchar *site;            // registrable domain, NULL for no reload
+  guint pending;
+} FilterCompile;
+
+// One list of a round: its JSON and the hash recorded once it is compiled
+typedef struct {
+  FilterCompile *compile;
+  const char *name;
+  GBytes *json;
+  gchar *hash;
+} FilterJob;
+
+static void reload_site_tabs(BrowserApp *app, const char *site) {
+  GList *iter;
+  for (iter = app->tabs; iter != NULL; iter = iter->next) {
+    BrowserTab *tab = (BrowserTab *)iter->data;
+    gchar *domain = site_allowlist_domain_for_uri(webkit_web_view_get_uri(tab->web_view));
+    if (g_strcmp0(domain, site) == 0) {
+      webkit_web_view_reload(tab->web_view);
+    }
+    g_free(domain);
+  }
+}
+
+static void finish_filter_compile(FilterCompile *compile) {
+  if (compile->site) reload_site_tabs(compile->app, compile->site);
+  g_free(compile->site);
+  g_free(compile);
+}
+
+static void finish_filter_job(FilterJob *job) {
+  FilterCompile *compile = job->compile;
+  g_bytes_unref(job->json);
+  g_free(job->hash);
+  g_free(job);
+  if (--compile->pending == 0) finish_filter_compile(compile);
+}
+
+// Make filter the active version of its list, in every tab
+static void activate_filter(BrowserApp *app, WebKitUserContentFilter *filter) {
+  const char *identifier = webkit_user_content_filter_get_identifier(filter);
+  
+  // A recompiled list replaces its previous version
+  GList *iter;
+  for (iter = app->active_filters; iter != NULL; iter = iter->next) {
+    WebKitUserContentFilter *old = (WebKitUserContentFilter *)iter->data;
+    if (g_strcmp0(webkit_user_content_filter_get_identifier(old), identifier) == 0) {
+      app->active_filters = g_list_delete_link(app->active_filters, iter);
+      webkit_user_content_filter_unref(old);
+      break;
+    }
+  }
+  
+  // IMPORTANT FIX: Transfer ownership to the app instead of unreffing immediately
+  // This keeps the filter alive even if there are no tabs yet.
+  app->active_filters = g_list_append(app->active_filters, filter);
+  
+  // Apply the new filter to any existing tabs (if any)
+  for (iter = app->tabs; iter != NULL; iter = iter->next) {
+    BrowserTab *tab = (BrowserTab *)iter->data;
+    WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(tab->web_view);
+    webkit_user_content_manager_remove_filter_by_id(manager, identifier);
+    if (app->adblock_enabled) {
+      webkit_user_content_manager_add_filter(manager, filter);
+    }
+  }
+}
+
 // === FIX #1: Correct Logic for Saved Filters ===
-static void on_filter_saved(WebKitUserContentFilterStore *store, GAsyncResult *result, BrowserApp *app) {
+static void on_filter_saved(WebKitUserContentFilterStore *store, GAsyncResult *result, FilterJob *job) {
+  BrowserApp *app = job->compile->app;
   GError *error = NULL;
   WebKitUserContentFilter *filter = webkit_user_content_filter_store_save_finish(store, result, &error);
   
   if (filter) {
-    g_print("AdBlocker: Rules compiled and saved successfully: %s\n", webkit_user_content_filter_get_identifier(filter));
+    g_print("AdBlocker: Rules compiled and saved successfully: %s\n",
+            webkit_user_content_filter_get_identifier(filter));
+    // We do NOT unref here: activate_filter stores it in app->active_filters.
+    // It will be freed later when we clear that list.
+    activate_filter(app, filter);
+    set_filter_manifest_entry(job->name, job->hash);
+  } else {
+    g_warning("AdBlocker: Failed to save rules: %s", error->message);
+    g_error_free(error);
+    set_filter_manifest_entry(job->name, NULL);
+  }
+  
+  finish_filter_job(job);
+}
+
+static void save_filter(FilterJob *job) {
+  BrowserApp *app = job->compile->app;
+  g_print("AdBlocker: Compiling %lu bytes of rules for %s...\n", g_bytes_get_size(job->json), job->name);
+  webkit_user_content_filter_store_save(app->filter_store, job->name, job->json, NULL,
+                                        (GAsyncReadyCallback)on_filter_saved, job);
+}
+
+// A list whose JSON matches the manifest is loaded as compiled; if the
+// store lost it (or a WebKit update cannot read it) it is compiled again
+static void on_unchanged_filter_loaded(WebKitUserContentFilterStore *store, GAsyncResult *result,
+                                       FilterJob *job) {
+  GError *error = NULL;
+  WebKitUserContentFilter *filter = webkit_user_content_filter_store_load_finish(store, result, &error);
+  if (!filter) {
+    g_print("AdBlocker: Compiled %s unavailable (%s), recompiling\n", job->name,
+            error ? error->message : "unknown error");
+    if (error) g_error_free(error);
+    save_filter(job);
+    return;
+  }
+  
+  g_print("AdBlocker: Filter %s unchanged, loaded as compiled\n", job->name);
+  activate_filter(job->compile->app, filter);
+  finish_filter_job(job);
+}
+
+// Content blocker lists cannot except each other's rules, so each list ends
+// with an ignore-previous-rules rule for the pages of allowlisted sites
+static GBytes* add_allowlist_rule(gchar *json, gsize json_len) {
+  gchar **sites = site_allowlist_get_domains();
+  gchar *end = g_strrstr_len(json, (gssize)json_len, "]");
+  if (!sites[0] || !end) {
+    g_strfreev(sites);
+    return g_bytes_new_take(json, json_len);
+  }
+  
+  GString *out = g_string_new_len(json, end - json);
+  gchar *last = end;
+  while (last > json && g_ascii_isspace(last[-1])) last--;
+  if (last > json && last[-1] != '[') g_string_append_c(out, ',');
+  
+  g_string_append(out, "{\"trigger\":{\"url-filter\":\".*\",\"if-domain\":[");
+  for (int i = 0; sites[i] != NULL; i++) {
+    g_string_append_printf(out, "%s\"*%s\"", i > 0 ? "," : "", sites[i]);
+  }
+  g_string_append(out, "]},\"action\":{\"type\":\"ignore-previous-rules\"}}");
+  g_string_append_len(out, end, json + json_len - end);
+  
+  g_strfreev(sites);
+  g_free(json);
+  gsize len = out->len;
+  return g_bytes_new_take(g_string_free(out, FALSE), len);
+}
+
+// Compile every JSON list that changed since it was last compiled into the
+// filter store. Unchanged lists, and lists without JSON, are loaded from
+// the store as compiled before when from_cache is set; otherwise they are
+// already active and left alone.
+static void compile_content_filters(BrowserApp *app, const char *site, gboolean from_cache) {
+  FilterCompile *compile = g_new0(FilterCompile, 1);
+  compile->app = app;
+  compile->site = g_strdup(site);
+  compile->pending = 1;
+  GHashTable *manifest = get_filter_manifest();
+  
+  for (int i = 0; CONTENT_FILTERS[i] != NULL; i++) {
+      char filename[256];
+      snprintf(filename, sizeof(filename), "fang/blocked_content_%s.json", CONTENT_FILTERS[i]);
+      
+      char *json_content = NULL;
+      gsize json_len = 0;
+      GError *file_error = NULL;
+      
+      // Attempt to load JSON source to compile/update
+      if (g_file_get_contents(filename, &json_content, &json_len, &file_error)) {
+          FilterJob *job = g_new0(FilterJob, 1);
+          job->compile = compile;
+          job->name = CONTENT_FILTERS[i];
+          job->json = add_allowlist_rule(json_content, json_len);
+          job->hash = g_compute_checksum_for_bytes(G_CHECKSUM_SHA256, job->json);
+          compile->pending++;
+          
+          const char *compiled_hash = (const char *)g_hash_table_lookup(manifest, job->name);
+          if (g_strcmp0(compiled_hash, job->hash) != 0) {
+              save_filter(job);
+          } else if (from_cache) {
+              webkit_user_content_filter_store_load(app->filter_store, job->name, NULL,
+                                                    (GAsyncReadyCallback)on_unchanged_filter_loaded, job);
+          } else {
+              finish_filter_job(job);
+          }
+      } else {
+          if (file_error) g_error_free(file_error);
+          if (!from_cache) continue;
+          
+          // Fallback: Load existing compiled binary if JSON missing
+          g_warning("AdBlocker: JSON %s not found. Loading cached filter...", filename);
+          webkit_user_content_filter_store_load(app->filter_store, CONTENT_FILTERS[i], NULL,
+                                                (GAsyncReadyCallback)on_filter_loaded, app);
+      }
+  }
+  
+  if (--compile->pending == 0) finish_filter_compile(compile);
+}
+
+// ========== Element Hiding ==========
+
+// Site stylesheets and scripts kept; a cache is emptied when it fills up
+#define SITE_STYLE_SHEET_CACHE_SIZE 256
+
+// Class and id names taken from one message of a page, and kept per page.
+// Pages post them, so they are bounded whatever a page sends.
+#define COSMETIC_MESSAGE_MAX_TOKENS 16384
+#define COSMETIC_PAGE_MAX_TOKENS 4096
+
+// Scriptlet filters of the lists compiled to content filters, which
+// cannot express them
+#define SCRIPTLET_FILTERS_FILE "fang/scriptlets.txt"
+
+// Add "*://*.example.com/*", which also matches example.com itself, for
+// each host and free hosts
+static void add_host_patterns(GPtrArray *patterns, gchar **hosts) {
+  for (int i = 0; hosts[i] != NULL; i++) {
+    g_ptr_array_add(patterns, g_strdup_printf("*://*.%s/*", hosts[i]));
+  }
+  g_strfreev(hosts);
+}
+
+// NULL-terminated copy of patterns, NULL when there are none
+static gchar** finish_patterns(GPtrArray *patterns) {
+  if (patterns->len == 0) {
+    g_ptr_array_free(patterns, TRUE);
+    return NULL;
+  }
+  g_ptr_array_add(patterns, NULL);
+  return (gchar **)g_ptr_array_free(patterns, FALSE);
+}
+
+// URL patterns of allowlisted pages, NULL when there are none
+static gchar** build_allowlist_patterns() {
+  GPtrArray *patterns = g_ptr_array_new();
+  add_host_patterns(patterns, site_allowlist_get_domains());
+  return finish_patterns(patterns);
+}
+
+// Element hiding filters of the filter lists on top of the built-in
+// selectors. Touches no shared state, so it runs on a worker thread, at
+// startup and on reloads.
+static CosmeticIndex* build_cosmetic_index(gboolean lazy_generic) {
+  CosmeticIndex *index = cosmetic_index_new();
+  cosmetic_index_set_lazy_generic(index, lazy_generic);
+  const char **selectors = adblockplus_get_ad_hiding_selectors();
+  for (int i = 0; selectors[i] != NULL; i++) {
+    cosmetic_index_add_selector(index, selectors[i]);
+  }
+  const char **rules = adblockplus_get_rules();
+  for (int i = 0; rules[i] != NULL; i++) {
+    cosmetic_index_add_filter(index, rules[i]);
+  }
+  const char **lists = adblockplus_get_filter_lists();
+  for (int i = 0; lists[i] != NULL; i++) {
+    cosmetic_index_load_file(index, lists[i]);
+  }
+  cosmetic_index_load_file(index, SCRIPTLET_FILTERS_FILE);
+  cosmetic_index_compile(index);
+  
+  g_print("AdBlocker: %u element hiding filters, %u generic selectors (%u by class or id on "
+          "demand), %u sites with their own, %u scriptlet filters\n",
+          cosmetic_index_get_filter_count(index), cosmetic_index_get_generic_count(index),
+          cosmetic_index_get_keyed_count(index), cosmetic_index_get_host_count(index),
+          cosmetic_index_get_script_count(index));
+  return index;
+}
+
+static void free_style_sheet(gpointer sheet) {
+  if (sheet) webkit_user_style_sheet_unref((WebKitUserStyleSheet *)sheet);
+}
+
+static void free_user_script(gpointer script) {
+  if (script) webkit_user_script_unref((WebKitUserScript *)script);
+}
+
+// Generic selectors hide elements in every frame of every page, except on
+// allowlisted sites and on hosts excepting some of them, whose own
+// stylesheet carries the rest. In lazy mode the observer script reporting
+// class and id names goes to the same pages, plus those hosts.
+static void build_generic_style_sheet(BrowserApp *app) {
+  free_style_sheet(app->generic_style_sheet);
+  if (app->cosmetic_script) {
+    webkit_user_script_unref(app->cosmetic_script);
+    app->cosmetic_script = NULL;
+  }
+  
+  if (app->lazy_cosmetics) {
+    gchar *observer = generate_cosmetic_token_script();
+    gchar **allowed_pages = build_allowlist_patterns();
+    app->cosmetic_script = webkit_user_script_new(
+      observer,
+      WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES,
+      WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START,
+      NULL, (const gchar * const *)allowed_pages
+    );
+    g_strfreev(allowed_pages);
+    free_ad_blocking_script(observer);
+  }
+  
+  GPtrArray *patterns = g_ptr_array_new();
+  add_host_patterns(patterns, site_allowlist_get_domains());
+  add_host_patterns(patterns, cosmetic_index_get_generic_excepted_hosts(app->cosmetic_index));
+  gchar **skipped_pages = finish_patterns(patterns);
+  app->generic_style_sheet = webkit_user_style_sheet_new(
+    cosmetic_index_get_generic_css(app->cosmetic_index),
+    WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES,
+    WEBKIT_USER_STYLE_LEVEL_USER,
+    NULL, (const gchar * const *)skipped_pages
+  );
+  g_strfreev(skipped_pages);
+}
+
+// Stylesheet for the pages of host, built on first use and shared by
+// every tab showing the site. NULL when the filters hide nothing there.
+static WebKitUserStyleSheet* get_site_style_sheet(BrowserApp *app, const char *host) {
+  gpointer sheet = NULL;
+  if (g_hash_table_lookup_extended(app->site_style_sheets, host, NULL, &sheet)) {
+    return (WebKitUserStyleSheet *)sheet;
+  }
+  
+  if (g_hash_table_size(app->site_style_sheets) >= SITE_STYLE_SHEET_CACHE_SIZE) {
+    g_hash_table_remove_all(app->site_style_sheets);
+  }
+  gchar *css = cosmetic_index_build_host_css(app->cosmetic_index, host, strlen(host));
+  if (css) {
+    sheet = webkit_user_style_sheet_new(css, WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
+                                        WEBKIT_USER_STYLE_LEVEL_USER, NULL, NULL);
+    g_free(css);
+  }
+  g_hash_table_insert(app->site_style_sheets, g_strdup(host), sheet);
+  return (WebKitUserStyleSheet *)sheet;
+}
+
+// Scriptlets of host in one script, run before the page's own scripts.
+// Limited to the host by URL pattern, so a tab whose script is swapped
+// late on a cross-host redirect never runs another site's scriptlets.
+static WebKitUserScript* get_site_script(BrowserApp *app, const char *host) {
+  gpointer script = NULL;
+  if (g_hash_table_lookup_extended(app->site_scripts, host, NULL, &script)) {
+    return (WebKitUserScript *)script;
+  }
+  
+  if (g_hash_table_size(app->site_scripts) >= SITE_STYLE_SHEET_CACHE_SIZE) {
+    g_hash_table_remove_all(app->site_scripts);
+  }
+  gchar *source = cosmetic_index_build_host_script(app->cosmetic_index, host, strlen(host));
+  if (source) {
+    gchar *pattern = g_strdup_printf("*://%s/*", host);
+    const gchar *allowed_pages[] = { pattern, NULL };
+    script = webkit_user_script_new(
+      source,
+      WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
+      WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START,
+      allowed_pages, NULL
+    );
+    g_free(pattern);
+    g_free(source);
+  }
+  g_hash_table_insert(app->site_scripts, g_strdup(host), script);
+  return (WebKitUserScript *)script;
+}
+
+// Generic selectors the page of a tab asked for with its class and id
+// names, in one stylesheet replaced as it grows. Kept until the tab moves
+// to another host; pages of the same host report their names again.
+typedef struct {
+  gchar *host;
+  GHashTable *tokens;           // ".class" and "#id" reported that key a selector
+  GHashTable *injected;         // selector ids in css
+  GString *css;
+  WebKitUserStyleSheet *sheet;
+} TokenStyles;
+
+static TokenStyles* token_styles_new(const char *host) {
+  TokenStyles *styles = g_new0(TokenStyles, 1);
+  styles->host = g_strdup(host);
+  styles->tokens = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  styles->injected = g_hash_table_new(g_direct_hash, g_direct_equal);
+  styles->css = g_string_new(NULL);
+  return styles;
+}
+
+static void token_styles_free(gpointer data) {
+  TokenStyles *styles = (TokenStyles *)data;
+  g_free(styles->host);
+  g_hash_table_unref(styles->tokens);
+  g_hash_table_unref(styles->injected);
+  g_string_free(styles->css, TRUE);
+  free_style_sheet(styles->sheet);
+  g_free(styles);
+}
+
+// Add the generic selectors keyed by tokens the page does not have yet
+static void inject_token_styles(BrowserApp *app, WebKitUserContentManager *manager,
+                                TokenStyles *styles, const char * const *tokens) {
+  gchar *css = cosmetic_index_build_token_css(app->cosmetic_index, styles->host,
+                                              strlen(styles->host), tokens, styles->injected);
+  if (!css) return;
+  
+  g_string_append(styles->css, css);
+  g_free(css);
+  if (styles->sheet) {
+    webkit_user_content_manager_remove_style_sheet(manager, styles->sheet);
+    webkit_user_style_sheet_unref(styles->sheet);
+  }
+  styles->sheet = webkit_user_style_sheet_new(styles->css->str, WEBKIT_USER_CONTENT_INJECT_ALL_FRAMES,
+                                              WEBKIT_USER_STYLE_LEVEL_USER, NULL, NULL);
+  webkit_user_content_manager_add_style_sheet(manager, styles->sheet);
+}
+
+static void on_cosmetic_tokens(WebKitUserContentManager *manager, WebKitJavascriptResult *result,
+                               BrowserApp *app) {
+  if (!app->adblock_enabled) return;
+  
+  GList *iter;
+  TokenStyles *styles = NULL;
+  for (iter = app->tabs; iter != NULL && !styles; iter = iter->next) {
+    BrowserTab *tab = (BrowserTab *)iter->data;
+    if (webkit_web_view_get_user_content_manager(tab->web_view) == manager) {
+      styles = (TokenStyles *)g_object_get_data(G_OBJECT(tab->web_view), "cosmetic-tokens");
+    }
+  }
+  JSCValue *value = webkit_javascript_result_get_js_value(result);
+  if (!styles || !jsc_value_is_string(value)) return;
+  
+  // Names no generic selector is keyed by can never hide anything. Before
+  // the first index is built every name is kept, and the page gets its
+  // stylesheet once the index is swapped in.
+  gchar *text = jsc_value_to_string(value);
+  gchar **reported = g_strsplit(text, " ", COSMETIC_MESSAGE_MAX_TOKENS + 1);
+  GPtrArray *tokens = g_ptr_array_new();
+  for (int i = 0; reported[i] != NULL && i < COSMETIC_MESSAGE_MAX_TOKENS; i++) {
+    if (g_hash_table_size(styles->tokens) >= COSMETIC_PAGE_MAX_TOKENS) break;
+    if (app->cosmetic_index && !cosmetic_index_has_token(app->cosmetic_index, reported[i])) continue;
+    if (g_hash_table_add(styles->tokens, g_strdup(reported[i]))) {
+      g_ptr_array_add(tokens, reported[i]);
+    }
+  }
+  g_ptr_array_add(tokens, NULL);
+  if (tokens->len > 1 && app->cosmetic_index) {
+    inject_token_styles(app, manager, styles, (const char * const *)tokens->pdata);
+  }
+  g_ptr_array_free(tokens, TRUE);
+  g_strfreev(reported);
+  g_free(text);
+}
+
+void adblocker_setup_web_view(BrowserApp *app, WebKitWebView *web_view) {
+  WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(web_view);
+  if (webkit_user_content_manager_register_script_message_handler(manager, COSMETIC_MESSAGE_HANDLER)) {
+    g_signal_connect(manager, "script-message-received::" COSMETIC_MESSAGE_HANDLER,
+                     G_CALLBACK(on_cosmetic_tokens), app);
+  }
+  adblocker_apply_cosmetic_filters(app, web_view);
+}
+
+void adblocker_update_site_filters(BrowserApp *app, WebKitWebView *web_view) {
+  if (!web_view) return;
+  
+  ParsedUrl url;
+  gboolean parsed = url_parser_parse(&url, webkit_web_view_get_uri(web_view));
+  gchar *host = parsed ? g_strndup(url_span_lower(&url, url.host), url.host.len) : NULL;
+  gboolean allowed = parsed && site_allowlist_contains(&url);
+  url_parser_clear(&url);
+  
+  if (g_strcmp0(host, (const char *)g_object_get_data(G_OBJECT(web_view), "cosmetic-host")) == 0) {
+    g_free(host);
+    return;
+  }
+  
+  WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(web_view);
+  WebKitUserStyleSheet *old = (WebKitUserStyleSheet *)g_object_get_data(G_OBJECT(web_view), "cosmetic-sheet");
+  if (old) webkit_user_content_manager_remove_style_sheet(manager, old);
+  TokenStyles *old_tokens = (TokenStyles *)g_object_get_data(G_OBJECT(web_view), "cosmetic-tokens");
+  if (old_tokens && old_tokens->sheet) {
+    webkit_user_content_manager_remove_style_sheet(manager, old_tokens->sheet);
+  }
+  WebKitUserScript *old_script = (WebKitUserScript *)g_object_get_data(G_OBJECT(web_view), "cosmetic-script");
+  if (old_script) webkit_user_content_manager_remove_script(manager, old_script);
+  
+  WebKitUserStyleSheet *sheet = NULL;
+  WebKitUserScript *script = NULL;
+  if (host && !allowed && app->adblock_enabled && app->cosmetic_index) {
+    sheet = get_site_style_sheet(app, host);
+    script = get_site_script(app, host);
+  }
+  if (sheet) {
+    webkit_user_content_manager_add_style_sheet(manager, sheet);
+    g_object_set_data_full(G_OBJECT(web_view), "cosmetic-sheet", webkit_user_style_sheet_ref(sheet),
+                           free_style_sheet);
+  } else {
+    g_object_set_data(G_OBJECT(web_view), "cosmetic-sheet", NULL);
+  }
+  if (script) {
+    webkit_user_content_manager_add_script(manager, script);
+    g_object_set_data_full(G_OBJECT(web_view), "cosmetic-script", webkit_user_script_ref(script),
+                           free_user_script);
+  } else {
+    g_object_set_data(G_OBJECT(web_view), "cosmetic-script", NULL);
+  }
+  if (app->cosmetic_script && host && !allowed && app->adblock_enabled) {
+    g_object_set_data_full(G_OBJECT(web_view), "cosmetic-tokens", token_styles_new(host),
+                           token_styles_free);
+  } else {
+    g_object_set_data(G_OBJECT(web_view), "cosmetic-tokens", NULL);
+  }
+  g_object_set_data_full(G_OBJECT(web_view), "cosmetic-host", host, host ? g_free : NULL);
+}
+
+// Names reported before the index was built, or keying no selector of a
+// new index, are dropped as it is swapped in
+static gboolean is_unknown_token(gpointer token, gpointer, gpointer index) {
+  return !cosmetic_index_has_token((const CosmeticIndex *)index, (const char *)token);
+}
+
+void adblocker_apply_cosmetic_filters(BrowserApp *app, WebKitWebView *web_view) {
+  if (!web_view) return;
+  
+  // The page reported its names once; they are kept to rebuild its
+  // stylesheet from a new index or after blocking comes back on
+  TokenStyles *reported = (TokenStyles *)g_object_steal_data(G_OBJECT(web_view), "cosmetic-tokens");
+  WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(web_view);
+  webkit_user_content_manager_remove_all_style_sheets(manager);
+  WebKitUserScript *script = (WebKitUserScript *)g_object_get_data(G_OBJECT(web_view), "cosmetic-script");
+  if (script) webkit_user_content_manager_remove_script(manager, script);
+  g_object_set_data(G_OBJECT(web_view), "cosmetic-script", NULL);
+  g_object_set_data(G_OBJECT(web_view), "cosmetic-sheet", NULL);
+  g_object_set_data(G_OBJECT(web_view), "cosmetic-host", NULL);
+  
+  if (app->adblock_enabled) {
+    if (app->generic_style_sheet) {
+      webkit_user_content_manager_add_style_sheet(manager, app->generic_style_sheet);
+    }
+    adblocker_update_site_filters(app, web_view);
     
-    // IMPORTANT FIX: Transfer ownership to the app instead of unreffing immediately
-    // This keeps the filter alive even if there are no tabs yet.
-    app->active_filters = g_list_append(app->active_filters, filter);
+    TokenStyles *styles = (TokenStyles *)g_object_get_data(G_OBJECT(web_view), "cosmetic-tokens");
+    if (reported && styles && strcmp(reported->host, styles->host) == 0) {
+      g_hash_table_unref(styles->tokens);
+      styles->tokens = g_hash_table_ref(reported->tokens);
+      if (app->cosmetic_index) {
+        g_hash_table_foreach_remove(styles->tokens, is_unknown_token, app->cosmetic_index);
+        gchar **tokens = (gchar **)g_hash_table_get_keys_as_array(styles->tokens, NULL);
+        inject_token_styles(app, manager, styles, (const char * const *)tokens);
+        g_free(tokens);
+      }
+    }
+  } else if (reported) {
+    // Without its stylesheet until blocking comes back on
+    free_style_sheet(reported->sheet);
+    reported->sheet = NULL;
+    g_hash_table_remove_all(reported->injected);
+    g_string_truncate(reported->css, 0);
+    g_object_set_data_full(G_OBJECT(web_view), "cosmetic-tokens", reported, token_styles_free);
+    reported = NULL;
+  }
+  if (reported) token_styles_free(reported);
+}
+
+static void cosmetic_rebuild_thread(GTask *task, gpointer source_object, gpointer task_data,
+                                    GCancellable *cancellable) {
+  gboolean lazy_generic = GPOINTER_TO_INT(task_data);
+  g_task_return_pointer(task, build_cosmetic_index(lazy_generic), (GDestroyNotify)cosmetic_index_free);
+}
+
+// Last step of startup and of a rules reload: the site stylesheets of the
+// old index go and every tab gets the new ones, along with the generic
+// selectors keyed by the names its page reported so far
+static void on_cosmetic_filters_rebuilt(GObject *source, GAsyncResult *result, gpointer user_data) {
+  BrowserApp *app = (BrowserApp *)user_data;
+  CosmeticIndex *index = (CosmeticIndex *)g_task_propagate_pointer(G_TASK(result), NULL);
+  if (index) {
+    cosmetic_index_free(app->cosmetic_index);
+    app->cosmetic_index = index;
+    g_hash_table_remove_all(app->site_style_sheets);
+    g_hash_table_remove_all(app->site_scripts);
+    build_generic_style_sheet(app);
     
-    // Apply the new filter to any existing tabs (if any)
     GList *iter;
     for (iter = app->tabs; iter != NULL; iter = iter->next) {
       BrowserTab *tab = (BrowserTab *)iter->data;
-      WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(tab->web_view);
-      if (app->adblock_enabled) {
-        webkit_user_content_manager_add_filter(manager, filter);
-      }
+      adblocker_apply_cosmetic_filters(app, tab->web_view);
+    }
+  }
+  
+  app->rules_reloading = FALSE;
+  if (app->rules_reload_pending) {
+    app->rules_reload_pending = FALSE;
+    adblocker_reload_rules(app);
+  }
+}
+
+// Build the element hiding index on a worker thread and swap it in. Runs
+// with rules_reloading set, so list changes meanwhile queue a reload.
+static void rebuild_cosmetic_filters(BrowserApp *app) {
+  GTask *task = g_task_new(NULL, NULL, on_cosmetic_filters_rebuilt, app);
+  g_task_set_task_data(task, GINT_TO_POINTER(app->lazy_cosmetics), NULL);
+  g_task_run_in_thread(task, cosmetic_rebuild_thread);
+  g_object_unref(task);
+}
+
+static void on_rules_reloaded(GObject *source, GAsyncResult *result, gpointer user_data) {
+  BrowserApp *app = (BrowserApp *)user_data;
+  GError *error = NULL;
+  
+  if (adblockplus_reload_finish(result, &error)) {
+    // Verdicts and rule pointers of the old engine go with it. Web
+    // processes map the snapshot the rebuild just wrote.
+    network_blocker_invalidate_cache();
+    if (app->web_context) {
+        webkit_web_context_send_message_to_all_extensions(
+            app->web_context, webkit_user_message_new(WEB_EXTENSION_MESSAGE_RELOAD, NULL));
     }
-    
-    // REMOVED: g_object_unref(filter); 
-    // We do NOT unref here because we stored it in app->active_filters.
-    // It will be freed later when we clear that list.
-    
   } else {
-    g_warning("AdBlocker: Failed to save rules: %s", error->message);
+    g_warning("AdBlocker: Filter reload failed: %s", error ? error->message : "unknown error");
+    if (error) g_error_free(error);
+  }
+  
+  // Element hiding filters come from the same lists
+  rebuild_cosmetic_filters(app);
+}
+
+void adblocker_reload_rules(BrowserApp *app) {
+  // Changes arriving during a rebuild are picked up by one more rebuild
+  if (app->rules_reloading) {
+    app->rules_reload_pending = TRUE;
+    return;
+  }
+  app->rules_reloading = TRUE;
+  adblockplus_reload_async(on_rules_reloaded, app);
+}
+
+void adblocker_dump_rule_stats(BrowserApp *app) {
+  gchar *path = snapshot_build_path("rule_stats.tsv");
+  network_blocker_dump_stats(path);
+  g_free(path);
+  network_blocker_log_top_rules(20);
+  if (rule_profiler_enabled()) {
+      path = snapshot_build_path("rule_profile.tsv");
+      rule_profiler_write_report(path);
+      g_free(path);
+      rule_profiler_log_report(20);
+  }
+  
+  if (app->web_context) {
+      webkit_web_context_send_message_to_all_extensions(
+          app->web_context, webkit_user_message_new(WEB_EXTENSION_MESSAGE_DUMP_STATS, NULL));
+  }
+}
+
+static void on_filter_list_changed(GFileMonitor *monitor, GFile *file, GFile *other_file,
+                                   GFileMonitorEvent event_type, BrowserApp *app) {
+  if (event_type != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
+      event_type != G_FILE_MONITOR_EVENT_CREATED &&
+      event_type != G_FILE_MONITOR_EVENT_DELETED) {
+    return;
+  }
+  
+  gchar *path = g_file_get_path(file);
+  g_print("AdBlocker: Filter list %s changed, rebuilding\n", path);
+  g_free(path);
+  adblocker_reload_rules(app);
+}
+
+static void watch_filter_list(BrowserApp *app, const char *path) {
+  GFile *file = g_file_new_for_path(path);
+  GFileMonitor *monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
+  g_object_unref(file);
+  if (!monitor) return;
+  
+  g_signal_connect(monitor, "changed", G_CALLBACK(on_filter_list_changed), app);
+  g_ptr_array_add(app->filter_monitors, monitor);
+}
+
+// Rebuild the network filters whenever update-adblock rewrites a list
+static void watch_filter_lists(BrowserApp *app) {
+  if (app->filter_monitors) return;
+  
+  app->filter_monitors = g_ptr_array_new_with_free_func(g_object_unref);
+  const char **lists = adblockplus_get_filter_lists();
+  for (int i = 0; lists[i] != NULL; i++) {
+    watch_filter_list(app, lists[i]);
+  }
+  watch_filter_list(app, SCRIPTLET_FILTERS_FILE);
+}
+
+// Subresources are blocked inside the web processes by the extension
+// library; it must be registered before the first web view is created.
+static void setup_web_extension(BrowserApp *app) {
+  if (!app->web_context) return;
+  
+  gchar *cwd = g_get_current_dir();
+  gchar *dir = g_build_filename(cwd, WEB_EXTENSION_DIR, NULL);
+  webkit_web_context_set_web_extensions_directory(app->web_context, dir);
+  webkit_web_context_set_web_extensions_initialization_user_data(
+      app->web_context, g_variant_new_boolean(app->adblock_enabled));
+  g_print("AdBlocker: Loading web process extension from %s\n", dir);
+  g_free(dir);
+  g_free(cwd);
+}
+
+// Stand-ins for blocked requests, which web processes redirect to this
+// scheme. Pages load them from https and fetch them cross-origin, so the
+// scheme is secure and CORS-enabled, and answers allow any origin.
+static void on_redirect_resource_request(WebKitURISchemeRequest *request, gpointer user_data) {
+  const RedirectResource *resource = redirect_resource_from_path(webkit_uri_scheme_request_get_path(request));
+  if (!resource) {
+    GError *error = g_error_new(G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "No resource %s",
+                                webkit_uri_scheme_request_get_path(request));
+    webkit_uri_scheme_request_finish_error(request, error);
     g_error_free(error);
+    return;
   }
+  
+  GInputStream *stream = g_memory_input_stream_new_from_data(resource->data, resource->len, NULL);
+  WebKitURISchemeResponse *response = webkit_uri_scheme_response_new(stream, resource->len);
+  webkit_uri_scheme_response_set_content_type(response, resource->content_type);
+  SoupMessageHeaders *headers = soup_message_headers_new(SOUP_MESSAGE_HEADERS_RESPONSE);
+  soup_message_headers_append(headers, "Access-Control-Allow-Origin", "*");
+  webkit_uri_scheme_response_set_http_headers(response, headers);
+  webkit_uri_scheme_request_finish_with_response(request, response);
+  g_object_unref(response);
+  g_object_unref(stream);
+}
+
+static void setup_redirect_resources(BrowserApp *app) {
+  if (!app->web_context) return;
+  
+  webkit_web_context_register_uri_scheme(app->web_context, REDIRECT_RESOURCE_SCHEME,
+                                         on_redirect_resource_request, app, NULL);
+  WebKitSecurityManager *security = webkit_web_context_get_security_manager(app->web_context);
+  webkit_security_manager_register_uri_scheme_as_secure(security, REDIRECT_RESOURCE_SCHEME);
+  webkit_security_manager_register_uri_scheme_as_cors_enabled(security, REDIRECT_RESOURCE_SCHEME);
+  g_print("AdBlocker: Serving %u redirect resources from %s\n", redirect_resource_get_count(),
+          REDIRECT_RESOURCE_SCHEME);
 }
 
 void adblocker_init(BrowserApp *app) {
@@ -68,39 +833,38 @@ void adblocker_init(BrowserApp *app) {
       g_print("AdBlocker: Third-party cookies blocked & ITP enabled.\n");
   }
 
-  // Load all filters
-  const char *filters[] = {"ads", "privacy", "annoyance", "unbreak"};
-  for (int i = 0; i < 4; i++) {
-      char filename[256];
-      snprintf(filename, sizeof(filename), "fang/blocked_content_%s.json", filters[i]);
-      
-      char *json_content = NULL;
-      gsize json_len = 0;
-      GError *file_error = NULL;
-      
-      // Attempt to load JSON source to compile/update
-      if (g_file_get_contents(filename, &json_content, &json_len, &file_error)) {
-          g_print("AdBlocker: Compiling %lu bytes of rules from %s...\n", json_len, filename);
-          GBytes *json_bytes = g_bytes_new_take(json_content, json_len);
-          
-          // Save (Compile) the filter
-          webkit_user_content_filter_store_save(app->filter_store, filters[i], json_bytes, NULL, 
-                                                (GAsyncReadyCallback)on_filter_saved, app);
-          g_bytes_unref(json_bytes);
-      } else {
-          // Fallback: Load existing compiled binary if JSON missing
-          g_warning("AdBlocker: JSON %s not found. Loading cached filter...", filename);
-          if (file_error) g_error_free(file_error);
-          
-          webkit_user_content_filter_store_load(app->filter_store, filters[i], NULL,
-                                                (GAsyncReadyCallback)on_filter_loaded, app);
-      }
+  // Sites with blocking turned off, before the lists that except them
+  gchar *allowlist_path = snapshot_build_path(SITE_ALLOWLIST_FILE);
+  guint allowed_sites = site_allowlist_load(allowlist_path);
+  g_free(allowlist_path);
+  if (allowed_sites > 0) {
+      g_print("AdBlocker: Blocking turned off on %u sites\n", allowed_sites);
   }
+  
+  // Element hiding stylesheets and scriptlets. Parsing the lists takes a
+  // while, so the index is built off the main thread as on reloads; tabs
+  // open meanwhile get their stylesheets once it is in place.
+  // Generic selectors keyed by a class or id are only sent to pages using
+  // it, unless VAXP_EAGER_COSMETICS asks for all of them everywhere.
+  app->lazy_cosmetics = g_getenv("VAXP_EAGER_COSMETICS") == NULL;
+  app->cosmetic_index = NULL;
+  app->site_style_sheets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_style_sheet);
+  app->site_scripts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_user_script);
+  build_generic_style_sheet(app);
+  app->rules_reloading = TRUE;
+  rebuild_cosmetic_filters(app);
+  
+  // Load all filters
+  compile_content_filters(app, NULL, TRUE);
 
   app->adblock_enabled = TRUE;
   app->privacy_enabled = TRUE;
   
-  network_blocker_init(app);
+  app->blocked_requests_count = 0;
+  network_blocker_init();
+  setup_web_extension(app);
+  setup_redirect_resources(app);
+  watch_filter_lists(app);
   
   g_print("AdBlocker: Initialization started (Async compilation running...)\n");
 }
@@ -111,20 +875,8 @@ static void on_filter_loaded(WebKitUserContentFilterStore *store, GAsyncResult *
   WebKitUserContentFilter *filter = webkit_user_content_filter_store_load_finish(store, result, &error);
   if (filter) {
     g_print("AdBlocker: Filter loaded from cache: %s\n", webkit_user_content_filter_get_identifier(filter));
-    
-    // Add to our list of active filters
-    app->active_filters = g_list_append(app->active_filters, filter);
-    
-    // Apply to all existing tabs
-    GList *iter;
-    for (iter = app->tabs; iter != NULL; iter = iter->next) {
-      BrowserTab *tab = (BrowserTab *)iter->data;
-      WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(tab->web_view);
-      
-      if (app->adblock_enabled) {
-        webkit_user_content_manager_add_filter(manager, filter);
-      }
-    }
+    // Replaces a filter with the same identifier, as a recompiled list does
+    activate_filter(app, filter);
   } else {
     // It's normal to fail here if we are compiling for the first time
     if (error) g_error_free(error);
@@ -134,32 +886,84 @@ static void on_filter_loaded(WebKitUserContentFilterStore *store, GAsyncResult *
 void adblocker_enable(BrowserApp *app, gboolean enable) {
   app->adblock_enabled = enable;
   
-  if (enable) {
-      if (app->active_filters) {
-          g_list_free_full(app->active_filters, g_object_unref);
-          app->active_filters = NULL;
+  // Blocking is switched on or off, so cached verdicts are stale
+  network_blocker_invalidate_cache();
+  
+  // Running web processes are told directly, new ones read the user data
+  if (app->web_context) {
+      webkit_web_context_set_web_extensions_initialization_user_data(app->web_context,
+                                                                     g_variant_new_boolean(enable));
+      webkit_web_context_send_message_to_all_extensions(
+          app->web_context,
+          webkit_user_message_new(WEB_EXTENSION_MESSAGE_SET_ENABLED, g_variant_new_boolean(enable)));
+  }
+  
+  // Compiled content filters stay loaded while blocking is off, so turning
+  // it back on only re-attaches them to the tabs
+  GList *iter;
+  for (iter = app->tabs; iter != NULL; iter = iter->next) {
+    BrowserTab *tab = (BrowserTab *)iter->data;
+    WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(tab->web_view);
+    webkit_user_content_manager_remove_all_filters(manager);
+    adblocker_apply_cosmetic_filters(app, tab->web_view);
+    if (enable) {
+      GList *filter;
+      for (filter = app->active_filters; filter != NULL; filter = filter->next) {
+        webkit_user_content_manager_add_filter(manager, (WebKitUserContentFilter *)filter->data);
       }
-
-      const char *filters[] = {"ads", "privacy", "annoyance", "unbreak"};
-      for (int i = 0; i < 4; i++) {
-          webkit_user_content_filter_store_load(app->filter_store, filters[i], NULL,
+    }
+  }
+  
+  if (enable && !app->active_filters) {
+      for (int i = 0; CONTENT_FILTERS[i] != NULL; i++) {
+          webkit_user_content_filter_store_load(app->filter_store, CONTENT_FILTERS[i], NULL,
                                                 (GAsyncReadyCallback)on_filter_loaded, app);
       }
-  } else {
-      GList *iter;
-      for (iter = app->tabs; iter != NULL; iter = iter->next) {
-        BrowserTab *tab = (BrowserTab *)iter->data;
-        WebKitUserContentManager *manager = webkit_web_view_get_user_content_manager(tab->web_view);
-        webkit_user_content_manager_remove_all_filters(manager);
-      }
-      
-      if (app->active_filters) {
-          g_list_free_full(app->active_filters, g_object_unref);
-          app->active_filters = NULL;
-      }
   }
 }
 
+gboolean adblocker_is_site_allowed(BrowserApp *app, const char *uri) {
+  gchar *site = site_allowlist_domain_for_uri(uri);
+  gboolean allowed = site && site_allowlist_contains_domain(site, strlen(site));
+  g_free(site);
+  return allowed;
+}
+
+void adblocker_set_site_allowed(BrowserApp *app, const char *uri, gboolean allowed) {
+  gchar *site = site_allowlist_domain_for_uri(uri);
+  if (!site) return;
+  if (!(allowed ? site_allowlist_add(site) : site_allowlist_remove(site))) {
+      g_free(site);
+      return;
+  }
+  g_print("AdBlocker: Blocking turned %s on %s\n", allowed ? "off" : "on", site);
+  
+  // The native blocker checks the allowlist ahead of its cache, so nothing
+  // is invalidated; web processes load the rewritten file
+  gchar *path = snapshot_build_path(SITE_ALLOWLIST_FILE);
+  site_allowlist_save(path);
+  g_free(path);
+  if (app->web_context) {
+      webkit_web_context_send_message_to_all_extensions(
+          app->web_context, webkit_user_message_new(WEB_EXTENSION_MESSAGE_ALLOWLIST, NULL));
+  }
+  
+  // Cosmetic scripts and stylesheets skip allowlisted pages by URL
+  // pattern; rebuilding them does not reload anything
+  build_generic_style_sheet(app);
+  GList *iter;
+  for (iter = app->tabs; iter != NULL; iter = iter->next) {
+    BrowserTab *tab = (BrowserTab *)iter->data;
+    apply_privacy_settings(tab->web_view, app);
+    adblocker_apply_cosmetic_filters(app, tab->web_view);
+  }
+  
+  // Content filters are recompiled with the new exception rule; only the
+  // tabs of this site reload, once they are in place
+  compile_content_filters(app, site, FALSE);
+  g_free(site);
+}
+
 gboolean adblocker_reload_filter(BrowserApp *app) {
   if (app->adblock_enabled && !app->active_filters) {
       g_print("AdBlocker: Reloading filters...\n");
@@ -204,20 +1008,31 @@ void apply_privacy_settings(WebKitWebView *web_view, BrowserApp *app) {
     if (app->adblock_enabled) {
       gchar *ad_script = generate_ad_blocking_script();
       if (ad_script) {
+        gchar **allowed_pages = build_allowlist_patterns();
         WebKitUserScript *script = webkit_user_script_new(
           ad_script,
           WEBKIT_USER_CONTENT_INJECT_TOP_FRAME,
           WEBKIT_USER_SCRIPT_INJECT_AT_DOCUMENT_START,
-          NULL, NULL
+          NULL, (const gchar * const *)allowed_pages
         );
         webkit_user_content_manager_add_script(manager, script);
         webkit_user_script_unref(script);
+        g_strfreev(allowed_pages);
         free_ad_blocking_script(ad_script);
       }
     }
   } else {
     webkit_settings_set_user_agent(settings, NULL);
   }
+  
+  if (app->adblock_enabled && app->cosmetic_script) {
+    webkit_user_content_manager_add_script(manager, app->cosmetic_script);
+  }
+  // The scriptlets of the site shown stay until it changes
+  WebKitUserScript *site_script = (WebKitUserScript *)g_object_get_data(G_OBJECT(web_view), "cosmetic-script");
+  if (site_script) {
+    webkit_user_content_manager_add_script(manager, site_script);
+  }
 }
 
 // ========== Fingerprint Management Functions ==========
@@ -298,4 +1113,8 @@ void fingerprint_cleanup(BrowserApp *app) {
   fingerprint_profiles_cleanup();
   app->current_profile = NULL;
   g_print("Fingerprint: Cleanup complete\n");
-}
\ No newline at end of file
+}
+
+guint64 get_blocked_requests_count(BrowserApp *app) {
+  return app ? app->blocked_requests_count : 0;
+}
@@ -6,9 +6,41 @@
 void adblocker_init(BrowserApp *app);
 void adblocker_enable(BrowserApp *app, gboolean enable);
 gboolean adblocker_reload_filter(BrowserApp *app);
+
+// Check if blocking is turned off on the site of the page at uri
+gboolean adblocker_is_site_allowed(BrowserApp *app, const char *uri);
+
+// Turn blocking off (allowed) or back on for the registrable domain of uri.
+// The allowlist is saved and sent to the web processes; only the tabs of
+// that site reload, once the content filters are recompiled.
+void adblocker_set_site_allowed(BrowserApp *app, const char *uri, gboolean allowed);
+
+// Prepare a new web view: listens to the class and id names its pages
+// report and attaches the element hiding stylesheets
+void adblocker_setup_web_view(BrowserApp *app, WebKitWebView *web_view);
+
+// Attach the element hiding stylesheets to web_view: the generic one and
+// the one of the site it shows, replacing any it had, along with the
+// scriptlets of the site
+void adblocker_apply_cosmetic_filters(BrowserApp *app, WebKitWebView *web_view);
+
+// Swap the site stylesheet and scriptlets of web_view when its page moved
+// to another host. Call as navigations start, redirect and commit.
+void adblocker_update_site_filters(BrowserApp *app, WebKitWebView *web_view);
+
+// Rebuild the network filter engine and the element hiding index in the
+// background and swap them in, in this process and in every web process
+void adblocker_reload_rules(BrowserApp *app);
+
+// Write per-rule and per-domain hit counters of the browser and of every
+// web process to the adblock data directory, and rule costs when profiling
+void adblocker_dump_rule_stats(BrowserApp *app);
 void privacy_enable(BrowserApp *app, gboolean enable);
 void apply_privacy_settings(WebKitWebView *web_view, BrowserApp *app);
 
+// Get blocking statistics
+guint64 get_blocked_requests_count(BrowserApp *app);
+
 // Fingerprint management
 void fingerprint_init(BrowserApp *app);
 void fingerprint_rotate_profile(BrowserApp *app);
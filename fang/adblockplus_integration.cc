@@ -1,272 +1,225 @@
 #include "adblockplus_integration.h"
+#include "abp_engine.h"
+#include "snapshot.h"
 #include <stdio.h>
 #include <string.h>
 #include <glib.h>
+#include <gio/gio.h>
 
-// Embedded EasyList + EasyPrivacy rules from adblockpluscore
-// These are the most powerful blocking rules from Adblock Plus
-static const char *EASYLIST_RULES[] = {
-  // ========== EASYLIST CORE RULES ==========
-  // Main ad patterns
-  "-ad-banner",
-  "-advertisement",
-  "-ads.",
-  "-ads/",
-  "-ads?",
-  "-ads_",
-  "ad-placement",
-  "ad-slot",
-  "ad-unit",
-  "ad-wrapper",
-  "/adx/",
-  "/banner/",
-  "/commercial/",
-  "/advertisement/",
-  "/promotions/",
-  "/sponsored/",
-  
-  // ========== EASYLIST AD NETWORKS ==========
-  "adn.js",
-  "adnexus.com",
-  "ads.yahoo.com",
-  "ads.google.com",
-  "ads.facebook.com",
-  "ads.twitter.com",
-  "ads.linkedin.com",
-  "doubleclick.net",
-  "googlesyndication.com",
-  "googleadservices.com",
-  "googletagmanager.com",
-  "amazon-adsystem.com",
-  "criteo.com",
-  "pubmatic.com",
-  "openx.net",
-  "rubiconproject.com",
-  "adnxs.com",
-  "adsrvr.org",
-  
-  // ========== EASYLIST CONTENT DELIVERY ==========
-  "taboola.com",
-  "outbrain.com",
-  "disqus.com/recommendations",
-  "zemanta.com",
-  "revcontent.com",
-  "mgid.com",
-  
-  // ========== EASYPRIVACY RULES ==========
-  // Google Analytics and trackers
-  "analytics.google.com",
-  "google-analytics.com",
-  "googletagservices.com",
-  "imasdk.googleapis.com",
-  
-  // Facebook and Meta tracking
-  "facebook.net",
-  "facebook.com/tr",
-  "connect.facebook.net",
-  "fbcdn.net",
-  "instagram.com/tr",
-  
-  // Analytics services
-  "mixpanel.com",
-  "amplitude.com",
-  "segment.com",
-  "segment.io",
-  "optimizely.com",
-  "vwo.com",
-  "analytics.twitter.com",
-  "ads-twitter.com",
-  
-  // Session recording and heatmaps
-  "hotjar.com",
-  "mouseflow.com",
-  "inspectlet.com",
-  "clicktale.net",
-  "sessioncam.com",
-  "crazyegg.com",
-  "fullstory.com",
-  
-  // Email tracking
-  "open.track.com",
-  "track.email",
-  "readnotify.com",
-  "bananatag.com",
-  
-  // Data collection and profiling
-  "scorecardresearch.com",
-  "quantserve.com",
-  "bluekai.com",
-  "crwdcntrl.net",
-  "mathtag.com",
-  "rlcdn.com",
-  "semasio.net",
-  "exelator.com",
-  "krxd.net",
-  "parsely.com",
-  "chartbeat.com",
-  
-  // Mobile tracking
-  "appsflyer.com",
-  "branch.io",
-  "adjust.com",
-  "flurry.com",
-  "localytics.com",
-  "amplitude.com",
-  "braze.com",
-  
-  // Fingerprinting services
-  "fingerprintjs.com",
-  "iovation.com",
-  "threatmetrix.com",
-  "siftscience.com",
-  
-  // ========== FANBOY'S ANNOYANCE LIST ==========
-  // Social media widgets and sharing
-  "addthis.com",
-  "sharethis.com",
-  "facebook.com/plugins",
-  "platform.twitter.com",
-  "youtube.com/embed",
-  "disqus.com",
-  "widgets.outbrain.com",
-  
-  // Cookie notices and consent
-  "cookieconsent.com",
-  "onetrust.com",
-  "trustarc.com",
-  
-  // Pop-ups and notifications
-  "popads.net",
-  "popcash.net",
-  "propellerads.com",
-  "onesignal.com",
-  "pushwoosh.com",
-  
-  // ========== ADDITIONAL TRACKING PATTERNS ==========
-  "tracking.co",
-  "track.co",
-  "telemetry.",
-  "/pixel",
-  "/beacon",
-  "/collect",
-  "/log?",
-  "/track?",
-  "/event?",
-  "/ping?",
-  "/impression",
-  "/pageview",
-  "/click",
-  
-  NULL  // Sentinel
-};
+// Embedded EasyList + EasyPrivacy rules from adblockpluscore, in Adblock Plus
+// filter syntax, and CSS-based ad hiding selectors. Full lists are loaded on
+// top of the rules at startup. EASYLIST_RULES and AD_HIDING_SELECTORS are
+// compiled from fang/lists by tools/gen_tables.py.
+#include "easylist_data.inc"
 
-// CSS-based ad hiding selectors
-static const char *AD_HIDING_SELECTORS[] = {
-  ".ad-banner",
-  ".ad-box",
-  ".ad-container",
-  ".ad-frame",
-  ".ad-header",
-  ".ad-placement",
-  ".ad-region",
-  ".ad-sidebar",
-  ".ad-slot",
-  ".ad-space",
-  ".ad-unit",
-  ".ad-wrapper",
-  ".ads",
-  ".ads-box",
-  ".ads-container",
-  ".advertisement",
-  ".advertisement-container",
-  ".advertising",
-  ".banner",
-  ".banner-ad",
-  ".banner-top",
-  ".banner-bottom",
-  ".banner-sidebar",
-  ".content-ad",
-  ".div-gpt-ad",
-  ".google-ads",
-  ".gpt-ad",
-  ".google_ads",
-  ".sponsored",
-  ".sponsored-link",
-  ".promotion",
-  ".promotional",
-  ".promo-banner",
-  ".promo-box",
-  "[id*='ad-']",
-  "[id*='ads-']",
-  "[id*='banner-']",
-  "[class*='advertisement']",
-  "[data-ad-slot]",
-  "[data-ad-format]",
-  "iframe[src*='ads']",
-  "iframe[src*='doubleclick']",
-  "iframe[src*='google']",
-  "iframe[src*='facebook']",
-  
-  NULL  // Sentinel
+// Full filter lists written by tools/update_adblock.py
+static const char *FILTER_LISTS[] = {
+  "fang/easylist.txt",
+  "fang/easyprivacy.txt",
+  "fang/unbreak.txt",
+  NULL
 };
 
+// The active engine is replaced as a whole. Readers take a reference under
+// engine_lock, which only covers a pointer load and a refcount bump, and a
+// reload publishes its engine the same way; the previous engine is freed
+// once its last reader drops it, so matching never waits for a rebuild.
+static AbpEngine *abp_engine = NULL;
+G_LOCK_DEFINE_STATIC(engine_lock);
+
+// Key describing everything the compiled engine is built from
+static guint64 filter_source_key() {
+  guint64 key = SNAPSHOT_KEY_INIT;
+  for (int i = 0; EASYLIST_RULES[i] != NULL; i++) {
+    key = snapshot_key_add_string(key, EASYLIST_RULES[i]);
+  }
+  for (int i = 0; FILTER_LISTS[i] != NULL; i++) {
+    key = snapshot_key_add_file(key, FILTER_LISTS[i]);
+  }
+  return key;
+}
+
+// Map the compiled engine when the lists have not changed since it was
+// written; otherwise parse them and refresh the snapshot. Touches no
+// shared state, so reloads run it on a worker thread.
+static AbpEngine* build_engine() {
+  guint64 key = filter_source_key();
+  gchar *snapshot_path = snapshot_build_path("filters.snapshot");
+  AbpEngine *engine = abp_engine_open_snapshot(snapshot_path, key);
+  
+  if (engine) {
+    g_print("AdBlockPlus Integration: Mapped compiled filters from %s\n", snapshot_path);
+  } else {
+    engine = abp_engine_new();
+    for (int i = 0; EASYLIST_RULES[i] != NULL; i++) {
+      abp_engine_add_filter(engine, EASYLIST_RULES[i]);
+    }
+    g_print("AdBlockPlus Integration: Initializing with %u core rules\n", EASYLIST_RULES_COUNT);
+    
+    for (int i = 0; FILTER_LISTS[i] != NULL; i++) {
+      guint added = abp_engine_load_file(engine, FILTER_LISTS[i]);
+      if (added > 0) {
+        g_print("AdBlockPlus Integration: Loaded %u filters from %s\n", added, FILTER_LISTS[i]);
+      }
+    }
+    
+    abp_engine_compile(engine);
+    abp_engine_save_snapshot(engine, snapshot_path, key);
+  }
+  g_free(snapshot_path);
+  
+  g_print("AdBlockPlus Integration: %u network filters active (%u unsupported skipped)\n",
+          abp_engine_get_filter_count(engine), abp_engine_get_unsupported_count(engine));
+  gsize prefilter_size = 0;
+  double prefilter_fpr = 0.0;
+  abp_engine_get_prefilter_stats(engine, &prefilter_size, &prefilter_fpr);
+  g_print("AdBlockPlus Integration: Prefilter uses %.1f KiB, %.2f%% false positives\n",
+          prefilter_size / 1024.0, prefilter_fpr * 100.0);
+  LazyDfaStats automaton;
+  abp_engine_get_automaton_stats(engine, &automaton);
+  g_print("AdBlockPlus Integration: %u regex and wildcard filters in the automaton (%u NFA states)\n",
+          automaton.n_patterns, automaton.n_nfa_states);
+
+  AbpMemoryReport memory;
+  abp_engine_get_memory_report(engine, &memory);
+  g_print("AdBlockPlus Integration: %.1f KiB for %u filters, %.0f bytes per filter (%s)\n",
+          memory.total / 1024.0, memory.n_filters,
+          memory.n_filters ? (double)memory.total / memory.n_filters : 0.0,
+          memory.mapped ? "shared snapshot pages" : "private heap");
+  g_print("AdBlockPlus Integration: records %.1f KiB, domains %.1f KiB, text %.1f KiB, "
+          "patterns %.1f KiB, domain names %.1f KiB (%.1f KiB interned), index %.1f KiB, "
+          "prefilter %.1f KiB, automaton %.1f KiB\n",
+          memory.filters / 1024.0, memory.domains / 1024.0, memory.rule_text / 1024.0,
+          memory.patterns / 1024.0, memory.domain_names / 1024.0, memory.shared / 1024.0,
+          memory.index / 1024.0, memory.prefilter / 1024.0, memory.automaton / 1024.0);
+  return engine;
+}
+
+// Swap in a new engine; takes over the caller's reference
+static void publish_engine(AbpEngine *engine) {
+  G_LOCK(engine_lock);
+  AbpEngine *old = abp_engine;
+  abp_engine = engine;
+  G_UNLOCK(engine_lock);
+  abp_engine_unref(old);
+}
+
+// Reference to the current engine, NULL before init
+static AbpEngine* acquire_engine() {
+  G_LOCK(engine_lock);
+  AbpEngine *engine = abp_engine_ref(abp_engine);
+  G_UNLOCK(engine_lock);
+  return engine;
+}
+
 // Initialize adblock plus rules
 void adblockplus_init() {
-  g_print("AdBlockPlus Integration: Initializing with %d core rules\n", 
-          g_strv_length((gchar**)EASYLIST_RULES));
+  if (g_atomic_pointer_get(&abp_engine)) return;
+  
+  publish_engine(build_engine());
   g_print("AdBlockPlus Integration: CSS hiding rules enabled (%d selectors)\n",
-          g_strv_length((gchar**)AD_HIDING_SELECTORS));
+          AD_HIDING_SELECTORS_COUNT);
 }
 
-// Check if URL matches any EasyList rules
-gboolean adblockplus_should_block_url(const char *url) {
-  if (!url) return FALSE;
-  
-  // Check against all EASYLIST rules
-  for (int i = 0; EASYLIST_RULES[i] != NULL; i++) {
-    if (g_strstr_len(url, -1, EASYLIST_RULES[i]) != NULL) {
-      return TRUE;
-    }
+static void reload_thread(GTask *task, gpointer source_object, gpointer task_data,
+                          GCancellable *cancellable) {
+  gint64 start = g_get_monotonic_time();
+  AbpEngine *engine = build_engine();
+  g_print("AdBlockPlus Integration: Rebuilt filters in %.1f ms\n",
+          (g_get_monotonic_time() - start) / 1000.0);
+  g_task_return_pointer(task, engine, (GDestroyNotify)abp_engine_unref);
+}
+
+void adblockplus_reload_async(GAsyncReadyCallback callback, gpointer user_data) {
+  GTask *task = g_task_new(NULL, NULL, callback, user_data);
+  g_task_run_in_thread(task, reload_thread);
+  g_object_unref(task);
+}
+
+// The swap happens here, in the caller's main context, so the caller can
+// drop verdicts and rule pointers of the old engine right after it
+gboolean adblockplus_reload_finish(GAsyncResult *result, GError **error) {
+  AbpEngine *engine = (AbpEngine *)g_task_propagate_pointer(G_TASK(result), error);
+  if (!engine) return FALSE;
+  publish_engine(engine);
+  return TRUE;
+}
+
+const char** adblockplus_get_filter_lists() {
+  return (const char**)FILTER_LISTS;
+}
+
+// Check a request with its context against the filter engine
+gboolean adblockplus_match_request(const AbpRequest *request, AbpMatch *match) {
+  if (!request || !request->url) return FALSE;
+  
+  adblockplus_init();
+  AbpEngine *engine = acquire_engine();
+  gboolean blocked = abp_engine_match(engine, request, match);
+  abp_engine_unref(engine);
+  return blocked;
+}
+
+gboolean adblockplus_match_exception(const AbpRequest *request, AbpMatch *match) {
+  if (!request || !request->url) return FALSE;
+  
+  adblockplus_init();
+  AbpEngine *engine = acquire_engine();
+  gboolean allowed = abp_engine_match_exception(engine, request, match);
+  abp_engine_unref(engine);
+  return allowed;
+}
+
+AbpEngine* adblockplus_acquire_engine() {
+  adblockplus_init();
+  return acquire_engine();
+}
+
+void adblockplus_foreach_filter(void (*func)(const char *text, gpointer user_data),
+                                gpointer user_data) {
+  AbpEngine *engine = acquire_engine();
+  if (!engine) return;
+  
+  guint count = abp_engine_get_filter_count(engine);
+  for (guint32 id = 0; id < count; id++) {
+    func(abp_engine_get_filter_text(engine, id), user_data);
   }
-  
-  return FALSE;
+  abp_engine_unref(engine);
+}
+
+// Check if URL matches any EasyList rules
+gboolean adblockplus_should_block_url(const ParsedUrl *url) {
+  AbpRequest request = { url, NULL, 0, -1 };
+  return adblockplus_match_request(&request, NULL);
+}
+
+// Get EasyList URL rules
+const char** adblockplus_get_rules() {
+  return EASYLIST_RULES;
 }
 
 // Get CSS selectors for ad hiding
 const char** adblockplus_get_ad_hiding_selectors() {
-  return (const char**)AD_HIDING_SELECTORS;
+  return AD_HIDING_SELECTORS;
 }
 
 // Count blocking rules
 guint adblockplus_get_rule_count() {
-  guint count = 0;
-  for (int i = 0; EASYLIST_RULES[i] != NULL; i++) {
-    count++;
+  AbpEngine *engine = acquire_engine();
+  if (engine) {
+    guint count = abp_engine_get_filter_count(engine);
+    abp_engine_unref(engine);
+    return count;
   }
-  return count;
+  return EASYLIST_RULES_COUNT;
 }
 
 // Count CSS selectors
 guint adblockplus_get_selector_count() {
-  guint count = 0;
-  for (int i = 0; AD_HIDING_SELECTORS[i] != NULL; i++) {
-    count++;
-  }
-  return count;
+  return AD_HIDING_SELECTORS_COUNT;
 }
 
-// Generate comprehensive CSS filter string
+// The stylesheet is joined at build time
 gchar* adblockplus_generate_css_filter() {
-  GString *css = g_string_new("{");
-  
-  for (int i = 0; AD_HIDING_SELECTORS[i] != NULL; i++) {
-    if (i > 0) {
-      g_string_append(css, ", ");
-    }
-    g_string_append(css, AD_HIDING_SELECTORS[i]);
-  }
-  
-  g_string_append(css, " { display: none !important; visibility: hidden !important; } }");
-  
-  return g_string_free(css, FALSE);
+  return g_strdup(AD_HIDING_SELECTORS_CSS);
 }
@@ -2,12 +2,43 @@
 #define ADBLOCKPLUS_INTEGRATION_H
 
 #include <glib.h>
+#include <gio/gio.h>
+#include "abp_engine.h"
 
-// Initialize AdblockPlus integration with EasyList rules
+// Initialize AdblockPlus integration with EasyList rules and any full
+// filter lists found next to the JSON content filters
 void adblockplus_init();
 
+// Rebuild the filter engine from the lists on a worker thread. Matching
+// keeps using the current engine meanwhile and never waits for the build.
+void adblockplus_reload_async(GAsyncReadyCallback callback, gpointer user_data);
+
+// Call from the reload callback: swaps the new engine in. Readers still
+// holding the previous engine finish on it; it is freed after the last one.
+gboolean adblockplus_reload_finish(GAsyncResult *result, GError **error);
+
+// Get NULL-terminated array of filter list paths the engine is built from
+const char** adblockplus_get_filter_lists();
+
 // Check if URL should be blocked according to EasyList
-gboolean adblockplus_should_block_url(const char *url);
+gboolean adblockplus_should_block_url(const ParsedUrl *url);
+
+// Check a request with its context; match reports the deciding filter
+gboolean adblockplus_match_request(const AbpRequest *request, AbpMatch *match);
+
+// Check if an @@ filter allows a request blocked by another layer
+gboolean adblockplus_match_exception(const AbpRequest *request, AbpMatch *match);
+
+// Take a reference to the current engine, initializing it if needed. It
+// stays usable across reloads until abp_engine_unref.
+AbpEngine* adblockplus_acquire_engine();
+
+// Call func with the text of every network filter of the current engine
+void adblockplus_foreach_filter(void (*func)(const char *text, gpointer user_data),
+                                gpointer user_data);
+
+// Get NULL-terminated array of built-in EasyList URL rules
+const char** adblockplus_get_rules();
 
 // Get array of CSS selectors for ad hiding
 const char** adblockplus_get_ad_hiding_selectors();
@@ -0,0 +1,93 @@
+#include "bloom_filter.h"
+#include <string.h>
+
+#define BITS_PER_KEY 12
+#define WORDS_PER_BLOCK 8   // 8 x 64 bits, one cache line
+
+typedef struct {
+  guint64 words[WORDS_PER_BLOCK];
+} BloomBlock;
+
+struct BloomFilter {
+  BloomBlock *blocks;       // memory rounded up to a cache line
+  guint32 n_blocks;
+  gpointer memory;
+};
+
+// Odd multipliers picking one bit in each word of a block (as in the
+// split block Bloom filters of Parquet)
+static const guint32 WORD_SALTS[WORDS_PER_BLOCK] = {
+  0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+  0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+static inline guint64 mix(guint32 key) {
+  guint64 h = key;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline const BloomBlock* key_block(const BloomFilter *filter, guint64 h) {
+  return &filter->blocks[((h >> 32) * filter->n_blocks) >> 32];
+}
+
+BloomFilter* bloom_filter_new(guint n_keys) {
+  BloomFilter *filter = g_new0(BloomFilter, 1);
+  guint64 bits = (guint64)MAX(n_keys, 1u) * BITS_PER_KEY;
+  filter->n_blocks = (guint32)((bits + 511) / 512);
+  filter->memory = g_malloc0((gsize)(filter->n_blocks + 1) * sizeof(BloomBlock));
+  filter->blocks = (BloomBlock *)(((guintptr)filter->memory + 63) & ~(guintptr)63);
+  return filter;
+}
+
+void bloom_filter_add(BloomFilter *filter, guint32 key) {
+  guint64 h = mix(key);
+  BloomBlock *block = (BloomBlock *)key_block(filter, h);
+  guint32 low = (guint32)h;
+  for (int i = 0; i < WORDS_PER_BLOCK; i++) {
+    block->words[i] |= 1ull << ((low * WORD_SALTS[i]) >> 26);
+  }
+}
+
+gboolean bloom_filter_may_contain(const BloomFilter *filter, guint32 key) {
+  guint64 h = mix(key);
+  const BloomBlock *block = key_block(filter, h);
+  guint32 low = (guint32)h;
+  guint64 missing = 0;
+  for (int i = 0; i < WORDS_PER_BLOCK; i++) {
+    missing |= ~block->words[i] & (1ull << ((low * WORD_SALTS[i]) >> 26));
+  }
+  return missing == 0;
+}
+
+gsize bloom_filter_get_size(const BloomFilter *filter) {
+  return filter ? (gsize)filter->n_blocks * sizeof(BloomBlock) : 0;
+}
+
+double bloom_filter_measure_fpr(const BloomFilter *filter) {
+  if (!filter) return 0.0;
+
+  // Fixed xorshift sequence so reports are comparable between runs. Keys
+  // that were added count as false positives too, which is negligible
+  // next to 2^32.
+  const guint probes = 1 << 16;
+  guint32 x = 2463534242u;
+  guint hits = 0;
+  for (guint i = 0; i < probes; i++) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    hits += bloom_filter_may_contain(filter, x);
+  }
+  return (double)hits / probes;
+}
+
+void bloom_filter_free(BloomFilter *filter) {
+  if (!filter) return;
+  g_free(filter->memory);
+  g_free(filter);
+}
@@ -0,0 +1,30 @@
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <glib.h>
+
+// Blocked Bloom filter over 32-bit keys, used in front of the blocking
+// hash tables: every bit a key sets lies in one 64-byte block, so a
+// negative answer costs a single cache-line read. About 12 bits per key
+// give a false-positive rate under 1%.
+typedef struct BloomFilter BloomFilter;
+
+// Create a filter sized for n_keys keys
+BloomFilter* bloom_filter_new(guint n_keys);
+
+// Add a key
+void bloom_filter_add(BloomFilter *filter, guint32 key);
+
+// FALSE if key was never added; TRUE if it probably was
+gboolean bloom_filter_may_contain(const BloomFilter *filter, guint32 key);
+
+// Memory used by the bit array, in bytes
+gsize bloom_filter_get_size(const BloomFilter *filter);
+
+// Fraction of random keys the filter lets through, measured by probing
+double bloom_filter_measure_fpr(const BloomFilter *filter);
+
+// Free filter
+void bloom_filter_free(BloomFilter *filter);
+
+#endif // BLOOM_FILTER_H
@@ -0,0 +1,620 @@
+#include "cosmetic_filter.h"
+#include "scriptlets.h"
+#include "url_parser.h"
+#include <string.h>
+
+// Longest selector kept; longer ones are almost always broken rules
+#define MAX_SELECTOR_LEN 1024
+
+// Each selector gets its own rule: one selector the style engine rejects
+// would otherwise drop every selector grouped with it
+#define HIDE_DECLARATION " { display: none !important; visibility: hidden !important; }\n"
+
+// Script exception id of "example.com#@#+js()", which excepts every scriptlet
+#define ALL_SCRIPTS G_MAXUINT32
+
+// Extended CSS of other blockers, which the style engine cannot parse
+static const char *PROCEDURAL_PSEUDO_CLASSES[] = {
+  ":-abp-", ":has-text(", ":contains(", ":matches-css", ":matches-path(", ":matches-attr(",
+  ":min-text-length(", ":upward(", ":xpath(", ":remove(", ":style(", ":watch-attr(",
+  ":others(", ":if(", ":if-not(", NULL
+};
+
+// Hiding rule for the pages of one host and its subdomains
+typedef struct {
+  guint32 selector;
+  gchar **excludes;           // subdomains it does not apply to, NULL for none
+} CosmeticRule;
+
+struct CosmeticIndex {
+  GPtrArray *selectors;       // selector text by id
+  GHashTable *selector_ids;   // selector text -> id + 1
+  GHashTable *hosts;          // host -> GArray of CosmeticRule
+  GHashTable *exceptions;     // host -> GArray of selector ids ("#@#")
+  GArray *generic;            // selector ids hidden on every page
+  GHashTable *generic_ids;    // the same ids as a set
+  GHashTable *disabled;       // selector ids excepted on every page
+  GPtrArray *generic_excepted;
+  GString *generic_css;
+  gboolean lazy_generic;
+  GHashTable *tokens;         // ".class" or "#id" -> GArray of generic selector ids
+  GHashTable *keyed_ids;      // generic selector ids found through tokens
+  GHashTable *scripts;        // host -> GArray of CosmeticRule, for scriptlet calls
+  GHashTable *script_exceptions;  // host -> GArray of call ids or ALL_SCRIPTS
+  GHashTable *disabled_scripts;   // call ids excepted on every page
+  guint n_filters;
+  guint n_scripts;
+};
+
+static void clear_rule(gpointer data) {
+  g_strfreev(((CosmeticRule *)data)->excludes);
+}
+
+static void free_array(gpointer data) {
+  g_array_free((GArray *)data, TRUE);
+}
+
+CosmeticIndex* cosmetic_index_new() {
+  CosmeticIndex *index = g_new0(CosmeticIndex, 1);
+  index->selectors = g_ptr_array_new();
+  index->selector_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  index->hosts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_array);
+  index->exceptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_array);
+  index->generic = g_array_new(FALSE, FALSE, sizeof(guint32));
+  index->generic_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  index->disabled = g_hash_table_new(g_direct_hash, g_direct_equal);
+  index->generic_excepted = g_ptr_array_new();
+  index->generic_css = g_string_new(NULL);
+  index->tokens = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_array);
+  index->keyed_ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  index->scripts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_array);
+  index->script_exceptions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_array);
+  index->disabled_scripts = g_hash_table_new(g_direct_hash, g_direct_equal);
+  return index;
+}
+
+// Host names end up in URL patterns, so only plain ones are accepted
+static gboolean is_host_name(const char *text) {
+  if (!text[0]) return FALSE;
+  for (const char *p = text; *p; p++) {
+    if (!g_ascii_isalnum(*p) && *p != '-' && *p != '.' && *p != '_') return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean is_supported_selector(const char *selector) {
+  gsize len = strlen(selector);
+  if (len == 0 || len > MAX_SELECTOR_LEN) return FALSE;
+  // "##+js(...)" scriptlets and "##^" HTML filters are not CSS
+  if (selector[0] == '+' || selector[0] == '^') return FALSE;
+  if (strpbrk(selector, "{}")) return FALSE;
+  for (int i = 0; PROCEDURAL_PSEUDO_CLASSES[i] != NULL; i++) {
+    if (strstr(selector, PROCEDURAL_PSEUDO_CLASSES[i])) return FALSE;
+  }
+  return TRUE;
+}
+
+static guint32 intern_selector(CosmeticIndex *index, const char *selector) {
+  gpointer id = g_hash_table_lookup(index->selector_ids, selector);
+  if (id) return GPOINTER_TO_UINT(id) - 1;
+
+  gchar *copy = g_strdup(selector);
+  guint32 new_id = index->selectors->len;
+  g_ptr_array_add(index->selectors, copy);
+  g_hash_table_insert(index->selector_ids, copy, GUINT_TO_POINTER(new_id + 1));
+  return new_id;
+}
+
+static GArray* host_array(GHashTable *table, const char *host, guint element_size,
+                          GDestroyNotify clear_func) {
+  GArray *array = (GArray *)g_hash_table_lookup(table, host);
+  if (!array) {
+    array = g_array_new(FALSE, FALSE, element_size);
+    if (clear_func) g_array_set_clear_func(array, clear_func);
+    g_hash_table_insert(table, g_strdup(host), array);
+  }
+  return array;
+}
+
+static void add_generic(CosmeticIndex *index, guint32 id) {
+  if (!g_hash_table_add(index->generic_ids, GUINT_TO_POINTER(id + 1))) return;
+  g_array_append_val(index->generic, id);
+}
+
+static void add_exception(CosmeticIndex *index, const char *host, guint32 id) {
+  g_array_append_val(host_array(index->exceptions, host, sizeof(guint32), NULL), id);
+}
+
+static gchar** copy_names(GPtrArray *names) {
+  gchar **copy = g_new0(gchar *, names->len + 1);
+  for (guint i = 0; i < names->len; i++) {
+    copy[i] = g_strdup((const char *)names->pdata[i]);
+  }
+  return copy;
+}
+
+// Find the "##" or "#@#" between the domains and the selector. Other
+// separators ("#?#", "#$#", "#@$#", ...) are unsupported cosmetic syntax.
+static const char* find_separator(const char *text, gboolean *exception, gboolean *supported) {
+  for (const char *p = strchr(text, '#'); p; p = strchr(p + 1, '#')) {
+    const char *q = p + 1;
+    gboolean at = *q == '@';
+    if (at) q++;
+    gboolean special = *q == '?' || *q == '$' || *q == '%';
+    if (special) q++;
+    if (*q == '#') {
+      *exception = at;
+      *supported = !special;
+      return p;
+    }
+  }
+  return NULL;
+}
+
+// "+js(set-constant, ads.enabled, false)" -> "set-constant\tads.enabled\tfalse",
+// with the canonical scriptlet name and arguments unquoted. An empty
+// "+js()" yields "" (every scriptlet). NULL for scriptlets not bundled.
+static gchar* parse_scriptlet_call(const char *selector) {
+  gsize len = strlen(selector);
+  if (len < 5 || selector[len - 1] != ')') return NULL;
+  gchar *inner = g_strndup(selector + 4, len - 5);
+  if (!g_strstrip(inner)[0]) return inner;
+
+  // Arguments are separated by commas not escaped with a backslash
+  GString *call = g_string_new(NULL);
+  GString *arg = g_string_new(NULL);
+  gboolean valid = TRUE;
+  for (const char *p = inner; valid; p++) {
+    if (*p == '\\' && p[1] == ',') {
+      g_string_append_c(arg, *++p);
+      continue;
+    }
+    if (*p != ',' && *p != '\0') {
+      g_string_append_c(arg, *p);
+      continue;
+    }
+
+    gchar *value = g_strstrip(arg->str);
+    gsize value_len = strlen(value);
+    if (value_len >= 2 && (value[0] == '"' || value[0] == '\'') && value[value_len - 1] == value[0]) {
+      value[value_len - 1] = '\0';
+      value++;
+    }
+    if (call->len == 0) {
+      const Scriptlet *scriptlet = scriptlet_lookup(value, strlen(value));
+      if (scriptlet) g_string_append(call, scriptlet_get_name(scriptlet));
+      else valid = FALSE;
+    } else if (strchr(value, '\t')) {
+      valid = FALSE;
+    } else {
+      g_string_append_c(call, '\t');
+      g_string_append(call, value);
+    }
+    g_string_truncate(arg, 0);
+    if (*p == '\0') break;
+  }
+
+  g_string_free(arg, TRUE);
+  g_free(inner);
+  return g_string_free(call, !valid);
+}
+
+static gboolean add_filter_line(CosmeticIndex *index, gchar *text) {
+  gboolean exception = FALSE, supported = FALSE;
+  gchar *separator = (gchar *)find_separator(text, &exception, &supported);
+  if (!separator || !supported) return FALSE;
+
+  const char *selector = g_strstrip(separator + (exception ? 3 : 2));
+  gchar *call = NULL;
+  if (g_str_has_prefix(selector, "+js(")) {
+    if (strlen(selector) > MAX_SELECTOR_LEN || !(call = parse_scriptlet_call(selector))) return FALSE;
+  } else if (!is_supported_selector(selector)) {
+    return FALSE;
+  }
+  *separator = '\0';
+
+  // "example.com,~shop.example.com": entity names ("example.*") and
+  // anything that is not a host name are skipped
+  gchar **names = g_strsplit(text, ",", -1);
+  GPtrArray *includes = g_ptr_array_new_with_free_func(g_free);
+  GPtrArray *excludes = g_ptr_array_new_with_free_func(g_free);
+  gboolean skipped = FALSE;
+  for (int i = 0; names[i] != NULL; i++) {
+    gchar *name = g_strstrip(names[i]);
+    gboolean exclude = name[0] == '~';
+    if (exclude) name++;
+    if (!name[0]) continue;
+    if (!is_host_name(name)) {
+      skipped |= !exclude;
+      continue;
+    }
+    gchar *lower = g_ascii_strdown(name, -1);
+    g_ptr_array_add(exclude ? excludes : includes, lower);
+  }
+  g_strfreev(names);
+
+  gboolean added = !(skipped && includes->len == 0);
+  if (call) {
+    // Scriptlets are only injected where a filter names the site
+    added &= exception || includes->len > 0;
+  }
+  if (added && call) {
+    guint32 id = call[0] ? intern_selector(index, call) : ALL_SCRIPTS;
+    if (exception && includes->len == 0) {
+      if (id != ALL_SCRIPTS) g_hash_table_add(index->disabled_scripts, GUINT_TO_POINTER(id + 1));
+    } else if (exception) {
+      for (guint i = 0; i < includes->len; i++) {
+        g_array_append_val(host_array(index->script_exceptions, (const char *)includes->pdata[i],
+                                      sizeof(guint32), NULL), id);
+      }
+    } else if (id != ALL_SCRIPTS) {
+      for (guint i = 0; i < includes->len; i++) {
+        CosmeticRule rule;
+        rule.selector = id;
+        rule.excludes = excludes->len > 0 ? copy_names(excludes) : NULL;
+        g_array_append_val(host_array(index->scripts, (const char *)includes->pdata[i],
+                                      sizeof(CosmeticRule), clear_rule), rule);
+      }
+    }
+    index->n_filters++;
+    index->n_scripts++;
+  } else if (added) {
+    guint32 id = intern_selector(index, selector);
+    if (exception) {
+      // "#@#sel" excepts sel everywhere; a "~" domain of an exception
+      // takes nothing away from it, so it is ignored
+      if (includes->len == 0) g_hash_table_add(index->disabled, GUINT_TO_POINTER(id + 1));
+      for (guint i = 0; i < includes->len; i++) {
+        add_exception(index, (const char *)includes->pdata[i], id);
+      }
+    } else if (includes->len == 0) {
+      // "~example.com##sel" is generic with an exception for example.com
+      add_generic(index, id);
+      for (guint i = 0; i < excludes->len; i++) {
+        add_exception(index, (const char *)excludes->pdata[i], id);
+      }
+    } else {
+      for (guint i = 0; i < includes->len; i++) {
+        CosmeticRule rule;
+        rule.selector = id;
+        rule.excludes = excludes->len > 0 ? copy_names(excludes) : NULL;
+        g_array_append_val(host_array(index->hosts, (const char *)includes->pdata[i],
+                                      sizeof(CosmeticRule), clear_rule), rule);
+      }
+    }
+    index->n_filters++;
+  }
+
+  g_ptr_array_free(includes, TRUE);
+  g_ptr_array_free(excludes, TRUE);
+  g_free(call);
+  return added;
+}
+
+gboolean cosmetic_index_add_filter(CosmeticIndex *index, const char *line) {
+  if (!index || !line) return FALSE;
+  // Comments and network filters never contain "##" before "!" or "["
+  if (line[0] == '!' || line[0] == '[' || !strchr(line, '#')) return FALSE;
+
+  gchar *text = g_strstrip(g_strdup(line));
+  gboolean added = add_filter_line(index, text);
+  g_free(text);
+  return added;
+}
+
+gboolean cosmetic_index_add_selector(CosmeticIndex *index, const char *selector) {
+  if (!index || !selector || !is_supported_selector(selector)) return FALSE;
+  add_generic(index, intern_selector(index, selector));
+  index->n_filters++;
+  return TRUE;
+}
+
+guint cosmetic_index_load_file(CosmeticIndex *index, const char *path) {
+  gchar *contents = NULL;
+  if (!index || !g_file_get_contents(path, &contents, NULL, NULL)) {
+    return 0;
+  }
+
+  guint added = 0;
+  gchar *line = contents;
+  while (line) {
+    gchar *next = strchr(line, '\n');
+    if (next) *next++ = '\0';
+    if (cosmetic_index_add_filter(index, line)) added++;
+    line = next;
+  }
+  g_free(contents);
+  return added;
+}
+
+static gboolean is_disabled(const CosmeticIndex *index, guint32 id) {
+  return g_hash_table_contains(index->disabled, GUINT_TO_POINTER(id + 1));
+}
+
+static void append_rule(GString *css, const CosmeticIndex *index, guint32 id) {
+  g_string_append(css, (const char *)index->selectors->pdata[id]);
+  g_string_append(css, HIDE_DECLARATION);
+}
+
+static gboolean is_ident_char(guchar c) {
+  return g_ascii_isalnum(c) || c == '-' || c == '_' || c >= 0x80;
+}
+
+// A class or id the selector cannot match without (".ad" of "div.ad > a"),
+// found outside brackets, parentheses and strings. Selector lists and
+// selectors made of types and attributes have none.
+static gboolean find_selector_token(const char *selector, const char **token, gsize *len) {
+  const char *found = NULL;
+  gsize found_len = 0;
+  int depth = 0;
+  char quote = 0;
+  for (const char *p = selector; *p; p++) {
+    if (quote) {
+      if (*p == '\\' && p[1]) p++;
+      else if (*p == quote) quote = 0;
+    } else if (*p == '"' || *p == '\'') {
+      quote = *p;
+    } else if (*p == '\\') {
+      // Escaped names would have to be unescaped to compare with the page's
+      if (depth == 0) return FALSE;
+      if (p[1]) p++;
+    } else if (*p == '[' || *p == '(') {
+      depth++;
+    } else if (*p == ']' || *p == ')') {
+      depth--;
+    } else if (depth == 0 && *p == ',') {
+      return FALSE;
+    } else if (depth == 0 && !found && (*p == '.' || *p == '#') && is_ident_char((guchar)p[1])) {
+      const char *end = p + 1;
+      while (is_ident_char((guchar)*end)) end++;
+      if (*end == '\\') return FALSE;
+      found = p;
+      found_len = end - p;
+      p = end - 1;
+    }
+  }
+  *token = found;
+  *len = found_len;
+  return found != NULL;
+}
+
+void cosmetic_index_set_lazy_generic(CosmeticIndex *index, gboolean lazy) {
+  index->lazy_generic = lazy;
+}
+
+void cosmetic_index_compile(CosmeticIndex *index) {
+  g_string_truncate(index->generic_css, 0);
+  g_hash_table_remove_all(index->tokens);
+  g_hash_table_remove_all(index->keyed_ids);
+  for (guint i = 0; i < index->generic->len; i++) {
+    guint32 id = g_array_index(index->generic, guint32, i);
+    if (is_disabled(index, id)) continue;
+
+    const char *token;
+    gsize len;
+    if (index->lazy_generic &&
+        find_selector_token((const char *)index->selectors->pdata[id], &token, &len)) {
+      gchar *key = g_strndup(token, len);
+      g_array_append_val(host_array(index->tokens, key, sizeof(guint32), NULL), id);
+      g_free(key);
+      g_hash_table_add(index->keyed_ids, GUINT_TO_POINTER(id + 1));
+    } else {
+      append_rule(index->generic_css, index, id);
+    }
+  }
+
+  g_ptr_array_set_size(index->generic_excepted, 0);
+  GHashTableIter iter;
+  gpointer host, value;
+  g_hash_table_iter_init(&iter, index->exceptions);
+  while (g_hash_table_iter_next(&iter, &host, &value)) {
+    GArray *ids = (GArray *)value;
+    for (guint i = 0; i < ids->len; i++) {
+      if (g_hash_table_contains(index->generic_ids, GUINT_TO_POINTER(g_array_index(ids, guint32, i) + 1))) {
+        g_ptr_array_add(index->generic_excepted, host);
+        break;
+      }
+    }
+  }
+}
+
+const char* cosmetic_index_get_generic_css(const CosmeticIndex *index) {
+  return index ? index->generic_css->str : "";
+}
+
+gchar** cosmetic_index_get_generic_excepted_hosts(const CosmeticIndex *index) {
+  guint count = index ? index->generic_excepted->len : 0;
+  gchar **hosts = g_new0(gchar *, count + 1);
+  for (guint i = 0; i < count; i++) {
+    hosts[i] = g_strdup((const char *)index->generic_excepted->pdata[i]);
+  }
+  return hosts;
+}
+
+static gboolean rule_applies(const CosmeticRule *rule, const char *host, gsize len) {
+  if (!rule->excludes) return TRUE;
+  for (int i = 0; rule->excludes[i] != NULL; i++) {
+    if (url_host_in_domain(host, len, rule->excludes[i])) return FALSE;
+  }
+  return TRUE;
+}
+
+// "a.example.com" -> "example.com" -> "com" -> NULL
+static const char* next_suffix(const char *host) {
+  const char *dot = strchr(host, '.');
+  return dot ? dot + 1 : NULL;
+}
+
+// Selector ids excepted on the pages of host (a NUL-terminated copy)
+static GHashTable* collect_exceptions(const CosmeticIndex *index, const char *host,
+                                      gboolean *generic_excepted) {
+  GHashTable *excepted = g_hash_table_new(g_direct_hash, g_direct_equal);
+  *generic_excepted = FALSE;
+  for (const char *suffix = host; suffix; suffix = next_suffix(suffix)) {
+    GArray *ids = (GArray *)g_hash_table_lookup(index->exceptions, suffix);
+    for (guint i = 0; ids && i < ids->len; i++) {
+      guint32 id = g_array_index(ids, guint32, i);
+      g_hash_table_add(excepted, GUINT_TO_POINTER(id + 1));
+      *generic_excepted |= g_hash_table_contains(index->generic_ids, GUINT_TO_POINTER(id + 1));
+    }
+  }
+  return excepted;
+}
+
+gchar* cosmetic_index_build_host_css(const CosmeticIndex *index, const char *host, gsize len) {
+  if (!index || !host || len == 0) return NULL;
+
+  gchar *name = g_strndup(host, len);
+  gboolean generic_excepted;
+  GHashTable *excepted = collect_exceptions(index, name, &generic_excepted);
+
+  // Generic selectors are only repeated here when the generic stylesheet
+  // is left out of this host's pages, and never those found through tokens
+  GString *css = g_string_new(NULL);
+  GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for (const char *suffix = name; suffix; suffix = next_suffix(suffix)) {
+    GArray *rules = (GArray *)g_hash_table_lookup(index->hosts, suffix);
+    for (guint i = 0; rules && i < rules->len; i++) {
+      const CosmeticRule *rule = &g_array_index(rules, CosmeticRule, i);
+      gpointer key = GUINT_TO_POINTER(rule->selector + 1);
+      if (!rule_applies(rule, name, len) || is_disabled(index, rule->selector) ||
+          g_hash_table_contains(excepted, key) ||
+          (!generic_excepted && g_hash_table_contains(index->generic_ids, key)) ||
+          !g_hash_table_add(seen, key)) {
+        continue;
+      }
+      append_rule(css, index, rule->selector);
+    }
+  }
+  if (generic_excepted) {
+    for (guint i = 0; i < index->generic->len; i++) {
+      guint32 id = g_array_index(index->generic, guint32, i);
+      gpointer key = GUINT_TO_POINTER(id + 1);
+      if (is_disabled(index, id) || g_hash_table_contains(excepted, key) ||
+          g_hash_table_contains(index->keyed_ids, key) || !g_hash_table_add(seen, key)) {
+        continue;
+      }
+      append_rule(css, index, id);
+    }
+  }
+
+  g_hash_table_destroy(seen);
+  g_hash_table_destroy(excepted);
+  g_free(name);
+  if (css->len == 0) {
+    g_string_free(css, TRUE);
+    return NULL;
+  }
+  return g_string_free(css, FALSE);
+}
+
+gchar* cosmetic_index_build_token_css(const CosmeticIndex *index, const char *host, gsize len,
+                                     const char * const *tokens, GHashTable *injected) {
+  if (!index || !tokens || g_hash_table_size(index->tokens) == 0) return NULL;
+
+  gchar *name = g_strndup(host ? host : "", len);
+  gboolean generic_excepted;
+  GHashTable *excepted = collect_exceptions(index, name, &generic_excepted);
+  GString *css = g_string_new(NULL);
+  for (int i = 0; tokens[i] != NULL; i++) {
+    GArray *ids = (GArray *)g_hash_table_lookup(index->tokens, tokens[i]);
+    for (guint j = 0; ids && j < ids->len; j++) {
+      guint32 id = g_array_index(ids, guint32, j);
+      gpointer key = GUINT_TO_POINTER(id + 1);
+      if (g_hash_table_contains(excepted, key) || !g_hash_table_add(injected, key)) continue;
+      append_rule(css, index, id);
+    }
+  }
+
+  g_hash_table_destroy(excepted);
+  g_free(name);
+  if (css->len == 0) {
+    g_string_free(css, TRUE);
+    return NULL;
+  }
+  return g_string_free(css, FALSE);
+}
+
+gboolean cosmetic_index_has_token(const CosmeticIndex *index, const char *token) {
+  return index && token && g_hash_table_contains(index->tokens, token);
+}
+
+gchar* cosmetic_index_build_host_script(const CosmeticIndex *index, const char *host, gsize len) {
+  if (!index || !host || len == 0 || g_hash_table_size(index->scripts) == 0) return NULL;
+
+  gchar *name = g_strndup(host, len);
+  GHashTable *excepted = g_hash_table_new(g_direct_hash, g_direct_equal);
+  gboolean all_excepted = FALSE;
+  for (const char *suffix = name; suffix; suffix = next_suffix(suffix)) {
+    GArray *ids = (GArray *)g_hash_table_lookup(index->script_exceptions, suffix);
+    for (guint i = 0; ids && i < ids->len; i++) {
+      guint32 id = g_array_index(ids, guint32, i);
+      if (id == ALL_SCRIPTS) all_excepted = TRUE;
+      else g_hash_table_add(excepted, GUINT_TO_POINTER(id + 1));
+    }
+  }
+
+  // Calls run in filter order, most specific host first, each once
+  GPtrArray *calls = g_ptr_array_new();
+  if (!all_excepted) {
+    GHashTable *seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (const char *suffix = name; suffix; suffix = next_suffix(suffix)) {
+      GArray *rules = (GArray *)g_hash_table_lookup(index->scripts, suffix);
+      for (guint i = 0; rules && i < rules->len; i++) {
+        const CosmeticRule *rule = &g_array_index(rules, CosmeticRule, i);
+        gpointer key = GUINT_TO_POINTER(rule->selector + 1);
+        if (!rule_applies(rule, name, len) || g_hash_table_contains(index->disabled_scripts, key) ||
+            g_hash_table_contains(excepted, key) || !g_hash_table_add(seen, key)) {
+          continue;
+        }
+        g_ptr_array_add(calls, index->selectors->pdata[rule->selector]);
+      }
+    }
+    g_hash_table_destroy(seen);
+  }
+
+  gchar *script = scriptlet_build_script((const char * const *)calls->pdata, calls->len);
+  g_ptr_array_free(calls, TRUE);
+  g_hash_table_destroy(excepted);
+  g_free(name);
+  return script;
+}
+
+guint cosmetic_index_get_filter_count(const CosmeticIndex *index) {
+  return index ? index->n_filters : 0;
+}
+
+guint cosmetic_index_get_generic_count(const CosmeticIndex *index) {
+  return index ? index->generic->len : 0;
+}
+
+guint cosmetic_index_get_keyed_count(const CosmeticIndex *index) {
+  return index ? g_hash_table_size(index->keyed_ids) : 0;
+}
+
+guint cosmetic_index_get_host_count(const CosmeticIndex *index) {
+  return index ? g_hash_table_size(index->hosts) : 0;
+}
+
+guint cosmetic_index_get_script_count(const CosmeticIndex *index) {
+  return index ? index->n_scripts : 0;
+}
+
+void cosmetic_index_free(CosmeticIndex *index) {
+  if (!index) return;
+  g_hash_table_destroy(index->hosts);
+  g_hash_table_destroy(index->exceptions);
+  g_hash_table_destroy(index->selector_ids);
+  g_ptr_array_free(index->selectors, TRUE);
+  g_array_free(index->generic, TRUE);
+  g_hash_table_destroy(index->generic_ids);
+  g_hash_table_destroy(index->disabled);
+  g_ptr_array_free(index->generic_excepted, TRUE);
+  g_string_free(index->generic_css, TRUE);
+  g_hash_table_destroy(index->tokens);
+  g_hash_table_destroy(index->keyed_ids);
+  g_hash_table_destroy(index->scripts);
+  g_hash_table_destroy(index->script_exceptions);
+  g_hash_table_destroy(index->disabled_scripts);
+  g_free(index);
+}
@@ -0,0 +1,80 @@
+#ifndef COSMETIC_FILTER_H
+#define COSMETIC_FILTER_H
+
+#include <glib.h>
+
+// Element hiding filters ("example.com,~shop.example.com##.ad",
+// "##.banner", "example.com#@#.ad") indexed by host name. A page gets the
+// minimal stylesheet for its host from a few hash probes, one per label,
+// instead of every selector of the lists; selectors without domains form
+// one generic stylesheet shared by all pages. Scriptlet filters
+// ("example.com##+js(set-constant, ads, false)") are indexed the same way
+// and become one script per host. Procedural and snippet filters ("#?#",
+// "#$#", ":has-text()", ...) are not supported.
+typedef struct CosmeticIndex CosmeticIndex;
+
+// Create an empty index
+CosmeticIndex* cosmetic_index_new();
+
+// Parse and add one "##" or "#@#" filter line. Returns FALSE for network
+// filters, comments and unsupported syntax.
+gboolean cosmetic_index_add_filter(CosmeticIndex *index, const char *line);
+
+// Hide selector on every page, as "##selector" would
+gboolean cosmetic_index_add_selector(CosmeticIndex *index, const char *selector);
+
+// Add every element hiding filter of a filter list file. Returns the
+// number of filters added.
+guint cosmetic_index_load_file(CosmeticIndex *index, const char *path);
+
+// Leave generic selectors that need a class or id to match ("div.ad > a",
+// "#banner") out of the generic stylesheet; pages get them from
+// cosmetic_index_build_token_css for the class and id names they use.
+// Must be called before compile.
+void cosmetic_index_set_lazy_generic(CosmeticIndex *index, gboolean lazy);
+
+// Apply exceptions and build the generic stylesheet. Must be called once
+// after adding filters.
+void cosmetic_index_compile(CosmeticIndex *index);
+
+// Stylesheet hiding the generic selectors, "" if there are none
+const char* cosmetic_index_get_generic_css(const CosmeticIndex *index);
+
+// Hosts excepting some generic selectors (free with g_strfreev). The
+// generic stylesheet must not apply to their pages (nor their subdomains');
+// their host stylesheet carries the generic selectors they keep.
+gchar** cosmetic_index_get_generic_excepted_hosts(const CosmeticIndex *index);
+
+// Stylesheet hiding what the filters for a lowercase host name hide on top
+// of the generic ones (free with g_free), NULL if there is nothing to hide
+gchar* cosmetic_index_build_host_css(const CosmeticIndex *index, const char *host, gsize len);
+
+// Stylesheet hiding the generic selectors keyed by tokens (".class" and
+// "#id" names seen on a page of host) that are not excepted there and not
+// in injected yet (free with g_free). injected is a set of selector ids,
+// kept per page and updated; NULL if there is nothing new to hide.
+gchar* cosmetic_index_build_token_css(const CosmeticIndex *index, const char *host, gsize len,
+                                     const char * const *tokens, GHashTable *injected);
+
+// Check if some generic selector is keyed by token (".class" or "#id")
+gboolean cosmetic_index_has_token(const CosmeticIndex *index, const char *token);
+
+// Script running the scriptlets filters call on the pages of a lowercase
+// host name, minus those excepted there (free with g_free), NULL if none.
+// Scriptlet filters without a host name are ignored.
+gchar* cosmetic_index_build_host_script(const CosmeticIndex *index, const char *host, gsize len);
+
+// Number of filters added, generic selectors (and those of them found
+// through tokens) and hosts with own filters
+guint cosmetic_index_get_filter_count(const CosmeticIndex *index);
+guint cosmetic_index_get_generic_count(const CosmeticIndex *index);
+guint cosmetic_index_get_keyed_count(const CosmeticIndex *index);
+guint cosmetic_index_get_host_count(const CosmeticIndex *index);
+
+// Number of scriptlet filters added, exceptions included
+guint cosmetic_index_get_script_count(const CosmeticIndex *index);
+
+// Free index
+void cosmetic_index_free(CosmeticIndex *index);
+
+#endif // COSMETIC_FILTER_H
@@ -0,0 +1,145 @@
+#include "decision_cache.h"
+#include <string.h>
+
+#define CACHE_NONE G_MAXUINT32
+
+// Entries live in one array and form a doubly linked recency list through
+// indices, most recently used first
+typedef struct {
+  guint64 key;
+  CachedDecision decision;
+  guint32 prev;
+  guint32 next;
+} CacheEntry;
+
+struct DecisionCache {
+  CacheEntry *entries;
+  guint capacity;
+  guint size;
+  guint32 head;         // most recently used
+  guint32 tail;         // least recently used, evicted first
+  GHashTable *index;    // &entry->key -> entry
+  DecisionCacheStats stats;
+};
+
+DecisionCache* decision_cache_new(guint capacity) {
+  DecisionCache *cache = g_new0(DecisionCache, 1);
+  cache->capacity = MAX(capacity, 1);
+  cache->entries = g_new0(CacheEntry, cache->capacity);
+  cache->head = CACHE_NONE;
+  cache->tail = CACHE_NONE;
+  cache->index = g_hash_table_new(g_int64_hash, g_int64_equal);
+  return cache;
+}
+
+static guint64 hash_bytes(guint64 h, const char *s, gsize len) {
+  for (gsize i = 0; i < len; i++) {
+    h ^= (guchar)s[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+guint64 decision_cache_key(const char *url, gsize url_len, const char *first_party,
+                           gsize first_party_len, guint32 context) {
+  guint64 h = hash_bytes(14695981039346656037ull, url, url ? url_len : 0);
+  // 0xff never occurs in UTF-8 text, so it separates the two strings
+  h = (h ^ 0xff) * 1099511628211ull;
+  h = hash_bytes(h, first_party, first_party ? first_party_len : 0);
+  h = (h ^ context) * 1099511628211ull;
+
+  // Final avalanche so similar URLs spread over the whole key
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+static void unlink_entry(DecisionCache *cache, guint32 i) {
+  CacheEntry *entry = &cache->entries[i];
+  if (entry->prev != CACHE_NONE) cache->entries[entry->prev].next = entry->next;
+  else cache->head = entry->next;
+  if (entry->next != CACHE_NONE) cache->entries[entry->next].prev = entry->prev;
+  else cache->tail = entry->prev;
+}
+
+static void push_front(DecisionCache *cache, guint32 i) {
+  CacheEntry *entry = &cache->entries[i];
+  entry->prev = CACHE_NONE;
+  entry->next = cache->head;
+  if (cache->head != CACHE_NONE) cache->entries[cache->head].prev = i;
+  cache->head = i;
+  if (cache->tail == CACHE_NONE) cache->tail = i;
+}
+
+gboolean decision_cache_lookup(DecisionCache *cache, guint64 key, CachedDecision *decision) {
+  if (!cache) return FALSE;
+
+  CacheEntry *entry = (CacheEntry *)g_hash_table_lookup(cache->index, &key);
+  if (!entry) {
+    cache->stats.misses++;
+    return FALSE;
+  }
+
+  guint32 i = (guint32)(entry - cache->entries);
+  if (cache->head != i) {
+    unlink_entry(cache, i);
+    push_front(cache, i);
+  }
+  if (decision) *decision = entry->decision;
+  cache->stats.hits++;
+  return TRUE;
+}
+
+void decision_cache_insert(DecisionCache *cache, guint64 key, const CachedDecision *decision) {
+  if (!cache || !decision) return;
+
+  CacheEntry *entry = (CacheEntry *)g_hash_table_lookup(cache->index, &key);
+  guint32 i;
+  if (entry) {
+    i = (guint32)(entry - cache->entries);
+    unlink_entry(cache, i);
+  } else if (cache->size < cache->capacity) {
+    i = cache->size++;
+  } else {
+    i = cache->tail;
+    unlink_entry(cache, i);
+    g_hash_table_remove(cache->index, &cache->entries[i].key);
+    cache->stats.evictions++;
+  }
+
+  if (!entry) {
+    entry = &cache->entries[i];
+    entry->key = key;
+    g_hash_table_insert(cache->index, &entry->key, entry);
+  }
+  entry->decision = *decision;
+  push_front(cache, i);
+}
+
+void decision_cache_clear(DecisionCache *cache) {
+  if (!cache) return;
+  g_hash_table_remove_all(cache->index);
+  cache->size = 0;
+  cache->head = CACHE_NONE;
+  cache->tail = CACHE_NONE;
+  cache->stats.invalidations++;
+}
+
+void decision_cache_get_stats(const DecisionCache *cache, DecisionCacheStats *stats) {
+  if (!stats) return;
+  memset(stats, 0, sizeof(*stats));
+  if (!cache) return;
+  *stats = cache->stats;
+  stats->size = cache->size;
+  stats->capacity = cache->capacity;
+}
+
+void decision_cache_free(DecisionCache *cache) {
+  if (!cache) return;
+  g_hash_table_destroy(cache->index);
+  g_free(cache->entries);
+  g_free(cache);
+}
@@ -0,0 +1,56 @@
+#ifndef DECISION_CACHE_H
+#define DECISION_CACHE_H
+
+#include <glib.h>
+
+// Bounded LRU cache of blocking verdicts. Entries are keyed by a 64-bit
+// hash of the request URL, its first-party host and its context (resource
+// type, party), so rules that depend on them are cached per request kind
+// and site.
+typedef struct DecisionCache DecisionCache;
+
+// Cached verdict and the rule that produced it
+typedef struct {
+  gboolean blocked;
+  gint layer;           // BlockLayer of the matching rule
+  gint rule_index;      // rule id within its layer, -1 for domains
+  const char *rule;     // rule text, valid until the cache is cleared
+  guint64 rule_key;     // hit counter keys of the rule and blocked domain
+  guint64 domain_key;
+} CachedDecision;
+
+// Counters for sizing the cache
+typedef struct {
+  guint64 hits;
+  guint64 misses;
+  guint64 evictions;
+  guint64 invalidations;
+  guint size;
+  guint capacity;
+} DecisionCacheStats;
+
+// Create a cache holding at most capacity verdicts
+DecisionCache* decision_cache_new(guint capacity);
+
+// Key for a request URL, its first-party host (NULL if unknown) and any
+// other request context packed into context
+guint64 decision_cache_key(const char *url, gsize url_len, const char *first_party,
+                           gsize first_party_len, guint32 context);
+
+// Look up a verdict. Returns TRUE on a hit and marks the entry as most
+// recently used.
+gboolean decision_cache_lookup(DecisionCache *cache, guint64 key, CachedDecision *decision);
+
+// Store a verdict, evicting the least recently used entry when full
+void decision_cache_insert(DecisionCache *cache, guint64 key, const CachedDecision *decision);
+
+// Drop every verdict. Call whenever filter lists or allowlists change.
+void decision_cache_clear(DecisionCache *cache);
+
+// Get hit, miss and eviction counters
+void decision_cache_get_stats(const DecisionCache *cache, DecisionCacheStats *stats);
+
+// Free cache
+void decision_cache_free(DecisionCache *cache);
+
+#endif // DECISION_CACHE_H
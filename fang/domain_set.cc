@@ -0,0 +1,337 @@
+#include "domain_set.h"
+#include "snapshot.h"
+#include "bloom_filter.h"
+#include <string.h>
+
+#define DOMAIN_SET_NONE G_MAXUINT32
+#define DOMAIN_SET_ANY_PATH (G_MAXUINT32 - 1)
+
+// Open-addressed slot. Strings live in one pool and are referenced by
+// offset, which keeps the table compact for 100k-entry blocklists.
+typedef struct {
+  guint32 hash;
+  guint32 domain;      // pool offset, DOMAIN_SET_NONE for an empty slot
+  guint32 domain_len;
+  guint32 paths;       // first PathEntry, or DOMAIN_SET_ANY_PATH
+} DomainSlot;
+
+// Path-restricted entry, e.g. "facebook.com/tr"
+typedef struct {
+  guint32 text;        // pool offset of the full entry text
+  guint32 prefix_len;  // length of the path part
+  guint32 next;
+} PathEntry;
+
+// Table sizes, stored as is in snapshots
+typedef struct {
+  guint32 capacity;
+  guint32 used;
+  guint32 entries;
+} DomainSetInfo;
+
+enum {
+  SECTION_INFO = 1,
+  SECTION_SLOTS,
+  SECTION_PATHS,
+  SECTION_POOL
+};
+
+struct DomainSet {
+  DomainSlot *slots;   // read-only when mapped from a snapshot
+  guint capacity;      // power of two
+  guint used;
+  guint entries;
+  GArray *paths;
+  GString *pool;
+
+  // Mapped tables replacing slots, paths and pool
+  Snapshot *snapshot;
+  const PathEntry *mapped_paths;
+  const char *mapped_pool;
+
+  // Hashes of every domain, sized for the table's load limit. Hosts with
+  // no listed parent usually settle on it without reaching the slots.
+  BloomFilter *prefilter;
+};
+
+static inline const char* set_pool(const DomainSet *set) {
+  return set->snapshot ? set->mapped_pool : set->pool->str;
+}
+
+static inline const PathEntry* set_paths(const DomainSet *set) {
+  return set->snapshot ? set->mapped_paths : (const PathEntry *)(void *)set->paths->data;
+}
+
+static inline guint32 hash_domain(const char *s, gsize len) {
+  guint32 h = 2166136261u;
+  for (gsize i = 0; i < len; i++) {
+    h ^= (guchar)s[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+static void init_slots(DomainSlot *slots, guint capacity) {
+  for (guint i = 0; i < capacity; i++) {
+    slots[i].domain = DOMAIN_SET_NONE;
+  }
+}
+
+static void build_prefilter(DomainSet *set) {
+  bloom_filter_free(set->prefilter);
+  set->prefilter = bloom_filter_new(set->capacity / 2);
+  for (guint i = 0; i < set->capacity; i++) {
+    if (set->slots[i].domain != DOMAIN_SET_NONE) bloom_filter_add(set->prefilter, set->slots[i].hash);
+  }
+}
+
+DomainSet* domain_set_new() {
+  DomainSet *set = g_new0(DomainSet, 1);
+  set->capacity = 64;
+  set->slots = g_new(DomainSlot, set->capacity);
+  init_slots(set->slots, set->capacity);
+  set->paths = g_array_new(FALSE, FALSE, sizeof(PathEntry));
+  set->pool = g_string_new(NULL);
+  build_prefilter(set);
+  return set;
+}
+
+static DomainSlot* find_slot(const DomainSet *set, const char *domain, gsize len, guint32 hash) {
+  guint mask = set->capacity - 1;
+  for (guint i = hash & mask; ; i = (i + 1) & mask) {
+    DomainSlot *slot = &set->slots[i];
+    if (slot->domain == DOMAIN_SET_NONE) {
+      return slot;
+    }
+    if (slot->hash == hash && slot->domain_len == len &&
+        memcmp(set_pool(set) + slot->domain, domain, len) == 0) {
+      return slot;
+    }
+  }
+}
+
+static void grow(DomainSet *set) {
+  DomainSlot *old = set->slots;
+  guint old_capacity = set->capacity;
+
+  set->capacity *= 2;
+  set->slots = g_new(DomainSlot, set->capacity);
+  init_slots(set->slots, set->capacity);
+
+  guint mask = set->capacity - 1;
+  for (guint i = 0; i < old_capacity; i++) {
+    if (old[i].domain == DOMAIN_SET_NONE) continue;
+    guint j = old[i].hash & mask;
+    while (set->slots[j].domain != DOMAIN_SET_NONE) {
+      j = (j + 1) & mask;
+    }
+    set->slots[j] = old[i];
+  }
+  g_free(old);
+  build_prefilter(set);
+}
+
+static guint32 pool_add(GString *pool, const char *s, gsize len) {
+  guint32 offset = (guint32)pool->len;
+  g_string_append_len(pool, s, len);
+  g_string_append_c(pool, '\0');
+  return offset;
+}
+
+gboolean domain_set_add(DomainSet *set, const char *entry) {
+  if (!set || set->snapshot || !entry) return FALSE;
+
+  gchar *text = g_ascii_strdown(entry, -1);
+  g_strstrip(text);
+
+  // Accept "*.example.com" and ".example.com" as plain suffix entries
+  const char *domain = text;
+  if (g_str_has_prefix(domain, "*.")) domain += 2;
+  else if (domain[0] == '.') domain += 1;
+
+  const char *slash = strchr(domain, '/');
+  if (slash && slash[1] == '\0') slash = NULL;
+  gsize len = slash ? (gsize)(slash - domain) : strlen(domain);
+  while (len > 0 && domain[len - 1] == '.') len--;
+
+  gboolean valid = len > 0;
+  for (gsize i = 0; valid && i < len; i++) {
+    char c = domain[i];
+    valid = (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '.' || c == '-' || c == '_';
+  }
+  if (!valid) {
+    g_free(text);
+    return FALSE;
+  }
+
+  if ((set->used + 1) * 2 > set->capacity) {
+    grow(set);
+  }
+
+  guint32 hash = hash_domain(domain, len);
+  DomainSlot *slot = find_slot(set, domain, len, hash);
+  gboolean is_new = slot->domain == DOMAIN_SET_NONE;
+  if (is_new) {
+    slot->hash = hash;
+    slot->domain = pool_add(set->pool, domain, len);
+    slot->domain_len = (guint32)len;
+    slot->paths = slash ? DOMAIN_SET_NONE : DOMAIN_SET_ANY_PATH;
+    set->used++;
+    bloom_filter_add(set->prefilter, hash);
+  }
+
+  if (!slash) {
+    // A whole-domain entry supersedes any path-restricted ones
+    if (!is_new && slot->paths == DOMAIN_SET_ANY_PATH) {
+      g_free(text);
+      return TRUE;
+    }
+    slot->paths = DOMAIN_SET_ANY_PATH;
+  } else if (slot->paths == DOMAIN_SET_ANY_PATH) {
+    g_free(text);
+    return TRUE;
+  } else {
+    // Stored as the trimmed domain followed by the path, which matching
+    // reads at domain_len
+    gchar *stored = g_strdup_printf("%.*s%s", (int)len, domain, slash);
+    PathEntry path;
+    path.text = pool_add(set->pool, stored, strlen(stored));
+    path.prefix_len = (guint32)strlen(slash);
+    g_free(stored);
+    path.next = slot->paths;
+    g_array_append_val(set->paths, path);
+    slot->paths = set->paths->len - 1;
+  }
+
+  set->entries++;
+  g_free(text);
+  return TRUE;
+}
+
+const char* domain_set_match(const DomainSet *set, const char *host, gsize host_len,
+                             const char *path, gsize path_len) {
+  if (!set || !host || set->used == 0) return NULL;
+
+  // Try the host itself, then each parent domain: a.b.example.com,
+  // b.example.com, example.com, com
+  gsize start = 0;
+  while (start < host_len) {
+    const char *label = host + start;
+    gsize len = host_len - start;
+    guint32 hash = hash_domain(label, len);
+    const DomainSlot *slot = bloom_filter_may_contain(set->prefilter, hash)
+                               ? find_slot(set, label, len, hash) : NULL;
+
+    if (slot && slot->domain != DOMAIN_SET_NONE) {
+      const char *pool = set_pool(set);
+      if (slot->paths == DOMAIN_SET_ANY_PATH) {
+        return pool + slot->domain;
+      }
+      const PathEntry *paths = set_paths(set);
+      for (guint32 p = slot->paths; p != DOMAIN_SET_NONE; p = paths[p].next) {
+        const PathEntry *entry = &paths[p];
+        const char *prefix = pool + entry->text + slot->domain_len;
+        if (path && path_len >= entry->prefix_len &&
+            g_ascii_strncasecmp(path, prefix, entry->prefix_len) == 0) {
+          return pool + entry->text;
+        }
+      }
+    }
+
+    const char *dot = (const char *)memchr(label, '.', len);
+    if (!dot) break;
+    start = (gsize)(dot - host) + 1;
+  }
+
+  return NULL;
+}
+
+void domain_set_get_prefilter_stats(const DomainSet *set, gsize *size, double *fpr) {
+  const BloomFilter *prefilter = set ? set->prefilter : NULL;
+  if (size) *size = bloom_filter_get_size(prefilter);
+  if (fpr) *fpr = bloom_filter_measure_fpr(prefilter);
+}
+
+guint domain_set_size(const DomainSet *set) {
+  return set ? set->entries : 0;
+}
+
+gboolean domain_set_save_snapshot(const DomainSet *set, const char *path, guint64 source_key) {
+  if (!set || set->snapshot) return FALSE;
+
+  DomainSetInfo info;
+  info.capacity = set->capacity;
+  info.used = set->used;
+  info.entries = set->entries;
+
+  SnapshotWriter *writer = snapshot_writer_new(SNAPSHOT_KIND_DOMAIN_SET, source_key);
+  snapshot_writer_add(writer, SECTION_INFO, &info, sizeof(info));
+  snapshot_writer_add(writer, SECTION_SLOTS, set->slots, set->capacity * sizeof(DomainSlot));
+  snapshot_writer_add(writer, SECTION_PATHS, set->paths->data, set->paths->len * sizeof(PathEntry));
+  snapshot_writer_add(writer, SECTION_POOL, set->pool->str, set->pool->len + 1);
+  gboolean ok = snapshot_writer_save(writer, path);
+  snapshot_writer_free(writer);
+  return ok;
+}
+
+DomainSet* domain_set_open_snapshot(const char *path, guint64 source_key) {
+  Snapshot *snapshot = snapshot_open(path, SNAPSHOT_KIND_DOMAIN_SET, source_key);
+  if (!snapshot) return NULL;
+
+  gsize info_len = 0, slots_len = 0, paths_len = 0, pool_len = 0;
+  const DomainSetInfo *info =
+      (const DomainSetInfo *)snapshot_get_section(snapshot, SECTION_INFO, &info_len);
+  const DomainSlot *slots =
+      (const DomainSlot *)snapshot_get_section(snapshot, SECTION_SLOTS, &slots_len);
+  const PathEntry *paths =
+      (const PathEntry *)snapshot_get_section(snapshot, SECTION_PATHS, &paths_len);
+  const char *pool = (const char *)snapshot_get_section(snapshot, SECTION_POOL, &pool_len);
+
+  // Lookups need a free slot to stop probing, in-range offsets and path
+  // chains that only point backwards
+  gboolean valid = info && info_len == sizeof(DomainSetInfo) && slots && pool && pool_len > 0 &&
+                   pool[pool_len - 1] == '\0' && info->capacity > 0 &&
+                   (info->capacity & (info->capacity - 1)) == 0 && info->used < info->capacity &&
+                   slots_len == info->capacity * sizeof(DomainSlot);
+  guint32 n_paths = (guint32)(paths_len / sizeof(PathEntry));
+  for (guint32 i = 0; valid && i < n_paths; i++) {
+    valid = paths[i].text < pool_len && (paths[i].next == DOMAIN_SET_NONE || paths[i].next < i);
+  }
+  for (guint32 i = 0; valid && i < info->capacity; i++) {
+    const DomainSlot *slot = &slots[i];
+    if (slot->domain == DOMAIN_SET_NONE) continue;
+    valid = (gsize)slot->domain + slot->domain_len < pool_len &&
+            (slot->paths == DOMAIN_SET_NONE || slot->paths == DOMAIN_SET_ANY_PATH ||
+             slot->paths < n_paths);
+  }
+
+  if (!valid) {
+    snapshot_close(snapshot);
+    return NULL;
+  }
+
+  DomainSet *set = g_new0(DomainSet, 1);
+  set->slots = (DomainSlot *)slots;
+  set->capacity = info->capacity;
+  set->used = info->used;
+  set->entries = info->entries;
+  set->snapshot = snapshot;
+  set->mapped_paths = paths;
+  set->mapped_pool = pool;
+  build_prefilter(set);
+  return set;
+}
+
+void domain_set_free(DomainSet *set) {
+  if (!set) return;
+  bloom_filter_free(set->prefilter);
+  if (set->snapshot) {
+    snapshot_close(set->snapshot);
+    g_free(set);
+    return;
+  }
+  g_free(set->slots);
+  g_array_free(set->paths, TRUE);
+  g_string_free(set->pool, TRUE);
+  g_free(set);
+}
@@ -0,0 +1,40 @@
+#ifndef DOMAIN_SET_H
+#define DOMAIN_SET_H
+
+#include <glib.h>
+
+// Hashed suffix set of domains. A host matches an entry when it equals the
+// entry's domain or is a subdomain of it, so a lookup costs one hash probe
+// per label. Entries may carry a path prefix ("facebook.com/tr").
+typedef struct DomainSet DomainSet;
+
+// Create an empty set
+DomainSet* domain_set_new();
+
+// Add "example.com" or "example.com/path" (case-insensitive).
+// Returns FALSE if the entry is not a usable domain.
+gboolean domain_set_add(DomainSet *set, const char *entry);
+
+// Match a lowercase host (and optional path) against the set.
+// Returns the matching entry text, or NULL.
+const char* domain_set_match(const DomainSet *set, const char *host, gsize host_len,
+                             const char *path, gsize path_len);
+
+// Number of entries
+guint domain_set_size(const DomainSet *set);
+
+// Memory and measured false-positive rate of the Bloom filter consulted
+// before the slots
+void domain_set_get_prefilter_stats(const DomainSet *set, gsize *size, double *fpr);
+
+// Write the set to a snapshot file. source_key identifies its inputs.
+gboolean domain_set_save_snapshot(const DomainSet *set, const char *path, guint64 source_key);
+
+// Open a read-only set mapped from a snapshot, or NULL if it is missing,
+// stale or damaged. domain_set_add fails on such a set.
+DomainSet* domain_set_open_snapshot(const char *path, guint64 source_key);
+
+// Free set
+void domain_set_free(DomainSet *set);
+
+#endif // DOMAIN_SET_H
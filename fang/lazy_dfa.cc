@@ -0,0 +1,726 @@
+#include "lazy_dfa.h"
+#include <string.h>
+
+// Limits keeping one expression from blowing up the NFA or the stack
+#define MAX_REPEAT 100
+#define MAX_PATTERN_INSTS 4096
+#define MAX_GROUP_DEPTH 32
+
+typedef struct {
+  guint64 bits[4];
+} ByteSet;
+
+static inline void byte_set_add(ByteSet *set, guint c) {
+  set->bits[c >> 6] |= 1ull << (c & 63);
+}
+
+static inline gboolean byte_set_has(const ByteSet *set, guint c) {
+  return (set->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static void byte_set_invert(ByteSet *set) {
+  for (int i = 0; i < 4; i++) set->bits[i] = ~set->bits[i];
+}
+
+static void byte_set_merge(ByteSet *set, const ByteSet *other) {
+  for (int i = 0; i < 4; i++) set->bits[i] |= other->bits[i];
+}
+
+// Expression tree built by the parser
+enum { NODE_EMPTY, NODE_SET, NODE_CONCAT, NODE_ALT, NODE_REPEAT, NODE_BEGIN, NODE_END };
+
+typedef struct RegexNode {
+  int kind;
+  struct RegexNode *left;     // CONCAT and ALT operands, REPEAT body
+  struct RegexNode *right;
+  ByteSet set;                // NODE_SET
+  gint min;                   // NODE_REPEAT, max -1 for no bound
+  gint max;
+} RegexNode;
+
+typedef struct {
+  const char *p;
+  const char *end;
+  gboolean ignore_case;
+  GPtrArray *nodes;           // every node, freed together
+  int depth;
+  gboolean failed;
+} RegexParser;
+
+// NFA instructions. SET consumes a byte of its set; BEGIN and END only
+// pass at the start and end of the text.
+enum { NFA_SET, NFA_SPLIT, NFA_MATCH, NFA_BEGIN, NFA_END };
+
+typedef struct {
+  guint32 op;
+  guint32 out;
+  guint32 out1;               // second branch of SPLIT
+  guint32 arg;                // set index of SET, pattern id of MATCH
+} NfaInst;
+
+// DFA state: the sorted NFA leaves (SET, MATCH and END instructions) it
+// stands for, the ids matched on entering it and its cached transitions,
+// one per byte class plus one for the end of the text
+typedef struct DfaState {
+  guint32 n_insts;
+  guint32 n_matches;
+  const guint32 *insts;
+  const guint32 *matches;
+  struct DfaState **next;
+} DfaState;
+
+struct LazyDfa {
+  GArray *nfa;                // NfaInst
+  GArray *sets;               // ByteSet
+  GArray *starts;             // first instruction of each pattern
+  gboolean compiled;
+
+  // Bytes no set tells apart share a class, and transitions
+  guchar byte_class[256];
+  guchar class_byte[256];     // one byte of each class
+  guint n_classes;
+
+  // Leaves of every pattern start away from the beginning of the text,
+  // merged into each state so patterns are searched at every offset
+  GArray *restart;
+
+  // State cache. Scans read it under the reader lock; a scan that needs a
+  // new state starts over under the writer lock and builds it.
+  GRWLock lock;
+  GHashTable *states;
+  DfaState *start;
+  gsize memory;
+  gsize memory_limit;
+  guint64 flushes;
+
+  // Scratch space for building states, used under the writer lock
+  guint32 *mark;
+  guint32 mark_gen;
+  GArray *stack;
+  GArray *work;
+};
+
+// ========== Parser ==========
+
+static RegexNode* new_node(RegexParser *parser, int kind) {
+  RegexNode *node = g_new0(RegexNode, 1);
+  node->kind = kind;
+  g_ptr_array_add(parser->nodes, node);
+  return node;
+}
+
+static RegexNode* new_pair(RegexParser *parser, int kind, RegexNode *left, RegexNode *right) {
+  RegexNode *node = new_node(parser, kind);
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
+static void add_byte(ByteSet *set, guint c, gboolean ignore_case) {
+  byte_set_add(set, c);
+  if (ignore_case && g_ascii_isalpha(c)) {
+    byte_set_add(set, (guchar)(g_ascii_isupper(c) ? g_ascii_tolower(c) : g_ascii_toupper(c)));
+  }
+}
+
+// \d \w \s and their negations
+static gboolean add_class_escape(ByteSet *set, char e) {
+  ByteSet bytes;
+  memset(&bytes, 0, sizeof(bytes));
+  switch (g_ascii_tolower(e)) {
+    case 'd':
+      for (guint c = '0'; c <= '9'; c++) byte_set_add(&bytes, c);
+      break;
+    case 'w':
+      for (guint c = 0; c < 128; c++) {
+        if (g_ascii_isalnum(c) || c == '_') byte_set_add(&bytes, c);
+      }
+      break;
+    case 's':
+      for (const char *s = " \t\n\r\f\v"; *s; s++) byte_set_add(&bytes, (guchar)*s);
+      break;
+    default:
+      return FALSE;
+  }
+  if (g_ascii_isupper(e)) byte_set_invert(&bytes);
+  byte_set_merge(set, &bytes);
+  return TRUE;
+}
+
+static int hex_value(RegexParser *parser, int digits) {
+  if (parser->end - parser->p < digits) return -1;
+  int value = 0;
+  for (int i = 0; i < digits; i++) {
+    int d = g_ascii_xdigit_value(*parser->p++);
+    if (d < 0) return -1;
+    value = value * 16 + d;
+  }
+  return value;
+}
+
+// Escape after a '\'. Returns the byte it stands for, ESCAPE_CLASS when
+// it added a class to set, or ESCAPE_FAIL.
+#define ESCAPE_CLASS -1
+#define ESCAPE_FAIL -2
+
+static int parse_escape(RegexParser *parser, ByteSet *set, gboolean in_class) {
+  if (parser->p >= parser->end) return ESCAPE_FAIL;
+  char e = *parser->p++;
+  if (add_class_escape(set, e)) return ESCAPE_CLASS;
+
+  switch (e) {
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 't': return '\t';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    case '0': return '\0';
+    case 'b': return in_class ? '\b' : ESCAPE_FAIL;   // word boundary
+    case 'x':
+    case 'u': {
+      int value = hex_value(parser, e == 'x' ? 2 : 4);
+      return value >= 0 && value < 0x80 ? value : ESCAPE_FAIL;
+    }
+    default:
+      // Backreferences and unknown letter escapes are not ours to guess
+      return g_ascii_isalnum(e) ? ESCAPE_FAIL : (guchar)e;
+  }
+}
+
+static RegexNode* parse_class(RegexParser *parser) {
+  RegexNode *node = new_node(parser, NODE_SET);
+  ByteSet *set = &node->set;
+  gboolean negate = parser->p < parser->end && *parser->p == '^';
+  if (negate) parser->p++;
+
+  while (parser->p < parser->end && *parser->p != ']') {
+    int lo = (guchar)*parser->p++;
+    if (lo == '\\') {
+      lo = parse_escape(parser, set, TRUE);
+      if (lo == ESCAPE_CLASS) continue;
+    }
+    if (lo < 0 || lo >= 0x80) {
+      parser->failed = TRUE;
+      return node;
+    }
+
+    int hi = lo;
+    if (parser->end - parser->p >= 2 && parser->p[0] == '-' && parser->p[1] != ']') {
+      parser->p++;
+      hi = (guchar)*parser->p++;
+      if (hi == '\\') hi = parse_escape(parser, set, TRUE);
+      if (hi < lo || hi >= 0x80) {
+        parser->failed = TRUE;
+        return node;
+      }
+    }
+    for (int c = lo; c <= hi; c++) add_byte(set, (guint)c, parser->ignore_case);
+  }
+
+  if (parser->p >= parser->end) {
+    parser->failed = TRUE;
+    return node;
+  }
+  parser->p++;
+  if (negate) byte_set_invert(set);
+  return node;
+}
+
+static RegexNode* parse_alternation(RegexParser *parser);
+
+static RegexNode* parse_atom(RegexParser *parser) {
+  guchar c = (guchar)*parser->p++;
+  RegexNode *node;
+
+  switch (c) {
+    case '(':
+      // Lookaround and named groups are not supported
+      if (parser->p < parser->end && *parser->p == '?') {
+        if (parser->end - parser->p < 2 || parser->p[1] != ':') {
+          parser->failed = TRUE;
+          return NULL;
+        }
+        parser->p += 2;
+      }
+      if (++parser->depth > MAX_GROUP_DEPTH) {
+        parser->failed = TRUE;
+        return NULL;
+      }
+      node = parse_alternation(parser);
+      parser->depth--;
+      if (parser->p >= parser->end || *parser->p != ')') {
+        parser->failed = TRUE;
+        return NULL;
+      }
+      parser->p++;
+      return node;
+    case '[':
+      return parse_class(parser);
+    case '.':
+      node = new_node(parser, NODE_SET);
+      memset(&node->set, 0xff, sizeof(node->set));
+      node->set.bits['\n' >> 6] &= ~(1ull << '\n');
+      return node;
+    case '^':
+      return new_node(parser, NODE_BEGIN);
+    case '$':
+      return new_node(parser, NODE_END);
+    case '*':
+    case '+':
+    case '?':
+      // Nothing to repeat
+      parser->failed = TRUE;
+      return NULL;
+    case '\\': {
+      node = new_node(parser, NODE_SET);
+      int value = parse_escape(parser, &node->set, FALSE);
+      if (value == ESCAPE_FAIL) parser->failed = TRUE;
+      else if (value != ESCAPE_CLASS) add_byte(&node->set, (guint)value, parser->ignore_case);
+      return node;
+    }
+    default:
+      node = new_node(parser, NODE_SET);
+      add_byte(&node->set, c, parser->ignore_case);
+      return node;
+  }
+}
+
+// "{n}", "{n,}" or "{n,m}" at p; anything else is a literal '{'
+static gboolean parse_bounds(RegexParser *parser, gint *min, gint *max) {
+  const char *p = parser->p + 1;
+  gint64 lo = 0, hi = -1;
+  if (p >= parser->end || !g_ascii_isdigit(*p)) return FALSE;
+  while (p < parser->end && g_ascii_isdigit(*p)) lo = MIN(lo * 10 + (*p - '0'), 100000), p++;
+  if (p < parser->end && *p == ',') {
+    p++;
+    if (p < parser->end && g_ascii_isdigit(*p)) {
+      hi = 0;
+      while (p < parser->end && g_ascii_isdigit(*p)) hi = MIN(hi * 10 + (*p - '0'), 100000), p++;
+    }
+  } else {
+    hi = lo;
+  }
+  if (p >= parser->end || *p != '}') return FALSE;
+
+  parser->p = p + 1;
+  *min = (gint)lo;
+  *max = (gint)hi;
+  return TRUE;
+}
+
+static RegexNode* parse_repeat(RegexParser *parser) {
+  RegexNode *node = parse_atom(parser);
+  while (!parser->failed && parser->p < parser->end) {
+    gint min, max;
+    char c = *parser->p;
+    if (c == '*') {
+      min = 0;
+      max = -1;
+      parser->p++;
+    } else if (c == '+') {
+      min = 1;
+      max = -1;
+      parser->p++;
+    } else if (c == '?') {
+      min = 0;
+      max = 1;
+      parser->p++;
+    } else if (c != '{' || !parse_bounds(parser, &min, &max)) {
+      break;
+    }
+    if (min > MAX_REPEAT || max > MAX_REPEAT || (max >= 0 && max < min)) {
+      parser->failed = TRUE;
+      break;
+    }
+
+    // Lazy quantifiers match the same texts
+    if (parser->p < parser->end && *parser->p == '?') parser->p++;
+    RegexNode *repeat = new_node(parser, NODE_REPEAT);
+    repeat->left = node;
+    repeat->min = min;
+    repeat->max = max;
+    node = repeat;
+  }
+  return node;
+}
+
+static RegexNode* parse_sequence(RegexParser *parser) {
+  RegexNode *node = new_node(parser, NODE_EMPTY);
+  while (!parser->failed && parser->p < parser->end && *parser->p != '|' && *parser->p != ')') {
+    RegexNode *atom = parse_repeat(parser);
+    node = node->kind == NODE_EMPTY ? atom : new_pair(parser, NODE_CONCAT, node, atom);
+  }
+  return node;
+}
+
+static RegexNode* parse_alternation(RegexParser *parser) {
+  RegexNode *node = parse_sequence(parser);
+  while (!parser->failed && parser->p < parser->end && *parser->p == '|') {
+    parser->p++;
+    node = new_pair(parser, NODE_ALT, node, parse_sequence(parser));
+  }
+  return node;
+}
+
+// ========== NFA ==========
+
+typedef struct {
+  LazyDfa *dfa;
+  guint base;                 // NFA size before the pattern
+  gboolean failed;
+} NfaBuilder;
+
+static guint32 add_inst(NfaBuilder *b, guint32 op, guint32 out, guint32 out1, guint32 arg) {
+  if (b->dfa->nfa->len - b->base >= MAX_PATTERN_INSTS) b->failed = TRUE;
+  NfaInst inst = { op, out, out1, arg };
+  g_array_append_val(b->dfa->nfa, inst);
+  return b->dfa->nfa->len - 1;
+}
+
+// Emit node so that every path through it continues at out; returns its
+// first instruction. Built back to front, so no jumps need patching.
+static guint32 emit(NfaBuilder *b, const RegexNode *node, guint32 out) {
+  if (b->failed) return out;
+
+  switch (node->kind) {
+    case NODE_SET:
+      g_array_append_val(b->dfa->sets, node->set);
+      return add_inst(b, NFA_SET, out, 0, b->dfa->sets->len - 1);
+    case NODE_CONCAT:
+      return emit(b, node->left, emit(b, node->right, out));
+    case NODE_ALT: {
+      guint32 left = emit(b, node->left, out);
+      guint32 right = emit(b, node->right, out);
+      return add_inst(b, NFA_SPLIT, left, right, 0);
+    }
+    case NODE_BEGIN:
+      return add_inst(b, NFA_BEGIN, out, 0, 0);
+    case NODE_END:
+      return add_inst(b, NFA_END, out, 0, 0);
+    case NODE_REPEAT: {
+      guint32 next = out;
+      if (node->max < 0) {
+        // Loop back through a split that either runs the body again or leaves
+        guint32 loop = add_inst(b, NFA_SPLIT, 0, out, 0);
+        guint32 body = emit(b, node->left, loop);
+        g_array_index(b->dfa->nfa, NfaInst, loop).out = body;
+        next = loop;
+      } else {
+        for (gint i = node->min; i < node->max && !b->failed; i++) {
+          next = add_inst(b, NFA_SPLIT, emit(b, node->left, next), out, 0);
+        }
+      }
+      for (gint i = 0; i < node->min && !b->failed; i++) {
+        next = emit(b, node->left, next);
+      }
+      return next;
+    }
+    default:
+      return out;
+  }
+}
+
+LazyDfa* lazy_dfa_new(gsize memory_limit) {
+  LazyDfa *dfa = g_new0(LazyDfa, 1);
+  dfa->nfa = g_array_new(FALSE, FALSE, sizeof(NfaInst));
+  dfa->sets = g_array_new(FALSE, FALSE, sizeof(ByteSet));
+  dfa->starts = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dfa->restart = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dfa->stack = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dfa->work = g_array_new(FALSE, FALSE, sizeof(guint32));
+  dfa->memory_limit = memory_limit;
+  g_rw_lock_init(&dfa->lock);
+  return dfa;
+}
+
+gboolean lazy_dfa_add(LazyDfa *dfa, const char *regex, gsize len, guint32 id, gboolean ignore_case) {
+  if (!dfa || dfa->compiled || !regex) return FALSE;
+
+  RegexParser parser;
+  parser.p = regex;
+  parser.end = regex + len;
+  parser.ignore_case = ignore_case;
+  parser.nodes = g_ptr_array_new_with_free_func(g_free);
+  parser.depth = 0;
+  parser.failed = FALSE;
+  RegexNode *root = parse_alternation(&parser);
+  if (parser.p != parser.end) parser.failed = TRUE;   // unbalanced ')'
+
+  NfaBuilder builder = { dfa, dfa->nfa->len, parser.failed };
+  guint sets_before = dfa->sets->len;
+  if (!builder.failed) {
+    guint32 match = add_inst(&builder, NFA_MATCH, 0, 0, id);
+    guint32 start = emit(&builder, root, match);
+    if (!builder.failed) g_array_append_val(dfa->starts, start);
+  }
+  g_ptr_array_free(parser.nodes, TRUE);
+
+  if (builder.failed) {
+    g_array_set_size(dfa->nfa, builder.base);
+    g_array_set_size(dfa->sets, sets_before);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+gboolean lazy_dfa_check(const char *regex, gsize len) {
+  LazyDfa *dfa = lazy_dfa_new(0);
+  gboolean ok = lazy_dfa_add(dfa, regex, len, 0, FALSE);
+  lazy_dfa_free(dfa);
+  return ok;
+}
+
+// ========== DFA states ==========
+
+static void next_mark(LazyDfa *dfa) {
+  if (++dfa->mark_gen == 0) {
+    memset(dfa->mark, 0, dfa->nfa->len * sizeof(guint32));
+    dfa->mark_gen = 1;
+  }
+}
+
+// Add the leaves reachable from pc without consuming a byte to work
+static void add_closure(LazyDfa *dfa, guint32 pc, gboolean at_begin, gboolean at_end) {
+  const NfaInst *nfa = (const NfaInst *)(void *)dfa->nfa->data;
+  g_array_set_size(dfa->stack, 0);
+  g_array_append_val(dfa->stack, pc);
+
+  while (dfa->stack->len > 0) {
+    pc = g_array_index(dfa->stack, guint32, dfa->stack->len - 1);
+    g_array_set_size(dfa->stack, dfa->stack->len - 1);
+    if (dfa->mark[pc] == dfa->mark_gen) continue;
+    dfa->mark[pc] = dfa->mark_gen;
+
+    const NfaInst *inst = &nfa[pc];
+    switch (inst->op) {
+      case NFA_SPLIT:
+        g_array_append_val(dfa->stack, inst->out1);
+        g_array_append_val(dfa->stack, inst->out);
+        break;
+      case NFA_BEGIN:
+        if (at_begin) g_array_append_val(dfa->stack, inst->out);
+        break;
+      case NFA_END:
+        if (at_end) g_array_append_val(dfa->stack, inst->out);
+        else g_array_append_val(dfa->work, pc);
+        break;
+      default:
+        g_array_append_val(dfa->work, pc);
+        break;
+    }
+  }
+}
+
+static guint state_hash(gconstpointer key) {
+  const DfaState *state = (const DfaState *)key;
+  guint32 h = 2166136261u;
+  for (guint32 i = 0; i < state->n_insts; i++) h = (h ^ state->insts[i]) * 16777619u;
+  return h;
+}
+
+static gboolean state_equal(gconstpointer a, gconstpointer b) {
+  const DfaState *x = (const DfaState *)a, *y = (const DfaState *)b;
+  return x->n_insts == y->n_insts && memcmp(x->insts, y->insts, x->n_insts * sizeof(guint32)) == 0;
+}
+
+static gint compare_guint32(gconstpointer a, gconstpointer b) {
+  guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+  return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void flush_states(LazyDfa *dfa) {
+  g_hash_table_remove_all(dfa->states);
+  dfa->start = NULL;
+  dfa->memory = 0;
+  dfa->flushes++;
+}
+
+// State for the leaves in work, built if it is not cached. May flush the
+// cache, which invalidates every other state pointer.
+static DfaState* find_state(LazyDfa *dfa, gboolean *flushed) {
+  g_array_sort(dfa->work, compare_guint32);
+  DfaState key;
+  key.n_insts = dfa->work->len;
+  key.insts = (const guint32 *)(void *)dfa->work->data;
+  DfaState *state = (DfaState *)g_hash_table_lookup(dfa->states, &key);
+  if (state) return state;
+
+  const NfaInst *nfa = (const NfaInst *)(void *)dfa->nfa->data;
+  guint32 n_matches = 0;
+  for (guint32 i = 0; i < key.n_insts; i++) {
+    if (nfa[key.insts[i]].op == NFA_MATCH) n_matches++;
+  }
+
+  gsize n_next = dfa->n_classes + 1;
+  gsize size = sizeof(DfaState) + n_next * sizeof(DfaState *) + (key.n_insts + n_matches) * sizeof(guint32);
+  if (dfa->memory + size > dfa->memory_limit && g_hash_table_size(dfa->states) > 0) {
+    flush_states(dfa);
+    if (flushed) *flushed = TRUE;
+  }
+
+  // One block: the state, its transitions, then its leaves and matches
+  state = (DfaState *)g_malloc0(size);
+  state->next = (DfaState **)(state + 1);
+  guint32 *insts = (guint32 *)(state->next + n_next);
+  guint32 *matches = insts + key.n_insts;
+  memcpy(insts, key.insts, key.n_insts * sizeof(guint32));
+  for (guint32 i = 0, m = 0; i < key.n_insts; i++) {
+    if (nfa[insts[i]].op == NFA_MATCH) matches[m++] = nfa[insts[i]].arg;
+  }
+  state->n_insts = key.n_insts;
+  state->n_matches = n_matches;
+  state->insts = insts;
+  state->matches = matches;
+  g_hash_table_add(dfa->states, state);
+  dfa->memory += size;
+  return state;
+}
+
+static DfaState* build_start(LazyDfa *dfa) {
+  next_mark(dfa);
+  g_array_set_size(dfa->work, 0);
+  for (guint i = 0; i < dfa->starts->len; i++) {
+    add_closure(dfa, g_array_index(dfa->starts, guint32, i), TRUE, FALSE);
+  }
+  dfa->start = find_state(dfa, NULL);
+  return dfa->start;
+}
+
+// Follow state on byte class c, or on the end of the text when c is
+// n_classes, and cache the transition
+static DfaState* build_next(LazyDfa *dfa, DfaState *state, guint c) {
+  const NfaInst *nfa = (const NfaInst *)(void *)dfa->nfa->data;
+  const ByteSet *sets = (const ByteSet *)(void *)dfa->sets->data;
+  gboolean at_end = c == dfa->n_classes;
+
+  next_mark(dfa);
+  g_array_set_size(dfa->work, 0);
+  for (guint32 i = 0; i < state->n_insts; i++) {
+    const NfaInst *inst = &nfa[state->insts[i]];
+    if (at_end ? inst->op == NFA_END
+               : inst->op == NFA_SET && byte_set_has(&sets[inst->arg], dfa->class_byte[c])) {
+      add_closure(dfa, inst->out, FALSE, at_end);
+    }
+  }
+
+  if (at_end) {
+    // Only the matches count once the text is over
+    guint kept = 0;
+    for (guint i = 0; i < dfa->work->len; i++) {
+      guint32 pc = g_array_index(dfa->work, guint32, i);
+      if (nfa[pc].op == NFA_MATCH) g_array_index(dfa->work, guint32, kept++) = pc;
+    }
+    g_array_set_size(dfa->work, kept);
+  } else {
+    for (guint i = 0; i < dfa->restart->len; i++) {
+      guint32 pc = g_array_index(dfa->restart, guint32, i);
+      if (dfa->mark[pc] == dfa->mark_gen) continue;
+      dfa->mark[pc] = dfa->mark_gen;
+      g_array_append_val(dfa->work, pc);
+    }
+  }
+
+  gboolean flushed = FALSE;
+  DfaState *next = find_state(dfa, &flushed);
+  if (!flushed) state->next[c] = next;
+  return next;
+}
+
+void lazy_dfa_compile(LazyDfa *dfa) {
+  if (!dfa || dfa->compiled) return;
+
+  // Split the bytes wherever some set changes membership
+  const ByteSet *sets = (const ByteSet *)(void *)dfa->sets->data;
+  guint n_classes = 0;
+  for (guint c = 0; c < 256; c++) {
+    gboolean split = c == 0;
+    for (guint s = 0; s < dfa->sets->len && !split; s++) {
+      split = byte_set_has(&sets[s], c) != byte_set_has(&sets[s], c - 1);
+    }
+    if (split) dfa->class_byte[n_classes++] = (guchar)c;
+    dfa->byte_class[c] = (guchar)(n_classes - 1);
+  }
+  dfa->n_classes = n_classes;
+
+  dfa->mark = g_new0(guint32, MAX(dfa->nfa->len, 1u));
+  dfa->states = g_hash_table_new_full(state_hash, state_equal, NULL, g_free);
+
+  next_mark(dfa);
+  g_array_set_size(dfa->work, 0);
+  for (guint i = 0; i < dfa->starts->len; i++) {
+    add_closure(dfa, g_array_index(dfa->starts, guint32, i), FALSE, FALSE);
+  }
+  g_array_append_vals(dfa->restart, dfa->work->data, dfa->work->len);
+  dfa->compiled = TRUE;
+}
+
+// Walk text through the cached states. Without build, returns FALSE as
+// soon as a transition is missing.
+static gboolean run(LazyDfa *dfa, const guchar *text, gsize len, gboolean build,
+                    PatternMatchFunc func, gpointer user_data) {
+  DfaState *state = dfa->start;
+  if (!state) {
+    if (!build) return FALSE;
+    state = build_start(dfa);
+  }
+
+  // The end of the text is one more step, whose matches end at len
+  for (gsize i = 0; ; i++) {
+    for (guint32 m = 0; m < state->n_matches; m++) {
+      if (func(state->matches[m], MIN(i, len), user_data)) return TRUE;
+    }
+    if (i > len) return TRUE;
+
+    guint c = i < len ? dfa->byte_class[text[i]] : dfa->n_classes;
+    DfaState *next = state->next[c];
+    if (!next) {
+      if (!build) return FALSE;
+      next = build_next(dfa, state, c);
+    }
+    state = next;
+  }
+}
+
+void lazy_dfa_scan(LazyDfa *dfa, const char *text, gsize len, PatternMatchFunc func,
+                   gpointer user_data) {
+  if (!dfa || !dfa->compiled || dfa->starts->len == 0 || !text) return;
+
+  g_rw_lock_reader_lock(&dfa->lock);
+  gboolean done = run(dfa, (const guchar *)text, len, FALSE, func, user_data);
+  g_rw_lock_reader_unlock(&dfa->lock);
+  if (done) return;
+
+  g_rw_lock_writer_lock(&dfa->lock);
+  run(dfa, (const guchar *)text, len, TRUE, func, user_data);
+  g_rw_lock_writer_unlock(&dfa->lock);
+}
+
+void lazy_dfa_get_stats(LazyDfa *dfa, LazyDfaStats *stats) {
+  memset(stats, 0, sizeof(*stats));
+  if (!dfa) return;
+
+  stats->n_patterns = dfa->starts->len;
+  stats->n_nfa_states = dfa->nfa->len;
+  stats->n_byte_classes = dfa->n_classes;
+  stats->program_size = dfa->nfa->len * sizeof(NfaInst) + dfa->sets->len * sizeof(ByteSet) +
+                        dfa->nfa->len * sizeof(guint32);
+  g_rw_lock_reader_lock(&dfa->lock);
+  stats->n_states = dfa->states ? g_hash_table_size(dfa->states) : 0;
+  stats->memory = dfa->memory;
+  stats->flushes = dfa->flushes;
+  g_rw_lock_reader_unlock(&dfa->lock);
+}
+
+void lazy_dfa_free(LazyDfa *dfa) {
+  if (!dfa) return;
+  if (dfa->states) g_hash_table_destroy(dfa->states);
+  g_array_free(dfa->nfa, TRUE);
+  g_array_free(dfa->sets, TRUE);
+  g_array_free(dfa->starts, TRUE);
+  g_array_free(dfa->restart, TRUE);
+  g_array_free(dfa->stack, TRUE);
+  g_array_free(dfa->work, TRUE);
+  g_free(dfa->mark);
+  g_rw_lock_clear(&dfa->lock);
+  g_free(dfa);
+}
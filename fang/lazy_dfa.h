@@ -0,0 +1,55 @@
+#ifndef LAZY_DFA_H
+#define LAZY_DFA_H
+
+#include <glib.h>
+#include "pattern_match.h"
+
+// Set of regular expressions searched in one pass. The expressions share
+// one Thompson NFA; DFA states (sets of NFA states) are only built for the
+// transitions a text actually takes and kept in a cache bounded by a
+// memory limit. When the cache fills up it is flushed and rebuilt from the
+// current position, so a scan is linear in the text whatever the patterns.
+//
+// Supported syntax: literals, '.', classes with ranges and negation,
+// \d \w \s (and negations), \xHH, groups, (?:...), '|', '*', '+', '?',
+// {n,m} and '^' '$' anywhere. Backreferences, lookaround, \b and classes
+// beyond ASCII are rejected.
+typedef struct LazyDfa LazyDfa;
+
+// Create an empty automaton whose state cache uses at most memory_limit bytes
+LazyDfa* lazy_dfa_new(gsize memory_limit);
+
+// Add a regular expression reporting id wherever it matches. Returns FALSE,
+// adding nothing, for unsupported syntax or an expression too large to
+// compile. Must be called before compile.
+gboolean lazy_dfa_add(LazyDfa *dfa, const char *regex, gsize len, guint32 id, gboolean ignore_case);
+
+// Check if a regular expression would be accepted by lazy_dfa_add
+gboolean lazy_dfa_check(const char *regex, gsize len);
+
+// Freeze the expressions. States are built on first use.
+void lazy_dfa_compile(LazyDfa *dfa);
+
+// Scan text and report the id of every expression that matches, with the
+// offset just past the match. An id can be reported more than once. Stops
+// when func returns TRUE. Safe to call from several threads at once.
+void lazy_dfa_scan(LazyDfa *dfa, const char *text, gsize len, PatternMatchFunc func,
+                   gpointer user_data);
+
+// State cache figures
+typedef struct {
+  guint n_patterns;
+  guint n_nfa_states;
+  guint n_byte_classes;
+  gsize program_size;       // bytes of the NFA, its byte sets and scratch space
+  guint n_states;           // DFA states cached now
+  gsize memory;             // bytes used by them
+  guint64 flushes;          // times the cache hit the memory limit
+} LazyDfaStats;
+
+void lazy_dfa_get_stats(LazyDfa *dfa, LazyDfaStats *stats);
+
+// Free dfa
+void lazy_dfa_free(LazyDfa *dfa);
+
+#endif // LAZY_DFA_H
@@ -0,0 +1,323 @@
+#include "literal_matcher.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LITERAL_HAVE_X86 1
+#endif
+
+#define N_BUCKETS 8
+#define FINGERPRINT_MAX 3
+
+typedef struct {
+  guint32 id;
+  guint32 text;         // pool offset, lowercase
+  guint32 len;
+} Literal;
+
+struct LiteralMatcher {
+  GArray *literals;
+  GString *pool;
+
+  // Literals of bucket b are members[bucket_start[b] .. bucket_start[b + 1])
+  guint32 bucket_start[N_BUCKETS + 1];
+  guint32 *members;
+
+  // Candidate masks over the first `fingerprint` bytes of each literal:
+  // bit b of byte_masks[j][c] is set when a literal of bucket b can have
+  // byte c at position j. The SIMD kernels use the same sets split into
+  // low and high nibble tables.
+  guint fingerprint;
+  guchar byte_masks[FINGERPRINT_MAX][256];
+  guchar lo_masks[FINGERPRINT_MAX][16];
+  guchar hi_masks[FINGERPRINT_MAX][16];
+
+  LiteralScanImpl impl;
+  gboolean compiled;
+};
+
+static inline guchar fold(guchar c) {
+  return (c >= 'A' && c <= 'Z') ? (guchar)(c + ('a' - 'A')) : c;
+}
+
+LiteralMatcher* literal_matcher_new() {
+  LiteralMatcher *matcher = g_new0(LiteralMatcher, 1);
+  matcher->literals = g_array_new(FALSE, FALSE, sizeof(Literal));
+  matcher->pool = g_string_new(NULL);
+  return matcher;
+}
+
+void literal_matcher_add(LiteralMatcher *matcher, const char *literal, guint32 id) {
+  if (!matcher || matcher->compiled || !literal || !literal[0]) return;
+
+  Literal entry;
+  entry.id = id;
+  entry.text = (guint32)matcher->pool->len;
+  entry.len = (guint32)strlen(literal);
+  for (guint32 i = 0; i < entry.len; i++) {
+    g_string_append_c(matcher->pool, (char)fold((guchar)literal[i]));
+  }
+  g_string_append_c(matcher->pool, '\0');
+  g_array_append_val(matcher->literals, entry);
+}
+
+static gboolean cpu_supports(LiteralScanImpl impl) {
+#ifdef LITERAL_HAVE_X86
+  __builtin_cpu_init();
+  switch (impl) {
+    case LITERAL_SCAN_AVX2: return __builtin_cpu_supports("avx2");
+    case LITERAL_SCAN_SSSE3: return __builtin_cpu_supports("ssse3");
+    default: return TRUE;
+  }
+#else
+  return impl == LITERAL_SCAN_SCALAR;
+#endif
+}
+
+// Order literal indices by their fingerprint bytes
+static gint compare_fingerprints(gconstpointer a, gconstpointer b, gpointer user_data) {
+  const LiteralMatcher *matcher = (const LiteralMatcher *)user_data;
+  const Literal *la = &g_array_index(matcher->literals, Literal, *(const guint32 *)a);
+  const Literal *lb = &g_array_index(matcher->literals, Literal, *(const guint32 *)b);
+  return memcmp(matcher->pool->str + la->text, matcher->pool->str + lb->text, matcher->fingerprint);
+}
+
+void literal_matcher_compile(LiteralMatcher *matcher) {
+  if (!matcher || matcher->compiled) return;
+
+  guint n = matcher->literals->len;
+  const char *pool = matcher->pool->str;
+
+  matcher->fingerprint = FINGERPRINT_MAX;
+  for (guint i = 0; i < n; i++) {
+    matcher->fingerprint = MIN(matcher->fingerprint, g_array_index(matcher->literals, Literal, i).len);
+  }
+
+  // Literals sharing a fingerprint go to the same bucket so a candidate
+  // only verifies literals that really agree on those bytes. Buckets take
+  // contiguous runs of the sorted groups: neighbours share leading bytes,
+  // which keeps each bucket's nibble masks narrow.
+  GArray *sorted = g_array_sized_new(FALSE, FALSE, sizeof(guint32), n);
+  for (guint32 i = 0; i < n; i++) g_array_append_val(sorted, i);
+  g_array_sort_with_data(sorted, compare_fingerprints, matcher);
+  const guint32 *order = (const guint32 *)(void *)sorted->data;
+
+  guchar *bucket_of = g_new0(guchar, MAX(n, 1));
+  guint32 counts[N_BUCKETS] = { 0 };
+  for (guint i = 0; i < n;) {
+    guint j = i + 1;
+    while (j < n && compare_fingerprints(&order[i], &order[j], matcher) == 0) j++;
+
+    guint bucket = MIN(i * N_BUCKETS / n, N_BUCKETS - 1);
+    for (guint k = i; k < j; k++) bucket_of[order[k]] = (guchar)bucket;
+    counts[bucket] += j - i;
+    i = j;
+  }
+  g_array_free(sorted, TRUE);
+
+  matcher->members = g_new(guint32, MAX(n, 1));
+  matcher->bucket_start[0] = 0;
+  for (guint b = 0; b < N_BUCKETS; b++) {
+    matcher->bucket_start[b + 1] = matcher->bucket_start[b] + counts[b];
+  }
+  guint32 fill[N_BUCKETS];
+  memcpy(fill, matcher->bucket_start, sizeof(fill));
+
+  for (guint i = 0; i < n; i++) {
+    const Literal *lit = &g_array_index(matcher->literals, Literal, i);
+    guint b = bucket_of[i];
+    matcher->members[fill[b]++] = i;
+
+    for (guint j = 0; j < matcher->fingerprint; j++) {
+      guchar c = (guchar)pool[lit->text + j];
+      guchar variants[2] = { c, (c >= 'a' && c <= 'z') ? (guchar)(c - ('a' - 'A')) : c };
+      for (int v = 0; v < 2; v++) {
+        matcher->byte_masks[j][variants[v]] |= (guchar)(1u << b);
+        matcher->lo_masks[j][variants[v] & 0x0f] |= (guchar)(1u << b);
+        matcher->hi_masks[j][variants[v] >> 4] |= (guchar)(1u << b);
+      }
+    }
+  }
+  g_free(bucket_of);
+
+  if (cpu_supports(LITERAL_SCAN_AVX2)) matcher->impl = LITERAL_SCAN_AVX2;
+  else if (cpu_supports(LITERAL_SCAN_SSSE3)) matcher->impl = LITERAL_SCAN_SSSE3;
+  else matcher->impl = LITERAL_SCAN_SCALAR;
+  matcher->compiled = TRUE;
+}
+
+// Check the literals of the candidate buckets at pos. Returns TRUE if func
+// asked to stop.
+static gboolean verify(const LiteralMatcher *matcher, const guchar *text, gsize len, gsize pos,
+                       guint buckets, PatternMatchFunc func, gpointer user_data) {
+  const Literal *literals = (const Literal *)(void *)matcher->literals->data;
+  const guchar *pool = (const guchar *)matcher->pool->str;
+
+  // The SIMD nibble masks over-approximate; narrow to the buckets whose
+  // fingerprint bytes really match before touching any literal
+  for (guint j = 0; j < matcher->fingerprint && buckets; j++) {
+    buckets &= pos + j < len ? matcher->byte_masks[j][text[pos + j]] : 0;
+  }
+
+  while (buckets) {
+    guint b = (guint)__builtin_ctz(buckets);
+    buckets &= buckets - 1;
+
+    for (guint32 m = matcher->bucket_start[b]; m < matcher->bucket_start[b + 1]; m++) {
+      const Literal *lit = &literals[matcher->members[m]];
+      if (lit->len > len - pos) continue;
+
+      const guchar *p = pool + lit->text;
+      guint32 k = 0;
+      while (k < lit->len && fold(text[pos + k]) == p[k]) k++;
+      if (k == lit->len && func(lit->id, pos + lit->len, user_data)) {
+        return TRUE;
+      }
+    }
+  }
+  return FALSE;
+}
+
+static gboolean scan_scalar(const LiteralMatcher *matcher, const guchar *text, gsize len,
+                            gsize start, PatternMatchFunc func, gpointer user_data) {
+  guint fp = matcher->fingerprint;
+  if (len < fp) return FALSE;
+
+  for (gsize i = start; i + fp <= len; i++) {
+    guint buckets = matcher->byte_masks[0][text[i]];
+    for (guint j = 1; j < fp && buckets; j++) {
+      buckets &= matcher->byte_masks[j][text[i + j]];
+    }
+    if (buckets && verify(matcher, text, len, i, buckets, func, user_data)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+#ifdef LITERAL_HAVE_X86
+__attribute__((target("ssse3")))
+static gboolean scan_ssse3(const LiteralMatcher *matcher, const guchar *text, gsize len,
+                           PatternMatchFunc func, gpointer user_data) {
+  guint fp = matcher->fingerprint;
+  const __m128i nibble = _mm_set1_epi8(0x0f);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i lo[FINGERPRINT_MAX], hi[FINGERPRINT_MAX];
+  for (guint j = 0; j < fp; j++) {
+    lo[j] = _mm_loadu_si128((const __m128i *)(const void *)matcher->lo_masks[j]);
+    hi[j] = _mm_loadu_si128((const __m128i *)(const void *)matcher->hi_masks[j]);
+  }
+
+  gsize i = 0;
+  for (; i + 16 + fp - 1 <= len; i += 16) {
+    __m128i candidates = _mm_set1_epi8(-1);
+    for (guint j = 0; j < fp; j++) {
+      __m128i in = _mm_loadu_si128((const __m128i *)(const void *)(text + i + j));
+      __m128i l = _mm_shuffle_epi8(lo[j], _mm_and_si128(in, nibble));
+      __m128i h = _mm_shuffle_epi8(hi[j], _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+      candidates = _mm_and_si128(candidates, _mm_and_si128(l, h));
+    }
+
+    guint hits = (guint)_mm_movemask_epi8(_mm_cmpeq_epi8(candidates, zero)) ^ 0xffffu;
+    if (!hits) continue;
+
+    guchar buckets[16];
+    _mm_storeu_si128((__m128i *)(void *)buckets, candidates);
+    while (hits) {
+      guint k = (guint)__builtin_ctz(hits);
+      hits &= hits - 1;
+      if (verify(matcher, text, len, i + k, buckets[k], func, user_data)) return TRUE;
+    }
+  }
+  return scan_scalar(matcher, text, len, i, func, user_data);
+}
+
+__attribute__((target("avx2")))
+static gboolean scan_avx2(const LiteralMatcher *matcher, const guchar *text, gsize len,
+                          PatternMatchFunc func, gpointer user_data) {
+  guint fp = matcher->fingerprint;
+  const __m256i nibble = _mm256_set1_epi8(0x0f);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i lo[FINGERPRINT_MAX], hi[FINGERPRINT_MAX];
+  for (guint j = 0; j < fp; j++) {
+    // VPSHUFB looks up within each 128-bit lane, so both lanes get the table
+    lo[j] = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(const void *)matcher->lo_masks[j]));
+    hi[j] = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)(const void *)matcher->hi_masks[j]));
+  }
+
+  gsize i = 0;
+  for (; i + 32 + fp - 1 <= len; i += 32) {
+    __m256i candidates = _mm256_set1_epi8(-1);
+    for (guint j = 0; j < fp; j++) {
+      __m256i in = _mm256_loadu_si256((const __m256i *)(const void *)(text + i + j));
+      __m256i l = _mm256_shuffle_epi8(lo[j], _mm256_and_si256(in, nibble));
+      __m256i h = _mm256_shuffle_epi8(hi[j], _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble));
+      candidates = _mm256_and_si256(candidates, _mm256_and_si256(l, h));
+    }
+
+    guint hits = ~(guint)_mm256_movemask_epi8(_mm256_cmpeq_epi8(candidates, zero));
+    if (!hits) continue;
+
+    guchar buckets[32];
+    _mm256_storeu_si256((__m256i *)(void *)buckets, candidates);
+    while (hits) {
+      guint k = (guint)__builtin_ctz(hits);
+      hits &= hits - 1;
+      if (verify(matcher, text, len, i + k, buckets[k], func, user_data)) return TRUE;
+    }
+  }
+  return scan_scalar(matcher, text, len, i, func, user_data);
+}
+#endif
+
+void literal_matcher_scan(const LiteralMatcher *matcher, const char *text, gsize len,
+                          PatternMatchFunc func, gpointer user_data) {
+  if (!matcher || !matcher->compiled || !text || !func || matcher->literals->len == 0) return;
+
+  const guchar *bytes = (const guchar *)text;
+  switch (matcher->impl) {
+#ifdef LITERAL_HAVE_X86
+    case LITERAL_SCAN_AVX2:
+      scan_avx2(matcher, bytes, len, func, user_data);
+      break;
+    case LITERAL_SCAN_SSSE3:
+      scan_ssse3(matcher, bytes, len, func, user_data);
+      break;
+#endif
+    default:
+      scan_scalar(matcher, bytes, len, 0, func, user_data);
+      break;
+  }
+}
+
+LiteralScanImpl literal_matcher_get_impl(const LiteralMatcher *matcher) {
+  return matcher ? matcher->impl : LITERAL_SCAN_SCALAR;
+}
+
+gboolean literal_matcher_set_impl(LiteralMatcher *matcher, LiteralScanImpl impl) {
+  if (!matcher || !cpu_supports(impl)) return FALSE;
+  matcher->impl = impl;
+  return TRUE;
+}
+
+const char* literal_scan_impl_name(LiteralScanImpl impl) {
+  switch (impl) {
+    case LITERAL_SCAN_AVX2: return "avx2";
+    case LITERAL_SCAN_SSSE3: return "ssse3";
+    default: return "scalar";
+  }
+}
+
+guint literal_matcher_get_count(const LiteralMatcher *matcher) {
+  return matcher ? matcher->literals->len : 0;
+}
+
+void literal_matcher_free(LiteralMatcher *matcher) {
+  if (!matcher) return;
+  g_array_free(matcher->literals, TRUE);
+  g_string_free(matcher->pool, TRUE);
+  g_free(matcher->members);
+  g_free(matcher);
+}
@@ -0,0 +1,47 @@
+#ifndef LITERAL_MATCHER_H
+#define LITERAL_MATCHER_H
+
+#include <glib.h>
+#include "pattern_match.h"
+
+// Case-insensitive search for a set of short literals, vectorized with the
+// Teddy technique: the first bytes of each literal are folded into nibble
+// masks of 8 buckets, PSHUFB finds candidate positions 16 or 32 bytes at a
+// time and only candidates are verified. The kernel is picked at runtime
+// from the CPU features, with a scalar fallback.
+typedef struct LiteralMatcher LiteralMatcher;
+
+// Scan kernels
+typedef enum {
+  LITERAL_SCAN_SCALAR = 0,
+  LITERAL_SCAN_SSSE3,
+  LITERAL_SCAN_AVX2
+} LiteralScanImpl;
+
+// Create an empty matcher
+LiteralMatcher* literal_matcher_new();
+
+// Add a literal (ASCII case is ignored). Must be called before compile.
+void literal_matcher_add(LiteralMatcher *matcher, const char *literal, guint32 id);
+
+// Build the bucket masks and select the fastest supported kernel
+void literal_matcher_compile(LiteralMatcher *matcher);
+
+// Scan text and report matches in order of their start offset; end passed
+// to func is the offset just past the match. Stops when func returns TRUE.
+void literal_matcher_scan(const LiteralMatcher *matcher, const char *text, gsize len,
+                          PatternMatchFunc func, gpointer user_data);
+
+// Kernel in use, and forcing a kernel (for benchmarks). set_impl returns
+// FALSE if the CPU lacks it.
+LiteralScanImpl literal_matcher_get_impl(const LiteralMatcher *matcher);
+gboolean literal_matcher_set_impl(LiteralMatcher *matcher, LiteralScanImpl impl);
+const char* literal_scan_impl_name(LiteralScanImpl impl);
+
+// Number of literals
+guint literal_matcher_get_count(const LiteralMatcher *matcher);
+
+// Free matcher
+void literal_matcher_free(LiteralMatcher *matcher);
+
+#endif // LITERAL_MATCHER_H
@@ -6,6 +6,14 @@
 #include <gtk/gtk.h>
 #include <webkit2/webkit2.h>
 
+// With VAXP_RULE_STATS or VAXP_PROFILE_RULES set, rule hit counters and
+// rule costs are written when the window closes, to find dead rules to
+// prune, hot ones to move to a fast layer and slow ones to rewrite
+static gboolean on_main_window_delete(GtkWidget *widget, GdkEvent *event, BrowserApp *app) {
+  adblocker_dump_rule_stats(app);
+  return FALSE;
+}
+
 int main(int argc, char *argv[]) {
   gtk_init(&argc, &argv);
 
@@ -39,6 +47,9 @@ int main(int argc, char *argv[]) {
   gtk_window_set_default_size(app->main_window, 1200, 720);
   gtk_window_set_title(app->main_window, BROWSER_NAME);
   g_signal_connect(app->main_window, "destroy", G_CALLBACK(gtk_main_quit), NULL);
+  if (g_getenv("VAXP_RULE_STATS") || g_getenv("VAXP_PROFILE_RULES")) {
+    g_signal_connect(app->main_window, "delete-event", G_CALLBACK(on_main_window_delete), app);
+  }
   g_signal_connect(app->main_window, "window-state-event", G_CALLBACK(on_window_state_changed), app);
 
   // Create main vertical box
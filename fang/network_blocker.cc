@@ -1,167 +1,534 @@
 #include "network_blocker.h"
 #include "tracker_domains.h"
 #include "adblockplus_integration.h"
+#include "url_patterns.h"
+#include "literal_matcher.h"
+#include "decision_cache.h"
+#include "url_parser.h"
+#include "rule_stats.h"
+#include "rule_profiler.h"
+#include "site_allowlist.h"
 #include <stdio.h>
 #include <string.h>
-#include <strings.h>
-
-// Enhanced URL patterns to block (EasyList/EasyPrivacy compatible)
-static const char *BLOCKED_URL_PATTERNS[] = {
-  // Analytics & Tracking
-  "/ads/",
-  "/ad/",
-  "/advert/",
-  "/advertising/",
-  "/tracker/",
-  "/tracking/",
-  "/analytics/",
-  "/pixel.",
-  "/beacon/",
-  "/collect?",
-  "/track?",
-  "/log?",
-  "/event?",
-  "/impression?",
-  "/telemetry/",
-  "/report?",
-  "/pageview?",
-  "/session?",
-  "/conversion?",
-  
-  // Google tracking
-  "googletagmanager",
-  "google-analytics",
-  "facebook.com/tr",
-  "doubleclick",
-  "googleadservices",
-  "imasdk.googleapis.com",
-  
-  // Script patterns
-  "/gtm.js",
-  "/ga.js",
-  "/analytics.js",
-  "/fbevents.js",
-  "/pixel.gif",
-  "/tracking.gif",
-  "/1x1.gif",
-  "/transparent.gif",
-  "/beacon.gif",
-  "/b.gif",
-  "/ct.gif",
-  "/count.gif",
-  
-  // CNAME cloaking detection
-  "cdn-js",
-  "analytics-js",
-  "cdn-analytics",
-  "tracking-cdn",
-  
-  // Common tracking parameters
-  "?utm_",
-  "&utm_",
-  "?fbclid=",
-  "&fbclid=",
-  "?gclid=",
-  "&gclid=",
-  "?msclkid=",
-  "&msclkid=",
-  
-  NULL
+
+// The URL and script pattern layers are compiled into one literal matcher so
+// each URL is scanned once, with the SIMD kernel the CPU supports. Pattern
+// ids carry the layer in the top byte and the rule index below. Tracker
+// domains are matched on the host through their suffix set and EasyList
+// through the AdblockPlus filter engine.
+static LiteralMatcher *block_matcher = NULL;
+
+// Verdicts for recently seen (URL, first-party host) pairs
+#define DECISION_CACHE_SIZE 4096
+static DecisionCache *decision_cache = NULL;
+
+#define RULE_ID(layer, index) (((guint32)(layer) << 24) | (guint32)(index))
+#define RULE_LAYER(id) ((BlockLayer)((id) >> 24))
+#define RULE_INDEX(id) ((gint)((id) & 0xffffff))
+
+static const char** get_layer_rules(BlockLayer layer) {
+  switch (layer) {
+    case BLOCK_LAYER_URL_PATTERN: return BLOCKED_URL_PATTERNS;
+    case BLOCK_LAYER_SCRIPT_PATTERN: return BLOCKED_SCRIPT_PATTERNS;
+    default: return NULL;
+  }
+}
+
+// Resource types each substring layer applies to. Navigations are left to
+// the domain and EasyList layers: blanket substrings like "/log?" and
+// "?utm_" used to block ordinary pages.
+static guint get_layer_types(BlockLayer layer) {
+  switch (layer) {
+    case BLOCK_LAYER_URL_PATTERN: return ABP_TYPE_ALL & ~(guint)ABP_TYPE_DOCUMENT;
+    case BLOCK_LAYER_SCRIPT_PATTERN: return ABP_TYPE_SCRIPT;
+    default: return ABP_TYPE_ALL;
+  }
+}
+
+static const struct {
+  const char *name;
+  guint type;
+} FETCH_DESTINATIONS[] = {
+  { "document", ABP_TYPE_DOCUMENT },
+  { "iframe", ABP_TYPE_SUBDOCUMENT },
+  { "frame", ABP_TYPE_SUBDOCUMENT },
+  { "image", ABP_TYPE_IMAGE },
+  { "script", ABP_TYPE_SCRIPT },
+  { "worker", ABP_TYPE_SCRIPT },
+  { "sharedworker", ABP_TYPE_SCRIPT },
+  { "serviceworker", ABP_TYPE_SCRIPT },
+  { "style", ABP_TYPE_STYLESHEET },
+  { "font", ABP_TYPE_FONT },
+  { "audio", ABP_TYPE_MEDIA },
+  { "video", ABP_TYPE_MEDIA },
+  { "track", ABP_TYPE_MEDIA },
+  { "object", ABP_TYPE_OBJECT },
+  { "embed", ABP_TYPE_OBJECT },
+  { "report", ABP_TYPE_PING },
+  { "empty", ABP_TYPE_XMLHTTPREQUEST },
+  { NULL, 0 }
 };
 
-// Enhanced script patterns to block
-static const char *BLOCKED_SCRIPT_PATTERNS[] = {
-  "ads.js",
-  "ad.js",
-  "advertising.js",
-  "tracker.js",
-  "tracking.js",
-  "analytics.js",
-  "ga.js",
-  "gtm.js",
-  "fbevents.js",
-  "pixel.js",
-  "beacon.js",
-  "event.js",
-  "collect.js",
-  "event-logger.js",
-  "user-track.js",
-  "tracking-pixel.js",
-  "analytics-pixel.js",
-  "monitor.js",
-  "report.js",
-  "telemetry.js",
-  NULL
+// File extensions that give away the type of a request made without one
+static const struct {
+  const char *extension;
+  guint type;
+} EXTENSION_TYPES[] = {
+  { "js", ABP_TYPE_SCRIPT },
+  { "mjs", ABP_TYPE_SCRIPT },
+  { "css", ABP_TYPE_STYLESHEET },
+  { "png", ABP_TYPE_IMAGE },
+  { "jpg", ABP_TYPE_IMAGE },
+  { "jpeg", ABP_TYPE_IMAGE },
+  { "gif", ABP_TYPE_IMAGE },
+  { "webp", ABP_TYPE_IMAGE },
+  { "avif", ABP_TYPE_IMAGE },
+  { "svg", ABP_TYPE_IMAGE },
+  { "ico", ABP_TYPE_IMAGE },
+  { "woff", ABP_TYPE_FONT },
+  { "woff2", ABP_TYPE_FONT },
+  { "ttf", ABP_TYPE_FONT },
+  { "otf", ABP_TYPE_FONT },
+  { "mp4", ABP_TYPE_MEDIA },
+  { "webm", ABP_TYPE_MEDIA },
+  { "mp3", ABP_TYPE_MEDIA },
+  { "m3u8", ABP_TYPE_MEDIA },
+  { NULL, 0 }
 };
 
-void network_blocker_init(BrowserApp *app) {
-  if (!app) return;
+guint network_blocker_type_from_destination(const char *destination) {
+  if (!destination) return 0;
+  for (int i = 0; FETCH_DESTINATIONS[i].name != NULL; i++) {
+    if (g_ascii_strcasecmp(destination, FETCH_DESTINATIONS[i].name) == 0) {
+      return FETCH_DESTINATIONS[i].type;
+    }
+  }
+  return ABP_TYPE_OTHER;
+}
+
+static guint guess_request_type(const ParsedUrl *url) {
+  for (int i = 0; EXTENSION_TYPES[i].extension != NULL; i++) {
+    if (url_span_equals(url, url->extension, EXTENSION_TYPES[i].extension)) {
+      return EXTENSION_TYPES[i].type;
+    }
+  }
+  return ABP_TYPE_OTHER;
+}
+
+static void build_block_matcher() {
+  if (block_matcher) return;
+
+  block_matcher = literal_matcher_new();
+  for (int layer = BLOCK_LAYER_URL_PATTERN; layer <= BLOCK_LAYER_SCRIPT_PATTERN; layer++) {
+    const char **rules = get_layer_rules((BlockLayer)layer);
+    for (int i = 0; rules && rules[i] != NULL; i++) {
+      literal_matcher_add(block_matcher, rules[i], RULE_ID(layer, i));
+    }
+  }
+  literal_matcher_compile(block_matcher);
+}
+
+void network_blocker_init() {
+  rule_profiler_init();
+  build_block_matcher();
   
-  // Initialize blocked requests counter
-  app->blocked_requests_count = 0;
+  // Optional large blocklist (hosts file or plain domains)
+  char list_path[2048];
+  snprintf(list_path, sizeof(list_path), "%s/.local/share/vaxp-browser/adblock/tracker_domains.txt",
+           g_get_home_dir());
+  int count = tracker_domains_load_cached(list_path);
   
-  g_print("Network Blocker: Initialized with %d tracker domains\n", TRACKER_DOMAINS_COUNT);
+  g_print("Network Blocker: Initialized with %d tracker domains\n", count);
+  network_blocker_invalidate_cache();
+  g_print("Network Blocker: Compiled %u patterns (%s kernel)\n",
+          literal_matcher_get_count(block_matcher),
+          literal_scan_impl_name(literal_matcher_get_impl(block_matcher)));
   g_print("Network Blocker: Ready to intercept requests\n");
 }
 
-gboolean should_block_request(const char *uri) {
-  if (!uri) return FALSE;
+// Pattern scan state. Hits of layers that do not apply to the request
+// type are skipped.
+typedef struct {
+  guint32 best;
+  guint type;
+} PatternScan;
+
+// Keep the hit from the earliest layer; a URL pattern hit cannot be beaten
+// so the scan stops there.
+static gboolean keep_best_match(guint32 id, gsize, gpointer user_data) {
+  PatternScan *scan = (PatternScan *)user_data;
+  if (!(get_layer_types(RULE_LAYER(id)) & scan->type)) {
+    return FALSE;
+  }
+  if (id < scan->best) {
+    scan->best = id;
+  }
+  return RULE_LAYER(scan->best) == BLOCK_LAYER_URL_PATTERN;
+}
+
+// An @@ filter of the lists overrides the built-in layers as well
+static gboolean has_exception(const ParsedUrl *url, const ParsedUrl *document, guint type,
+                              gint third_party, const AbpEngine *engine) {
+  AbpRequest request = { url, document, type, third_party };
+  return abp_engine_match_exception(engine, &request, NULL);
+}
+
+// Layer 1: host lookup in the tracker domain suffix set
+static gboolean match_tracker_layer(const ParsedUrl *url, BlockMatch *match) {
+  const char *domain = tracker_domain_match(url);
+  if (!domain) return FALSE;
+  if (match) {
+    match->layer = BLOCK_LAYER_TRACKER_DOMAIN;
+    match->rule_index = -1;
+    match->rule = domain;
+  }
+  return TRUE;
+}
+
+// Layers 2-3: one pass over the URL covers URL and script patterns
+static gboolean match_pattern_layers(const ParsedUrl *url, guint type, BlockMatch *match) {
+  build_block_matcher();
+  
+  PatternScan scan;
+  scan.best = G_MAXUINT32;
+  scan.type = type;
+  if (type & (get_layer_types(BLOCK_LAYER_URL_PATTERN) | get_layer_types(BLOCK_LAYER_SCRIPT_PATTERN))) {
+    literal_matcher_scan(block_matcher, url->url, url->len, keep_best_match, &scan);
+  }
+  if (scan.best == G_MAXUINT32) return FALSE;
+  if (match) {
+    match->layer = RULE_LAYER(scan.best);
+    match->rule_index = RULE_INDEX(scan.best);
+    match->rule = get_layer_rules(match->layer)[match->rule_index];
+  }
+  return TRUE;
+}
+
+// Layer 4: AdblockPlus filter engine (EasyList/EasyPrivacy)
+static gboolean match_easylist_layer(const ParsedUrl *url, const ParsedUrl *document, guint type,
+                                     gint third_party, const AbpEngine *engine, BlockMatch *match) {
+  AbpRequest request = { url, document, type, third_party };
+  AbpMatch abp_match;
+  if (!abp_engine_match(engine, &request, &abp_match)) return FALSE;
+  if (match) {
+    match->layer = BLOCK_LAYER_EASYLIST;
+    match->rule_index = (gint)abp_match.filter_id;
+    match->rule = abp_match.text;
+  }
+  return TRUE;
+}
+
+// Run the blocking layers for a parsed request of the given type. document
+// may be NULL. EasyList blocks and @@ exceptions all come from engine, so a
+// reload landing meanwhile cannot mix two generations of the lists.
+static gboolean match_layers(const ParsedUrl *url, const ParsedUrl *document, guint type,
+                             gint third_party, const AbpEngine *engine, BlockMatch *match) {
+  // The substring layers run as one scan, so in profiling mode they are
+  // timed per pass; EasyList filters are timed one by one in the engine
+  gboolean profiling = rule_profiler_enabled();
+  guint64 start = profiling ? rule_profiler_now() : 0;
   
-  // Layer 1: Check against tracker domains
-  if (is_tracker_domain(uri)) {
-    return TRUE;
+  gboolean blocked = match_tracker_layer(url, match);
+  if (profiling) {
+    rule_profiler_record_rule(block_layer_name(BLOCK_LAYER_TRACKER_DOMAIN), "(suffix set lookup)", start);
   }
+  if (blocked) return !has_exception(url, document, type, third_party, engine);
   
-  // Layer 2: Check against URL patterns
-  for (int i = 0; BLOCKED_URL_PATTERNS[i] != NULL; i++) {
-    if (strcasestr(uri, BLOCKED_URL_PATTERNS[i]) != NULL) {
-      return TRUE;
-    }
+  if (profiling) start = rule_profiler_now();
+  blocked = match_pattern_layers(url, type, match);
+  if (profiling && (type & (get_layer_types(BLOCK_LAYER_URL_PATTERN) |
+                            get_layer_types(BLOCK_LAYER_SCRIPT_PATTERN)))) {
+    rule_profiler_record_rule(block_layer_name(BLOCK_LAYER_URL_PATTERN), "(literal scan)", start);
   }
+  if (blocked) return !has_exception(url, document, type, third_party, engine);
   
-  // Layer 3: Check if it's a script with blocked pattern
-  if (strstr(uri, ".js")) {
-    for (int i = 0; BLOCKED_SCRIPT_PATTERNS[i] != NULL; i++) {
-      if (strcasestr(uri, BLOCKED_SCRIPT_PATTERNS[i]) != NULL) {
-        return TRUE;
-      }
+  return match_easylist_layer(url, document, type, third_party, engine, match);
+}
+
+gboolean network_blocker_match_layer(BlockLayer layer, const ParsedUrl *url, guint type,
+                                     BlockMatch *match) {
+  if (!url) return FALSE;
+  if (!type) type = guess_request_type(url);
+  switch (layer) {
+    case BLOCK_LAYER_TRACKER_DOMAIN:
+      return match_tracker_layer(url, match);
+    case BLOCK_LAYER_URL_PATTERN:
+    case BLOCK_LAYER_SCRIPT_PATTERN:
+      return match_pattern_layers(url, type, match);
+    case BLOCK_LAYER_EASYLIST: {
+      AbpEngine *engine = adblockplus_acquire_engine();
+      gboolean blocked = match_easylist_layer(url, NULL, type, -1, engine, match);
+      abp_engine_unref(engine);
+      return blocked;
     }
+    default:
+      return FALSE;
   }
+}
+
+// Decide a request without the cache and count a block. Only reads shared
+// state, so batch workers run it concurrently.
+static void decide_request(const RequestContext *context, const ParsedUrl *document,
+                           const AbpEngine *engine, CachedDecision *decision) {
+  guint64 start = rule_profiler_enabled() ? rule_profiler_now() : 0;
   
-  // Layer 4: Check against AdblockPlus EasyList/EasyPrivacy rules
-  if (adblockplus_should_block_url(uri)) {
-    return TRUE;
+  // The URL is parsed once and every layer works on its fields
+  ParsedUrl url;
+  url_parser_parse(&url, context->uri);
+  guint type = context->type ? context->type : guess_request_type(&url);
+  BlockMatch found = { BLOCK_LAYER_NONE, -1, NULL };
+  decision->blocked = match_layers(&url, document, type, context->third_party, engine, &found);
+  decision->layer = found.layer;
+  decision->rule_index = found.rule_index;
+  decision->rule = found.rule;
+  decision->rule_key = decision->domain_key = 0;
+  if (decision->blocked) {
+    // Counters are keyed once here; cached verdicts reuse the keys
+    decision->rule_key = rule_stats_key(found.layer, found.rule, strlen(found.rule));
+    decision->domain_key = rule_stats_key(0, url_span_lower(&url, url.domain), url.domain.len);
+    rule_stats_record_rule(decision->rule_key, found.layer, found.rule);
+    rule_stats_record_domain(decision->domain_key, url_span_lower(&url, url.domain), url.domain.len);
   }
+  url_parser_clear(&url);
+  if (start) rule_profiler_record_url(context->uri, start);
+}
+
+// Allowlisted sites skip every layer. A navigation is judged by the page it
+// loads, a subresource by the page that requested it.
+static gboolean is_site_allowlisted(const RequestContext *context, const ParsedUrl *document) {
+  if (site_allowlist_get_count() == 0) return FALSE;
+  if (context->type != ABP_TYPE_DOCUMENT) return site_allowlist_contains(document);
   
-  return FALSE;
+  ParsedUrl url;
+  gboolean allowed = url_parser_parse(&url, context->uri) && site_allowlist_contains(&url);
+  url_parser_clear(&url);
+  return allowed;
 }
 
-gboolean on_send_request(WebKitWebView *web_view, WebKitURIRequest *request,
-                         WebKitURIResponse *redirected_response, gpointer user_data) {
-  BrowserApp *app = (BrowserApp *)user_data;
-  if (!app || !request) return FALSE;
+gboolean should_block_request_context(const RequestContext *context, BlockMatch *match) {
+  if (!context || !context->uri) return FALSE;
+  const char *uri = context->uri;
+  const char *first_party = context->first_party;
+  
+  ParsedUrl document;
+  gboolean has_document = first_party && url_parser_parse(&document, first_party);
+  
+  // Checked ahead of the cache, which therefore never holds verdicts for
+  // allowlisted sites and stays valid when a site is toggled
+  if (is_site_allowlisted(context, has_document ? &document : NULL)) {
+    if (first_party) url_parser_clear(&document);
+    return FALSE;
+  }
+  
+  if (!decision_cache) {
+    decision_cache = decision_cache_new(DECISION_CACHE_SIZE);
+  }
   
-  const char *uri = webkit_uri_request_get_uri(request);
-  if (!uri) return FALSE;
+  // Type and party are packed into the key: the same URL can be blocked as
+  // a script and allowed as a navigation
+  guint32 packed = context->type | ((guint32)(context->third_party + 1) << 16);
+  guint64 key = decision_cache_key(uri, strlen(uri),
+                                   has_document ? url_span_lower(&document, document.host) : NULL,
+                                   has_document ? document.host.len : 0, packed);
+  CachedDecision decision;
+  if (!decision_cache_lookup(decision_cache, key, &decision)) {
+    // One engine reference for the whole decision
+    AbpEngine *engine = adblockplus_acquire_engine();
+    decide_request(context, has_document ? &document : NULL, engine, &decision);
+    abp_engine_unref(engine);
+    decision_cache_insert(decision_cache, key, &decision);
+  } else if (decision.blocked) {
+    rule_stats_record_rule(decision.rule_key, decision.layer, NULL);
+    rule_stats_record_domain(decision.domain_key, NULL, 0);
+  }
+  if (first_party) url_parser_clear(&document);
   
-  // Check if request should be blocked
-  if (should_block_request(uri)) {
-    // Increment blocked counter
-    app->blocked_requests_count++;
+  if (decision.blocked && match) {
+    match->layer = (BlockLayer)decision.layer;
+    match->rule_index = decision.rule_index;
+    match->rule = decision.rule;
+  }
+  return decision.blocked;
+}
+
+gboolean should_block_request_from(const char *uri, const char *first_party, BlockMatch *match) {
+  RequestContext context = { uri, first_party, 0, -1 };
+  return should_block_request_context(&context, match);
+}
+
+gboolean should_block_request_match(const char *uri, BlockMatch *match) {
+  return should_block_request_from(uri, NULL, match);
+}
+
+gboolean should_block_request(const char *uri) {
+  return should_block_request_from(uri, NULL, NULL);
+}
+
+// Batch shared by the workers: each claims the next chunk of requests
+#define BATCH_CHUNK 64
+
+typedef struct {
+  const RequestContext *contexts;
+  BlockVerdict *verdicts;
+  guint count;
+  const AbpEngine *engine;
+  gint next;
+} RequestBatch;
+
+static void decide_batch(RequestBatch *batch) {
+  for (;;) {
+    guint begin = (guint)g_atomic_int_add(&batch->next, BATCH_CHUNK);
+    if (begin >= batch->count) return;
+    guint end = MIN(begin + BATCH_CHUNK, batch->count);
     
-    // Log blocked request (can be disabled for performance)
-    if (app->blocked_requests_count % 100 == 0) {
-      g_print("Network Blocker: Blocked %lu requests\n", app->blocked_requests_count);
+    for (guint i = begin; i < end; i++) {
+      const RequestContext *context = &batch->contexts[i];
+      BlockVerdict *verdict = &batch->verdicts[i];
+      verdict->blocked = FALSE;
+      verdict->match.layer = BLOCK_LAYER_NONE;
+      verdict->match.rule_index = -1;
+      verdict->match.rule = NULL;
+      if (!context->uri) continue;
+      
+      ParsedUrl document;
+      gboolean has_document = context->first_party && url_parser_parse(&document, context->first_party);
+      CachedDecision decision;
+      decision.blocked = FALSE;
+      if (!is_site_allowlisted(context, has_document ? &document : NULL)) {
+        decide_request(context, has_document ? &document : NULL, batch->engine, &decision);
+      }
+      if (has_document) url_parser_clear(&document);
+      
+      verdict->blocked = decision.blocked;
+      if (decision.blocked) {
+        verdict->match.layer = (BlockLayer)decision.layer;
+        verdict->match.rule_index = decision.rule_index;
+        verdict->match.rule = decision.rule;
+      }
     }
-    
-    // Return TRUE to block the request
-    return TRUE;
   }
+}
+
+static void run_batch_worker(gpointer, gpointer user_data) {
+  decide_batch((RequestBatch *)user_data);
+}
+
+void should_block_requests(const AbpEngine *engine, const RequestContext *contexts,
+                           BlockVerdict *verdicts, guint count, guint n_threads) {
+  if (!engine || !contexts || !verdicts || count == 0) return;
+  
+  // Lazily built tables are built here, before any worker reads them
+  build_block_matcher();
+  tracker_domains_get_count();
+  
+  RequestBatch batch;
+  batch.contexts = contexts;
+  batch.verdicts = verdicts;
+  batch.count = count;
+  batch.engine = engine;
+  batch.next = 0;
+  
+  if (n_threads == 0) n_threads = g_get_num_processors();
+  n_threads = MIN(n_threads, (count + BATCH_CHUNK - 1) / BATCH_CHUNK);
+  if (n_threads <= 1) {
+    decide_batch(&batch);
+  } else {
+    GThreadPool *pool = g_thread_pool_new(run_batch_worker, &batch, (gint)n_threads, TRUE, NULL);
+    for (guint i = 0; i < n_threads; i++) {
+      g_thread_pool_push(pool, GUINT_TO_POINTER(i + 1), NULL);
+    }
+    g_thread_pool_free(pool, FALSE, TRUE);
+  }
+}
+
+void network_blocker_invalidate_cache() {
+  decision_cache_clear(decision_cache);
+}
+
+void network_blocker_log_cache_stats() {
+  DecisionCacheStats stats;
+  decision_cache_get_stats(decision_cache, &stats);
+  guint64 lookups = stats.hits + stats.misses;
+  g_print("Network Blocker: Decision cache %lu hits, %lu misses (%.1f%% hit rate), "
+          "%u/%u entries, %lu evictions\n",
+          stats.hits, stats.misses, lookups ? 100.0 * stats.hits / lookups : 0.0,
+          stats.size, stats.capacity, stats.evictions);
+}
+
+// Dump helpers: one TSV line per rule
+static void write_rule(GString *out, BlockLayer layer, const char *rule) {
+  guint64 hits = rule_stats_get_hits(rule_stats_key(layer, rule, strlen(rule)));
+  g_string_append_printf(out, "%lu\t%s\t%s\n", hits, block_layer_name(layer), rule);
+}
+
+static void write_filter(const char *text, gpointer user_data) {
+  write_rule((GString *)user_data, BLOCK_LAYER_EASYLIST, text);
+}
+
+gboolean network_blocker_dump_stats(const char *path) {
+  GString *out = g_string_new("# hits\tlayer\trule\n");
+  
+  // Every rule of the fixed layers, so rules that never hit show up as 0
+  for (int layer = BLOCK_LAYER_URL_PATTERN; layer <= BLOCK_LAYER_SCRIPT_PATTERN; layer++) {
+    const char **rules = get_layer_rules((BlockLayer)layer);
+    for (int i = 0; rules[i] != NULL; i++) {
+      write_rule(out, (BlockLayer)layer, rules[i]);
+    }
+  }
+  adblockplus_foreach_filter(write_filter, out);
+  
+  // The domain set is only listed through the entries that hit
+  GArray *rules = rule_stats_get_rules();
+  for (guint i = 0; i < rules->len; i++) {
+    const RuleHits *entry = &g_array_index(rules, RuleHits, i);
+    if (entry->layer != BLOCK_LAYER_TRACKER_DOMAIN) continue;
+    g_string_append_printf(out, "%lu\t%s\t%s\n", entry->hits,
+                           block_layer_name(BLOCK_LAYER_TRACKER_DOMAIN), entry->name);
+  }
+  g_array_unref(rules);
   
-  // Allow request
-  return FALSE;
+  g_string_append(out, "# hits\tblocked domain\n");
+  GArray *domains = rule_stats_get_domains();
+  for (guint i = 0; i < domains->len; i++) {
+    const RuleHits *entry = &g_array_index(domains, RuleHits, i);
+    g_string_append_printf(out, "%lu\t%s\n", entry->hits, entry->name);
+  }
+  g_array_unref(domains);
+  
+  gboolean ok = g_file_set_contents(path, out->str, out->len, NULL);
+  g_string_free(out, TRUE);
+  if (ok) g_print("Network Blocker: Wrote rule statistics to %s\n", path);
+  return ok;
 }
 
-guint64 get_blocked_requests_count(BrowserApp *app) {
-  return app ? app->blocked_requests_count : 0;
+void network_blocker_log_top_rules(guint count) {
+  GArray *rules = rule_stats_get_rules();
+  g_print("Network Blocker: Top %u of %u rules hit\n", MIN(count, rules->len), rules->len);
+  for (guint i = 0; i < rules->len && i < count; i++) {
+    const RuleHits *entry = &g_array_index(rules, RuleHits, i);
+    g_print("  %8lu  %-15s %s\n", entry->hits, block_layer_name((BlockLayer)entry->layer),
+            entry->name);
+  }
+  g_array_unref(rules);
+  
+  GArray *domains = rule_stats_get_domains();
+  g_print("Network Blocker: Top %u of %u blocked domains\n", MIN(count, domains->len), domains->len);
+  for (guint i = 0; i < domains->len && i < count; i++) {
+    const RuleHits *entry = &g_array_index(domains, RuleHits, i);
+    g_print("  %8lu  %s\n", entry->hits, entry->name);
+  }
+  g_array_unref(domains);
+  
+  guint64 dropped = rule_stats_get_dropped();
+  if (dropped > 0) g_print("Network Blocker: %lu hits not counted, tables full\n", dropped);
+}
+
+const char* block_layer_name(BlockLayer layer) {
+  switch (layer) {
+    case BLOCK_LAYER_TRACKER_DOMAIN: return "tracker-domain";
+    case BLOCK_LAYER_URL_PATTERN: return "url-pattern";
+    case BLOCK_LAYER_SCRIPT_PATTERN: return "script-pattern";
+    case BLOCK_LAYER_EASYLIST: return "easylist";
+    default: return "none";
+  }
 }
@@ -1,20 +1,98 @@
 #ifndef NETWORK_BLOCKER_H
 #define NETWORK_BLOCKER_H
 
-#include "types.h"
-#include <webkit2/webkit2.h>
+#include <glib.h>
+#include "abp_engine.h"
 
-// Initialize network-level blocking
-void network_blocker_init(BrowserApp *app);
+// Blocker core shared by the browser and the web process extension. It only
+// depends on glib so the extension can link it without GTK.
 
-// Request interception callback
-gboolean on_send_request(WebKitWebView *web_view, WebKitURIRequest *request,
-                         WebKitURIResponse *redirected_response, gpointer user_data);
+// Initialize network-level blocking: pattern layers and tracker domains.
+// EasyList is loaded separately by adblockplus_init.
+void network_blocker_init();
+
+// Blocking layers, in the order they take precedence
+typedef enum {
+  BLOCK_LAYER_NONE = 0,
+  BLOCK_LAYER_TRACKER_DOMAIN,
+  BLOCK_LAYER_URL_PATTERN,
+  BLOCK_LAYER_SCRIPT_PATTERN,
+  BLOCK_LAYER_EASYLIST
+} BlockLayer;
+
+// Which layer and rule caused a request to be blocked
+typedef struct {
+  BlockLayer layer;
+  gint rule_index;    // index into the layer's rule table, -1 for domains
+  const char *rule;   // rule text, valid until the filters are reloaded
+} BlockMatch;
+
+// Request being checked and where it comes from
+typedef struct {
+  const char *uri;
+  const char *first_party;    // URL of the page making the request, NULL if unknown
+  guint type;                 // AbpResourceType, 0 to guess from the URL
+  gint third_party;           // 1 or 0, -1 to derive from first_party
+} RequestContext;
+
+// Check a request in its context. Requests on allowlisted sites are never
+// blocked, and @@ filters of the lists override every layer. Each layer only
+// evaluates the rules for the request's resource type and party:
+// navigations skip the substring layers and script rules only see scripts.
+// Verdicts are cached per URL, first-party host and context.
+gboolean should_block_request_context(const RequestContext *context, BlockMatch *match);
+
+// Verdict for one request of a batch
+typedef struct {
+  gboolean blocked;
+  BlockMatch match;           // layer BLOCK_LAYER_NONE when allowed
+} BlockVerdict;
+
+// Check count requests on n_threads threads (0 for one per CPU) and store
+// their verdicts in order. EasyList is matched against engine, taken with
+// adblockplus_acquire_engine, so every request sees the same filters even if
+// a reload lands meanwhile, and the rule text of the verdicts stays valid
+// until the caller releases engine. Bypasses the decision cache, so it can
+// run from any thread, e.g. to replay crawl logs offline.
+void should_block_requests(const AbpEngine *engine, const RequestContext *contexts,
+                           BlockVerdict *verdicts, guint count, guint n_threads);
+
+// Run one layer on its own for a parsed URL of the given type (0 to guess
+// from the URL): no allowlist, @@ exceptions or cache, and EasyList without
+// a first party. The URL and script pattern layers are one scan, which
+// either of them selects. For benchmarks and diagnostics.
+gboolean network_blocker_match_layer(BlockLayer layer, const ParsedUrl *url, guint type,
+                                     BlockMatch *match);
+
+// Resource type for a Sec-Fetch-Dest header value ("image", "script", ...).
+// Returns 0 for NULL and ABP_TYPE_OTHER for unlisted values.
+guint network_blocker_type_from_destination(const char *destination);
 
 // Check if request should be blocked
 gboolean should_block_request(const char *uri);
 
-// Get blocking statistics
-guint64 get_blocked_requests_count(BrowserApp *app);
+// Same as should_block_request, also reporting the matching layer and rule
+gboolean should_block_request_match(const char *uri, BlockMatch *match);
+
+// Same as should_block_request_match for a request made by the page at
+// first_party (its URL, or NULL if unknown), with an unknown resource type
+gboolean should_block_request_from(const char *uri, const char *first_party, BlockMatch *match);
+
+// Drop cached verdicts; call whenever filter lists change. The site
+// allowlist is checked ahead of the cache and needs no invalidation.
+void network_blocker_invalidate_cache();
+
+// Print decision cache hit/miss counters
+void network_blocker_log_cache_stats();
+
+// Write every rule with its hit count, never-hit rules of the pattern and
+// EasyList layers included, then the blocked domains, as TSV to path
+gboolean network_blocker_dump_stats(const char *path);
+
+// Print the most hit rules and blocked domains
+void network_blocker_log_top_rules(guint count);
+
+// Human-readable layer name
+const char* block_layer_name(BlockLayer layer);
 
 #endif // NETWORK_BLOCKER_H
@@ -0,0 +1,13 @@
+#ifndef PATTERN_MATCH_H
+#define PATTERN_MATCH_H
+
+#include <glib.h>
+
+// Match callback shared by the multi-pattern scanners (literal matcher,
+// lazy DFA and the Aho-Corasick automaton of the pattern benchmark).
+
+// Called for every pattern occurrence; end is the offset just past the match.
+// Return TRUE to stop scanning.
+typedef gboolean (*PatternMatchFunc)(guint32 id, gsize end, gpointer user_data);
+
+#endif // PATTERN_MATCH_H
@@ -0,0 +1,209 @@
+#include "pattern_matcher.h"
+#include <string.h>
+
+// One pattern id attached to an accepting state. Several patterns can end
+// in the same state (duplicates across lists), so entries form a chain.
+typedef struct {
+  guint32 id;
+  gint32 next;
+} PatternEntry;
+
+struct PatternMatcher {
+  // Pending patterns (lowercased) until compile
+  GPtrArray *pending;
+  GArray *pending_ids;
+
+  // Input bytes are mapped to a compact alphabet; class 0 is "any byte that
+  // never occurs in a pattern" and always leads back to the root.
+  guint16 classes[256];
+  guint n_classes;
+
+  // Full DFA transition table: delta[state * n_classes + class]
+  guint32 *delta;
+  guint n_states;
+
+  // report[s]: first state on the suffix chain of s (s included) that ends a
+  // pattern, or -1. dict_link[s]: the next such state after s, or -1.
+  gint32 *report;
+  gint32 *dict_link;
+  gint32 *output;  // first PatternEntry ending exactly at the state
+  GArray *entries;
+
+  guint pattern_count;
+  gboolean compiled;
+};
+
+PatternMatcher* pattern_matcher_new() {
+  PatternMatcher *matcher = g_new0(PatternMatcher, 1);
+  matcher->pending = g_ptr_array_new_with_free_func(g_free);
+  matcher->pending_ids = g_array_new(FALSE, FALSE, sizeof(guint32));
+  matcher->entries = g_array_new(FALSE, FALSE, sizeof(PatternEntry));
+  return matcher;
+}
+
+void pattern_matcher_add(PatternMatcher *matcher, const char *pattern, guint32 id) {
+  if (!matcher || matcher->compiled || !pattern || !pattern[0]) return;
+
+  g_ptr_array_add(matcher->pending, g_ascii_strdown(pattern, -1));
+  g_array_append_val(matcher->pending_ids, id);
+}
+
+void pattern_matcher_compile(PatternMatcher *matcher) {
+  if (!matcher || matcher->compiled) return;
+
+  // Assign alphabet classes to every byte used by a pattern
+  guint n_classes = 1;
+  guint max_states = 1;
+  for (guint i = 0; i < matcher->pending->len; i++) {
+    const guchar *p = (const guchar *)g_ptr_array_index(matcher->pending, i);
+    for (; *p; p++) {
+      if (matcher->classes[*p] == 0) {
+        matcher->classes[*p] = (guint16)n_classes++;
+      }
+      max_states++;
+    }
+  }
+  // Uppercase input folds onto the lowercase class
+  for (guint c = 'A'; c <= 'Z'; c++) {
+    matcher->classes[c] = matcher->classes[c + ('a' - 'A')];
+  }
+  matcher->n_classes = n_classes;
+
+  // Build the trie. Edge value 0 means "no edge" while building since no
+  // trie edge can point back at the root.
+  guint32 *delta = g_new0(guint32, (gsize)max_states * n_classes);
+  gint32 *output = g_new(gint32, max_states);
+  output[0] = -1;
+  guint n_states = 1;
+
+  for (guint i = 0; i < matcher->pending->len; i++) {
+    const guchar *p = (const guchar *)g_ptr_array_index(matcher->pending, i);
+    guint32 state = 0;
+    for (; *p; p++) {
+      guint32 *edge = &delta[(gsize)state * n_classes + matcher->classes[*p]];
+      if (*edge == 0) {
+        output[n_states] = -1;
+        *edge = n_states++;
+      }
+      state = *edge;
+    }
+
+    PatternEntry entry;
+    entry.id = g_array_index(matcher->pending_ids, guint32, i);
+    entry.next = output[state];
+    g_array_append_val(matcher->entries, entry);
+    output[state] = (gint32)(matcher->entries->len - 1);
+  }
+
+  // Breadth-first pass: compute failure links and turn the trie into a full
+  // DFA so scanning never has to follow failure links.
+  guint32 *fail = g_new0(guint32, n_states);
+  guint32 *queue = g_new(guint32, n_states);
+  gint32 *report = g_new(gint32, n_states);
+  gint32 *dict_link = g_new(gint32, n_states);
+  guint head = 0, tail = 0;
+
+  report[0] = -1;
+  dict_link[0] = -1;
+  for (guint c = 1; c < n_classes; c++) {
+    guint32 s = delta[c];
+    if (s != 0) {
+      fail[s] = 0;
+      dict_link[s] = -1;
+      report[s] = output[s] >= 0 ? (gint32)s : -1;
+      queue[tail++] = s;
+    }
+  }
+
+  while (head < tail) {
+    guint32 r = queue[head++];
+    guint32 *row = &delta[(gsize)r * n_classes];
+    const guint32 *fail_row = &delta[(gsize)fail[r] * n_classes];
+
+    for (guint c = 1; c < n_classes; c++) {
+      guint32 s = row[c];
+      if (s != 0) {
+        guint32 f = fail_row[c];
+        fail[s] = f;
+        dict_link[s] = report[f];
+        report[s] = output[s] >= 0 ? (gint32)s : report[f];
+        queue[tail++] = s;
+      } else {
+        row[c] = fail_row[c];
+      }
+    }
+  }
+
+  g_free(fail);
+  g_free(queue);
+
+  matcher->delta = g_renew(guint32, delta, (gsize)n_states * n_classes);
+  matcher->output = output;
+  matcher->report = report;
+  matcher->dict_link = dict_link;
+  matcher->n_states = n_states;
+  matcher->pattern_count = matcher->pending->len;
+  matcher->compiled = TRUE;
+
+  g_ptr_array_free(matcher->pending, TRUE);
+  g_array_free(matcher->pending_ids, TRUE);
+  matcher->pending = NULL;
+  matcher->pending_ids = NULL;
+}
+
+void pattern_matcher_scan(const PatternMatcher *matcher, const char *text, gsize len,
+                          PatternMatchFunc func, gpointer user_data) {
+  if (!matcher || !matcher->compiled || !text || !func) return;
+
+  const guint32 *delta = matcher->delta;
+  const guint n_classes = matcher->n_classes;
+  const PatternEntry *entries = (const PatternEntry *)(void *)matcher->entries->data;
+  guint32 state = 0;
+
+  for (gsize i = 0; i < len; i++) {
+    state = delta[(gsize)state * n_classes + matcher->classes[(guchar)text[i]]];
+
+    for (gint32 t = matcher->report[state]; t >= 0; t = matcher->dict_link[t]) {
+      for (gint32 e = matcher->output[t]; e >= 0; e = entries[e].next) {
+        if (func(entries[e].id, i + 1, user_data)) {
+          return;
+        }
+      }
+    }
+  }
+}
+
+static gboolean find_first_cb(guint32 id, gsize, gpointer user_data) {
+  *(guint32 *)user_data = id;
+  return TRUE;
+}
+
+gboolean pattern_matcher_find_first(const PatternMatcher *matcher, const char *text, gsize len,
+                                    guint32 *id) {
+  guint32 found = G_MAXUINT32;
+  pattern_matcher_scan(matcher, text, len, find_first_cb, &found);
+  if (found == G_MAXUINT32) return FALSE;
+  if (id) *id = found;
+  return TRUE;
+}
+
+guint pattern_matcher_get_pattern_count(const PatternMatcher *matcher) {
+  if (!matcher) return 0;
+  return matcher->compiled ? matcher->pattern_count : matcher->pending->len;
+}
+
+guint pattern_matcher_get_state_count(const PatternMatcher *matcher) {
+  return matcher ? matcher->n_states : 0;
+}
+
+void pattern_matcher_free(PatternMatcher *matcher) {
+  if (!matcher) return;
+  if (matcher->pending) g_ptr_array_free(matcher->pending, TRUE);
+  if (matcher->pending_ids) g_array_free(matcher->pending_ids, TRUE);
+  g_array_free(matcher->entries, TRUE);
+  g_free(matcher->delta);
+  g_free(matcher->output);
+  g_free(matcher->report);
+  g_free(matcher->dict_link);
+  g_free(matcher);
+}
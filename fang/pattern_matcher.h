@@ -0,0 +1,36 @@
+#ifndef PATTERN_MATCHER_H
+#define PATTERN_MATCHER_H
+
+#include <glib.h>
+#include "pattern_match.h"
+
+// Case-insensitive multi-pattern matcher (Aho-Corasick automaton).
+// Patterns are added with a caller-chosen id, compiled once, and then any
+// number of texts can be scanned in a single linear pass.
+typedef struct PatternMatcher PatternMatcher;
+
+// Create an empty matcher
+PatternMatcher* pattern_matcher_new();
+
+// Add a pattern (ASCII case is ignored). Must be called before compile.
+void pattern_matcher_add(PatternMatcher *matcher, const char *pattern, guint32 id);
+
+// Build the automaton. No patterns can be added afterwards.
+void pattern_matcher_compile(PatternMatcher *matcher);
+
+// Scan text and report matches in order of their end offset
+void pattern_matcher_scan(const PatternMatcher *matcher, const char *text, gsize len,
+                          PatternMatchFunc func, gpointer user_data);
+
+// Return TRUE and the id of the first pattern found in text, if any
+gboolean pattern_matcher_find_first(const PatternMatcher *matcher, const char *text, gsize len,
+                                    guint32 *id);
+
+// Number of patterns and automaton states (for diagnostics)
+guint pattern_matcher_get_pattern_count(const PatternMatcher *matcher);
+guint pattern_matcher_get_state_count(const PatternMatcher *matcher);
+
+// Free matcher
+void pattern_matcher_free(PatternMatcher *matcher);
+
+#endif // PATTERN_MATCHER_H
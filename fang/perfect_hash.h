@@ -0,0 +1,41 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+#include <glib.h>
+
+// Lookup side of the hash-and-displace tables generated by tools/gen_psl.py
+// and tools/gen_tables.py: a key's FNV-1a hash picks a bucket, the bucket's
+// displacement picks the key's slot. Any key maps to exactly one slot, so
+// callers only compare that slot's key.
+
+#define PERFECT_HASH_FNV_OFFSET 0x811c9dc5u
+#define PERFECT_HASH_FNV_PRIME 0x01000193u
+#define PERFECT_HASH_GOLDEN 0x9e3779b9u
+
+static inline guint32 perfect_hash_key(const char *key, gsize len) {
+  guint32 h = PERFECT_HASH_FNV_OFFSET;
+  for (gsize i = 0; i < len; i++) {
+    h = (h ^ (guchar)key[i]) * PERFECT_HASH_FNV_PRIME;
+  }
+  return h;
+}
+
+// murmur3 finalizer
+static inline guint32 perfect_hash_mix(guint32 h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// Slot of key in a table of table_size slots. n_buckets is a power of two.
+static inline guint32 perfect_hash_slot(const char *key, gsize len, const guint16 *displacements,
+                                        guint32 n_buckets, guint32 table_size) {
+  guint32 h = perfect_hash_key(key, len);
+  guint32 d = displacements[h & (n_buckets - 1)];
+  return (guint32)(((guint64)perfect_hash_mix(h ^ (d * PERFECT_HASH_GOLDEN)) * table_size) >> 32);
+}
+
+#endif // PERFECT_HASH_H
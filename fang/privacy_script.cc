@@ -419,33 +419,6 @@ gchar* generate_ad_blocking_script() {
     "  \n"
     "  // ========== AGGRESSIVE AD BLOCKING ==========\n"
     "  \n"
-    "  // Selective ad hiding - avoid breaking the page\n"
-    "  const AD_SELECTORS = [\n"
-    "    '.ad-container', '.ad-box', '.ad-frame', '.ad-unit',\n"
-    "    '[class*=\"advertisement\"]', '[class*=\"ad-banner\"]',\n"
-    "    '.advertisement', '.banner-ad', '.sponsored-content',\n"
-    "    '[data-ad-slot]', '[data-ad-format]',\n"
-    "    'iframe[src*=\"ads\"]', 'iframe[src*=\"googleads\"]',\n"
-    "    '.gpt-ad', '.google_ads_div',\n"
-    "    '.taboola-container', '.outbrain-container',\n"
-    "    '.nativo-widget', '.criteo-ad',\n"
-    "    '[data-module-type=\"ad\"]', '[data-component-type=\"ad\"]'\n"
-    "  ];\n"
-    "  \n"
-    "  // Remove ad elements - more careful approach\n"
-    "  function hideAds() {\n"
-    "    for (const selector of AD_SELECTORS) {\n"
-    "      try {\n"
-    "        document.querySelectorAll(selector).forEach(el => {\n"
-    "          // Only hide if element is not critical\n"
-    "          if (el && !el.contains(document.body)) {\n"
-    "            el.style.display = 'none !important';\n"
-    "          }\n"
-    "        });\n"
-    "      } catch(e) {}\n"
-    "    }\n"
-    "  }\n"
-    "  \n"
     "  // Block tracking pixels and beacons\n"
     "  function blockTrackers() {\n"
     "    const TRACKER_DOMAINS = [\n"
@@ -516,16 +489,15 @@ gchar* generate_ad_blocking_script() {
     "  }\n"
     "  \n"
     "  // Run blocking functions\n"
-    "  hideAds();\n"
     "  blockTrackers();\n"
     "  blockScripts();\n"
     "  \n"
-    "  // Re-run when DOM changes (but less aggressively)\n"
+    "  // Re-run when DOM changes (but less aggressively). Ads are hidden by\n"
+    "  // the user stylesheets, so there is no selector walk here.\n"
     "  let mutationTimeout;\n"
     "  const observer = new MutationObserver(() => {\n"
     "    clearTimeout(mutationTimeout);\n"
     "    mutationTimeout = setTimeout(() => {\n"
-    "      hideAds();\n"
     "      blockScripts();\n"
     "    }, 100);\n"
     "  });\n"
@@ -544,3 +516,62 @@ gchar* generate_ad_blocking_script() {
 void free_ad_blocking_script(gchar *script) {
   g_free(script);
 }
+
+gchar* generate_cosmetic_token_script() {
+  return g_strdup(
+    "(function() {\n"
+    "  'use strict';\n"
+    "  const handler = window.webkit && window.webkit.messageHandlers &&\n"
+    "                  window.webkit.messageHandlers." COSMETIC_MESSAGE_HANDLER ";\n"
+    "  if (!handler) return;\n"
+    "  \n"
+    "  const seen = new Set();\n"
+    "  let pending = [];\n"
+    "  let timer = 0;\n"
+    "  \n"
+    "  function flush() {\n"
+    "    timer = 0;\n"
+    "    handler.postMessage(pending.join(' '));\n"
+    "    pending = [];\n"
+    "  }\n"
+    "  \n"
+    "  function add(token) {\n"
+    "    if (seen.has(token)) return;\n"
+    "    seen.add(token);\n"
+    "    pending.push(token);\n"
+    "    if (!timer) timer = setTimeout(flush, 0);\n"
+    "  }\n"
+    "  \n"
+    "  function scan(el) {\n"
+    "    if (el.id && !/\\s/.test(el.id)) add('#' + el.id);\n"
+    "    const classes = el.classList;\n"
+    "    if (classes) for (let i = 0; i < classes.length; i++) add('.' + classes[i]);\n"
+    "  }\n"
+    "  \n"
+    "  function scanTree(node) {\n"
+    "    if (node.nodeType !== 1) return;\n"
+    "    scan(node);\n"
+    "    const all = node.querySelectorAll('[id],[class]');\n"
+    "    for (let i = 0; i < all.length; i++) scan(all[i]);\n"
+    "  }\n"
+    "  \n"
+    "  // Only added nodes and changed attributes are looked at, never the\n"
+    "  // whole document again\n"
+    "  new MutationObserver(records => {\n"
+    "    for (const record of records) {\n"
+    "      if (record.type === 'attributes') {\n"
+    "        scan(record.target);\n"
+    "      } else {\n"
+    "        for (const node of record.addedNodes) scanTree(node);\n"
+    "      }\n"
+    "    }\n"
+    "  }).observe(document, {\n"
+    "    childList: true,\n"
+    "    subtree: true,\n"
+    "    attributes: true,\n"
+    "    attributeFilter: ['id', 'class']\n"
+    "  });\n"
+    "  if (document.documentElement) scanTree(document.documentElement);\n"
+    "})();\n"
+  );
+}
@@ -9,10 +9,19 @@ gchar* generate_privacy_script(struct FingerprintProfile *profile);
 // Free generated script
 void free_privacy_script(gchar *script);
 
-// Generate aggressive ad and tracker blocking JavaScript
+// Generate tracker blocking JavaScript. Ads are hidden by the element
+// hiding stylesheets of adblocker.cc, not by the script.
 gchar* generate_ad_blocking_script();
 
 // Free ad blocking script
 void free_ad_blocking_script(gchar *script);
 
+// Script message handler the element hiding observer posts to
+#define COSMETIC_MESSAGE_HANDLER "vaxpCosmetic"
+
+// Generate the element hiding observer: it reports the class and id names
+// used by the page, each once and in batches, as space-separated ".class"
+// and "#id" tokens. Free with free_ad_blocking_script.
+gchar* generate_cosmetic_token_script();
+
 #endif // PRIVACY_SCRIPT_H
@@ -0,0 +1,76 @@
+#include "public_suffix.h"
+#include "perfect_hash.h"
+#include <string.h>
+
+// Entry flags, mirrored in tools/gen_psl.py
+#define PSL_RULE 1        // the key is a public suffix
+#define PSL_WILDCARD 2    // every child label of the key is one
+#define PSL_EXCEPTION 4   // the key is not one, despite a wildcard
+
+#include "public_suffix_data.inc"
+
+// Flags of a suffix, or -1 if no rule ends with it
+static inline gint psl_lookup(const char *key, gsize len) {
+  guint32 slot = perfect_hash_slot(key, len, PSL_DISPLACEMENTS, PSL_BUCKET_COUNT, PSL_TABLE_SIZE);
+  guint32 entry = PSL_ENTRIES[slot];
+  if (entry == 0 || ((entry >> 3) & 0xff) != len) return -1;
+  if (memcmp(PSL_POOL + (entry >> 11), key, len) != 0) return -1;
+  return (gint)(entry & 7);
+}
+
+gsize public_suffix_length(const char *host, gsize len) {
+  if (!host || len == 0) return 0;
+
+  // Walk the labels right to left, growing the suffix. The table holds
+  // every suffix of every rule, so the walk stops at the first miss.
+  gsize end = len;
+  gsize start = len;
+  while (start > 0 && host[start - 1] != '.') start--;
+  gsize suffix_start = start;  // default rule "*": the last label
+  gboolean wildcard = FALSE;
+
+  for (;;) {
+    if (wildcard) suffix_start = start;
+
+    gint flags = psl_lookup(host + start, len - start);
+    if (flags < 0) break;
+    if (flags & PSL_EXCEPTION) {
+      suffix_start = end + 1;
+      break;
+    }
+    if (flags & PSL_RULE) suffix_start = start;
+    wildcard = (flags & PSL_WILDCARD) != 0;
+
+    if (start == 0) break;
+    end = start - 1;
+    start = end;
+    while (start > 0 && host[start - 1] != '.') start--;
+  }
+  return len - suffix_start;
+}
+
+const char* public_suffix_registrable_domain(const char *host, gsize len, gsize *domain_len) {
+  gsize suffix_len = public_suffix_length(host, len);
+  if (suffix_len == 0 || suffix_len + 1 >= len) return NULL;
+
+  // One more label to the left of the public suffix
+  gsize start = len - suffix_len - 1;
+  while (start > 0 && host[start - 1] != '.') start--;
+  if (domain_len) *domain_len = len - start;
+  return host + start;
+}
+
+gboolean public_suffix_same_site(const char *host_a, gsize len_a, const char *host_b, gsize len_b) {
+  gsize domain_len_a = 0, domain_len_b = 0;
+  const char *domain_a = public_suffix_registrable_domain(host_a, len_a, &domain_len_a);
+  const char *domain_b = public_suffix_registrable_domain(host_b, len_b, &domain_len_b);
+  if (!domain_a) {
+    domain_a = host_a;
+    domain_len_a = len_a;
+  }
+  if (!domain_b) {
+    domain_b = host_b;
+    domain_len_b = len_b;
+  }
+  return domain_len_a == domain_len_b && memcmp(domain_a, domain_b, domain_len_a) == 0;
+}
@@ -0,0 +1,24 @@
+#ifndef PUBLIC_SUFFIX_H
+#define PUBLIC_SUFFIX_H
+
+#include <glib.h>
+
+// Public Suffix List lookups. The list is compiled at build time by
+// tools/gen_psl.py into a perfect-hash table embedded in the binary, so
+// lookups cost one probe per host label and never allocate.
+//
+// Hosts must be lowercase ASCII (punycode for IDNs), without a trailing dot.
+
+// Length of the public suffix at the end of host ("co.uk" for
+// "ads.example.co.uk"). Hosts under no rule use their last label.
+gsize public_suffix_length(const char *host, gsize len);
+
+// Registrable domain (eTLD+1) of host, as a pointer into host and its
+// length: "example.co.uk" for "ads.example.co.uk". Returns NULL if host is
+// itself a public suffix.
+const char* public_suffix_registrable_domain(const char *host, gsize len, gsize *domain_len);
+
+// Check if two hosts share a registrable domain (same site)
+gboolean public_suffix_same_site(const char *host_a, gsize len_a, const char *host_b, gsize len_b);
+
+#endif // PUBLIC_SUFFIX_H
@@ -0,0 +1,288 @@
+#include "redirect_resources.h"
+#include "abp_engine.h"
+#include "url_parser.h"
+#include <string.h>
+
+#define DATA(bytes) bytes, sizeof(bytes) - 1
+
+// analytics.js: ga() runs hit callbacks and ready callbacks right away, and
+// dataLayer event callbacks (as well as the anti-flicker hide) are released
+static const char GOOGLE_ANALYTICS_JS[] =
+  "(function(){'use strict';var w=window,noop=function(){};"
+  "function Tracker(){}Tracker.prototype.get=noop;Tracker.prototype.set=noop;Tracker.prototype.send=noop;"
+  "var name=w.GoogleAnalyticsObject||'ga',queue=w[name];"
+  "var ga=function(){var a=Array.prototype.slice.call(arguments),last=a[a.length-1],f=null;"
+  "if(last instanceof Object&&typeof last.hitCallback==='function')f=last.hitCallback;"
+  "else if(typeof last==='function')f=function(){last(new Tracker())};"
+  "else{var i=a.indexOf('hitCallback');if(i>=0&&typeof a[i+1]==='function')f=a[i+1]}"
+  "if(f)try{f()}catch(e){}};"
+  "ga.create=function(){return new Tracker()};ga.getByName=ga.create;"
+  "ga.getAll=function(){return[new Tracker()]};ga.remove=noop;ga.loaded=true;w[name]=ga;"
+  "var dl=w.dataLayer,release=function(item){if(item instanceof Object&&typeof item.eventCallback==='function'){"
+  "var f=item.eventCallback;item.eventCallback=noop;setTimeout(f,1)}};"
+  "if(dl instanceof Object){if(dl.hide instanceof Object&&typeof dl.hide.end==='function'){dl.hide.end();dl.hide.end=noop}"
+  "if(typeof dl.push==='function'){dl.push=new Proxy(dl.push,{apply:function(f,self,a){release(a[0]);"
+  "return Reflect.apply(f,self,a)}});if(Array.isArray(dl))dl.slice().forEach(release)}}"
+  "if(typeof queue==='function'&&Array.isArray(queue.q))queue.q.splice(0).forEach(function(c){ga.apply(null,c)});"
+  "})();\n";
+
+// ga.js: the legacy _gaq queue and _gat trackers
+static const char GOOGLE_ANALYTICS_GA_JS[] =
+  "(function(){'use strict';var w=window,noop=function(){};"
+  "var tracker=new Proxy({},{get:function(t,k){return k==='_getName'||k==='_getAccount'?function(){return''}:noop}});"
+  "var run=function(c){try{if(typeof c==='function')c();"
+  "else if(Array.isArray(c)&&c[0]==='_set'&&c[1]==='hitCallback'&&typeof c[2]==='function')c[2]()}catch(e){}};"
+  "var old=w._gaq;"
+  "w._gat={_createTracker:function(){return tracker},_getTracker:function(){return tracker},"
+  "_getTrackerByName:function(){return tracker},_anonymizeIp:noop,_forceSSL:noop};"
+  "w._gaq={push:function(){for(var i=0;i<arguments.length;i++)run(arguments[i]);return 0},"
+  "_createAsyncTracker:function(){return tracker},_getAsyncTracker:function(){return tracker}};"
+  "if(Array.isArray(old))old.forEach(run);"
+  "})();\n";
+
+// gtm.js and gtag.js: dataLayer event callbacks run, the page is unhidden
+static const char GOOGLE_TAG_MANAGER_JS[] =
+  "(function(){'use strict';var w=window,noop=function(){};"
+  "var release=function(item){if(item instanceof Object&&typeof item.eventCallback==='function'){"
+  "var f=item.eventCallback;item.eventCallback=noop;setTimeout(f,1)}};"
+  "var dl=w.dataLayer;if(dl instanceof Object){"
+  "if(dl.hide instanceof Object&&typeof dl.hide.end==='function'){dl.hide.end();dl.hide.end=noop}"
+  "if(typeof dl.push==='function'){dl.push=new Proxy(dl.push,{apply:function(f,self,a){release(a[0]);"
+  "if(a[0]&&a[0][0]==='event'&&a[0][2]instanceof Object)release({eventCallback:a[0][2].event_callback});"
+  "return Reflect.apply(f,self,a)}});if(Array.isArray(dl))dl.slice().forEach(release)}}"
+  "w.google_tag_manager=w.google_tag_manager||{};"
+  "})();\n";
+
+// gpt.js: googletag runs its command queue against inert slots and services
+static const char GOOGLE_PUBLISHER_TAG_JS[] =
+  "(function(){'use strict';var w=window,noop=function(){},slots=[];"
+  "var chain=function(o,names){names.forEach(function(n){o[n]=function(){return this||o}});return o};"
+  "function Slot(path,id){this.path=path;this.id=id}"
+  "chain(Slot.prototype,['addService','clearCategoryExclusions','clearTargeting','defineSizeMapping','set',"
+  "'setCategoryExclusion','setClickUrl','setCollapseEmptyDiv','setConfig','setForceSafeFrame',"
+  "'setSafeFrameConfig','setTargeting','updateTargetingFromMap']);"
+  "Slot.prototype.get=function(){return null};Slot.prototype.getAdUnitPath=function(){return this.path};"
+  "Slot.prototype.getSlotElementId=Slot.prototype.getDomId=function(){return this.id};"
+  "Slot.prototype.getAttributeKeys=Slot.prototype.getCategoryExclusions=Slot.prototype.getTargeting="
+  "Slot.prototype.getTargetingKeys=Slot.prototype.getSizes=function(){return[]};"
+  "Slot.prototype.getResponseInformation=function(){return null};"
+  "var service=function(){var s=chain({},['addEventListener','removeEventListener','set','setTargeting',"
+  "'clearTargeting','setCategoryExclusion','clearCategoryExclusions','collapseEmptyDivs','disableInitialLoad',"
+  "'display','enableAsyncRendering','enableLazyLoad','enableSingleRequest','enableSyncRendering',"
+  "'enableVideoAds','refresh','clear','setCentering','setCookieOptions','setForceSafeFrame','setLocation',"
+  "'setPrivacySettings','setPublisherProvidedId','setRequestNonPersonalizedAds','setSafeFrameConfig',"
+  "'setTagForChildDirectedTreatment','clearTagForChildDirectedTreatment','setVideoContent',"
+  "'updateCorrelator','setRefreshUnfilledSlots','notifyUnfilledSlots','enableSyncLoading']);"
+  "s.get=function(){return null};s.getTargeting=s.getTargetingKeys=s.getAttributeKeys=function(){return[]};"
+  "s.getSlots=function(){return slots.slice()};s.isInitialLoadDisabled=function(){return false};return s};"
+  "var pubads=service(),companion=service(),content=service();"
+  "var define=function(path,size,id){var s=new Slot(path,id);slots.push(s);return s};"
+  "var queue=w.googletag&&w.googletag.cmd;"
+  "var tag={apiReady:true,pubadsReady:true,"
+  "cmd:{push:function(){for(var i=0;i<arguments.length;i++)try{arguments[i].call(w)}catch(e){}return 1}},"
+  "pubads:function(){return pubads},companionAds:function(){return companion},content:function(){return content},"
+  "defineSlot:define,defineOutOfPageSlot:function(path,id){return define(path,null,typeof id==='string'?id:'')},"
+  "destroySlots:function(){slots.length=0;return true},disablePublisherConsole:noop,display:noop,"
+  "enableServices:noop,getVersion:function(){return''},openConsole:noop,setAdIframeTitle:noop,setConfig:noop,"
+  "sizeMapping:function(){var b={addSize:function(){return b},build:function(){return[]}};return b},"
+  "secureSignalProviders:{push:noop}};"
+  "w.googletag=tag;if(Array.isArray(queue))tag.cmd.push.apply(null,queue);"
+  "})();\n";
+
+// ima3.js: the IMA SDK answers every ad request with an empty-response ad
+// error, so video players start the content without ads
+static const char GOOGLE_IMA_JS[] =
+  "(function(){'use strict';var w=window,noop=function(){};"
+  "if(w.google&&w.google.ima&&w.google.ima.VERSION)return;"
+  "function Events(){this.listeners={}}"
+  "Events.prototype.addEventListener=function(t,f){[].concat(t).forEach(function(x){"
+  "(this.listeners[x]=this.listeners[x]||[]).push(f)},this)};"
+  "Events.prototype.removeEventListener=function(t,f){[].concat(t).forEach(function(x){var l=this.listeners[x];"
+  "if(l&&l.indexOf(f)>=0)l.splice(l.indexOf(f),1)},this)};"
+  "Events.prototype.dispatch=function(t,e){(this.listeners[t]||[]).slice().forEach(function(f){"
+  "try{f(e)}catch(x){}})};"
+  "function AdError(){}AdError.prototype.getErrorCode=function(){return 1009};"
+  "AdError.prototype.getVastErrorCode=function(){return 303};AdError.prototype.getType=function(){return'adLoadError'};"
+  "AdError.prototype.getMessage=function(){return'The VAST response document is empty.'};"
+  "AdError.prototype.getInnerError=function(){return null};"
+  "AdError.prototype.toString=function(){return'AdError 1009: '+this.getMessage()};"
+  "AdError.ErrorCode={VAST_EMPTY_RESPONSE:1009,UNKNOWN_ERROR:900};"
+  "AdError.Type={AD_LOAD:'adLoadError',AD_PLAY:'adPlayError'};"
+  "function AdErrorEvent(context){this.error=new AdError();this.context=context}"
+  "AdErrorEvent.prototype.type='adError';AdErrorEvent.prototype.getError=function(){return this.error};"
+  "AdErrorEvent.prototype.getUserRequestContext=function(){return this.context||{}};"
+  "AdErrorEvent.Type={AD_ERROR:'adError'};"
+  "function ImaSdkSettings(){}"
+  "['setAutoPlayAdBreaks','setCompanionBackfill','setCookiesEnabled','setDisableCustomPlaybackForIOS10Plus',"
+  "'setFeatureFlags','setLocale','setNumRedirects','setPlayerType','setPlayerVersion','setPpid',"
+  "'setSessionId','setVpaidAllowed','setVpaidMode'].forEach(function(n){ImaSdkSettings.prototype[n]=noop});"
+  "ImaSdkSettings.prototype.getLocale=function(){return'en'};"
+  "ImaSdkSettings.prototype.getNumRedirects=function(){return 4};"
+  "ImaSdkSettings.prototype.getPlayerType=ImaSdkSettings.prototype.getPlayerVersion=function(){return''};"
+  "ImaSdkSettings.prototype.getPpid=function(){return null};"
+  "ImaSdkSettings.prototype.getVpaidMode=function(){return 0};"
+  "ImaSdkSettings.prototype.getFeatureFlags=function(){return{}};"
+  "ImaSdkSettings.prototype.isCookiesEnabled=function(){return true};"
+  "ImaSdkSettings.prototype.isVpaidAdapter=ImaSdkSettings.prototype.getDisableCustomPlaybackForIOS10Plus="
+  "function(){return false};"
+  "ImaSdkSettings.VpaidMode={DISABLED:0,ENABLED:1,INSECURE:2};"
+  "function AdsLoader(){Events.call(this);this.settings=new ImaSdkSettings()}"
+  "AdsLoader.prototype=Object.create(Events.prototype);"
+  "AdsLoader.prototype.contentComplete=noop;AdsLoader.prototype.destroy=noop;"
+  "AdsLoader.prototype.getSettings=function(){return this.settings};"
+  "AdsLoader.prototype.getVersion=function(){return ima.VERSION};"
+  "AdsLoader.prototype.requestAds=function(request,context){var self=this;"
+  "setTimeout(function(){self.dispatch('adError',new AdErrorEvent(context))},0)};"
+  "function AdDisplayContainer(){}AdDisplayContainer.prototype.initialize=noop;"
+  "AdDisplayContainer.prototype.destroy=noop;"
+  "function AdsRequest(){}['setAdWillAutoPlay','setAdWillPlayMuted','setContinuousPlayback'].forEach(function(n){"
+  "AdsRequest.prototype[n]=noop});"
+  "var ima={VERSION:'3.517.2',settings:new ImaSdkSettings(),"
+  "AdDisplayContainer:AdDisplayContainer,AdError:AdError,AdErrorEvent:AdErrorEvent,AdsLoader:AdsLoader,"
+  "AdsRequest:AdsRequest,AdsRenderingSettings:function(){},CompanionAdSelectionSettings:function(){},"
+  "ImaSdkSettings:ImaSdkSettings,"
+  "AdsManagerLoadedEvent:{Type:{ADS_MANAGER_LOADED:'adsManagerLoaded'}},"
+  "AdEvent:{Type:{AD_BREAK_READY:'adBreakReady',AD_BUFFERING:'adBuffering',AD_CAN_PLAY:'adCanPlay',"
+  "AD_METADATA:'adMetadata',AD_PROGRESS:'adProgress',ALL_ADS_COMPLETED:'allAdsCompleted',CLICK:'click',"
+  "COMPLETE:'complete',CONTENT_PAUSE_REQUESTED:'contentPauseRequested',"
+  "CONTENT_RESUME_REQUESTED:'contentResumeRequested',DURATION_CHANGE:'durationChange',"
+  "FIRST_QUARTILE:'firstQuartile',IMPRESSION:'impression',INTERACTION:'interaction',"
+  "LINEAR_CHANGED:'linearChanged',LOADED:'loaded',LOG:'log',MIDPOINT:'midpoint',PAUSED:'pause',"
+  "RESUMED:'resume',SKIPPABLE_STATE_CHANGED:'skippableStateChanged',SKIPPED:'skip',STARTED:'start',"
+  "THIRD_QUARTILE:'thirdQuartile',USER_CLOSE:'userClose',VIDEO_CLICKED:'videoClicked',"
+  "VIDEO_ICON_CLICKED:'videoIconClicked',VOLUME_CHANGED:'volumeChange',VOLUME_MUTED:'mute'}},"
+  "UiElements:{AD_ATTRIBUTION:'adAttribution',COUNTDOWN:'countdown'},"
+  "ViewMode:{NORMAL:'normal',FULLSCREEN:'fullscreen'}};"
+  "w.google=w.google||{};w.google.ima=ima;"
+  "})();\n";
+
+// Transparent 1x1 GIF
+static const char TRANSPARENT_GIF[] =
+  "GIF89a\x01\x00\x01\x00\x80\x00\x00\x00\x00\x00\xff\xff\xff\x21\xf9\x04\x01\x00\x00\x00\x00"
+  "\x2c\x00\x00\x00\x00\x01\x00\x01\x00\x00\x02\x02\x44\x01\x00\x3b";
+
+static const RedirectResource RESOURCES[] = {
+  { "google-analytics_analytics.js", "google-analytics.com/analytics.js",
+    "application/javascript", DATA(GOOGLE_ANALYTICS_JS) },
+  { "google-analytics_ga.js", "google-analytics.com/ga.js", "application/javascript",
+    DATA(GOOGLE_ANALYTICS_GA_JS) },
+  { "googletagmanager_gtm.js", "googletagmanager.com/gtm.js", "application/javascript",
+    DATA(GOOGLE_TAG_MANAGER_JS) },
+  { "googletagservices_gpt.js", "googletagservices.com/gpt.js", "application/javascript",
+    DATA(GOOGLE_PUBLISHER_TAG_JS) },
+  { "google-ima.js", "google-ima3", "application/javascript", DATA(GOOGLE_IMA_JS) },
+  { "1x1.gif", "1x1-transparent.gif", "image/gif", DATA(TRANSPARENT_GIF) },
+  { "noop.js", "noopjs", "application/javascript", DATA("(function(){})();\n") },
+  { "noop.css", "noopcss", "text/css", DATA("") },
+  { "noop.txt", "nooptext", "text/plain", DATA("") },
+  { "noop.html", "noopframe", "text/html", DATA("<!DOCTYPE html>\n") },
+  { "noop.json", "noopjson", "application/json", DATA("{}\n") },
+  { "empty", "", "text/plain", DATA("") },
+};
+
+#define N_RESOURCES (sizeof(RESOURCES) / sizeof(RESOURCES[0]))
+
+// Built-in stand-ins for requests the blocking layers catch without a
+// "$redirect=" filter: host (and its subdomains), path prefix, resource
+// types (0 for any) and resource. The first match wins.
+static const struct {
+  const char *host;
+  const char *path;
+  guint types;
+  const char *resource;
+} SURROGATES[] = {
+  { "google-analytics.com", "/analytics.js", ABP_TYPE_SCRIPT, "google-analytics_analytics.js" },
+  { "google-analytics.com", "/ga.js", ABP_TYPE_SCRIPT, "google-analytics_ga.js" },
+  { "googletagmanager.com", "/gtag/js", ABP_TYPE_SCRIPT, "googletagmanager_gtm.js" },
+  { "googletagmanager.com", "/gtm.js", ABP_TYPE_SCRIPT, "googletagmanager_gtm.js" },
+  { "googletagservices.com", "/tag/js/gpt.js", ABP_TYPE_SCRIPT, "googletagservices_gpt.js" },
+  { "securepubads.g.doubleclick.net", "/tag/js/gpt.js", ABP_TYPE_SCRIPT, "googletagservices_gpt.js" },
+  { "imasdk.googleapis.com", "/js/sdkloader/ima3.js", ABP_TYPE_SCRIPT, "google-ima.js" },
+  { "google-analytics.com", "/", ABP_TYPE_IMAGE, "1x1.gif" },
+  { "google-analytics.com", "/", ABP_TYPE_XMLHTTPREQUEST | ABP_TYPE_PING, "noop.txt" },
+  { "stats.g.doubleclick.net", "/", ABP_TYPE_IMAGE, "1x1.gif" },
+  { "stats.g.doubleclick.net", "/", ABP_TYPE_XMLHTTPREQUEST | ABP_TYPE_PING, "noop.txt" },
+};
+
+const RedirectResource* redirect_resource_lookup(const char *name, gsize len) {
+  if (!name || len == 0) return NULL;
+  for (guint i = 0; i < N_RESOURCES; i++) {
+    if ((strlen(RESOURCES[i].name) == len && memcmp(RESOURCES[i].name, name, len) == 0) ||
+        url_word_in_list(RESOURCES[i].aliases, name, len)) {
+      return &RESOURCES[i];
+    }
+  }
+  return NULL;
+}
+
+const RedirectResource* redirect_resource_for_filter(const char *filter) {
+  const char *options = filter ? strrchr(filter, '$') : NULL;
+  if (!options) return NULL;
+
+  // "$script,redirect=noop.js:5": the priority after ':' is irrelevant
+  // with one resource per filter
+  for (const char *p = options + 1; *p; ) {
+    gsize len = strcspn(p, ",");
+    if (len > 9 && strncmp(p, "redirect=", 9) == 0) {
+      const char *name = p + 9;
+      gsize name_len = strcspn(name, ",:");
+      return redirect_resource_lookup(name, name_len);
+    }
+    p += len;
+    if (*p == ',') p++;
+  }
+  return NULL;
+}
+
+// Host and path of an http(s) URL, without port, query and fragment
+static gboolean split_url(const char *uri, const char **host, gsize *host_len, const char **path,
+                          gsize *path_len) {
+  const char *start = strstr(uri, "://");
+  if (!start) return FALSE;
+  start += 3;
+  const char *at = start + strcspn(start, "/?#");
+  const char *user = (const char *)memchr(start, '@', at - start);
+  if (user) start = user + 1;
+
+  *host = start;
+  *host_len = strcspn(start, ":/?#");
+  if (*host_len > (gsize)(at - start)) *host_len = at - start;
+  *path = *at == '/' ? at : "/";
+  *path_len = *at == '/' ? strcspn(at, "?#") : 1;
+  return *host_len > 0;
+}
+
+const RedirectResource* redirect_resource_for_request(const char *uri, guint type,
+                                                      const char *filter) {
+  const RedirectResource *resource = redirect_resource_for_filter(filter);
+  if (resource) return resource;
+
+  const char *host, *path;
+  gsize host_len, path_len;
+  if (!uri || !split_url(uri, &host, &host_len, &path, &path_len)) return NULL;
+
+  for (guint i = 0; i < G_N_ELEMENTS(SURROGATES); i++) {
+    gsize prefix_len = strlen(SURROGATES[i].path);
+    if ((type == 0 || (type & SURROGATES[i].types)) && prefix_len <= path_len &&
+        memcmp(path, SURROGATES[i].path, prefix_len) == 0 &&
+        url_host_in_domain(host, host_len, SURROGATES[i].host)) {
+      const char *name = SURROGATES[i].resource;
+      return redirect_resource_lookup(name, strlen(name));
+    }
+  }
+  return NULL;
+}
+
+gchar* redirect_resource_build_uri(const RedirectResource *resource) {
+  return g_strconcat(REDIRECT_RESOURCE_SCHEME ":///", resource->name, NULL);
+}
+
+const RedirectResource* redirect_resource_from_path(const char *path) {
+  if (!path) return NULL;
+  while (*path == '/') path++;
+  return redirect_resource_lookup(path, strlen(path));
+}
+
+guint redirect_resource_get_count() {
+  return N_RESOURCES;
+}
@@ -0,0 +1,48 @@
+#ifndef REDIRECT_RESOURCES_H
+#define REDIRECT_RESOURCES_H
+
+#include <glib.h>
+
+// Small stand-ins for blocked resources (no-op analytics and ad library
+// shims, a 1x1 GIF, empty text and JSON) kept in memory. A blocked request
+// with a stand-in is redirected to it instead of failing, so pages waiting
+// on the script or its callbacks carry on. The web processes pick the
+// resource and rewrite the request URI; the browser serves the bytes from
+// its own URI scheme.
+
+// URI scheme the browser serves resources from: "vaxp-resource:///1x1.gif"
+#define REDIRECT_RESOURCE_SCHEME "vaxp-resource"
+
+typedef struct {
+  const char *name;           // uBlock Origin resource name
+  const char *aliases;        // space-separated
+  const char *content_type;
+  const char *data;
+  gsize len;
+} RedirectResource;
+
+// Resource by name or alias ("1x1.gif", "1x1-transparent.gif"), NULL if
+// there is none
+const RedirectResource* redirect_resource_lookup(const char *name, gsize len);
+
+// Resource named by the "$redirect=" option of a network filter line, NULL
+// if it has none or names an unknown resource
+const RedirectResource* redirect_resource_for_filter(const char *filter);
+
+// Resource to answer a blocked request with: the one of the filter that
+// blocked it (NULL for other layers), else the built-in stand-in for the
+// URL and resource type (AbpResourceType, 0 if unknown) if there is one
+const RedirectResource* redirect_resource_for_request(const char *uri, guint type,
+                                                      const char *filter);
+
+// URI of resource in REDIRECT_RESOURCE_SCHEME (free with g_free)
+gchar* redirect_resource_build_uri(const RedirectResource *resource);
+
+// Resource for a REDIRECT_RESOURCE_SCHEME request path ("/1x1.gif"), NULL
+// if there is none
+const RedirectResource* redirect_resource_from_path(const char *path);
+
+// Number of resources
+guint redirect_resource_get_count();
+
+#endif // REDIRECT_RESOURCES_H
@@ -0,0 +1,221 @@
+#include "rule_profiler.h"
+#include <string.h>
+#include <time.h>
+
+#define RULE_TABLE_SIZE 32768   // power of two
+#define MAX_PROBES 64
+#define TOP_URLS 64
+
+typedef struct {
+  guint64 key;          // 0 marks a free slot
+  guint64 evaluations;
+  guint64 nanoseconds;
+  const char *layer;
+  gchar *name;          // published by the thread that claimed the slot
+} CostSlot;
+
+gboolean rule_profiler_active = FALSE;
+
+static CostSlot rule_slots[RULE_TABLE_SIZE];
+static guint64 timer_overhead = 0;
+
+// The most expensive URLs, replaced cheapest first. cheapest_url is read
+// without the lock to skip the common case.
+static RuleCost top_urls[TOP_URLS];
+static guint n_top_urls = 0;
+static guint64 cheapest_url = 0;
+G_LOCK_DEFINE_STATIC(top_urls);
+
+guint64 rule_profiler_now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (guint64)ts.tv_sec * 1000000000ull + (guint64)ts.tv_nsec;
+}
+
+void rule_profiler_init() {
+  rule_profiler_active = g_getenv("VAXP_PROFILE_RULES") != NULL;
+  if (!rule_profiler_active) return;
+
+  // Back-to-back clock reads: the smallest gap is what a measurement of
+  // nothing costs, subtracted from every sample
+  guint64 best = G_MAXUINT64;
+  for (int i = 0; i < 1000; i++) {
+    guint64 start = rule_profiler_now();
+    guint64 gap = rule_profiler_now() - start;
+    if (gap < best) best = gap;
+  }
+  timer_overhead = best;
+  g_print("Rule Profiler: Timing rule evaluations (clock overhead %lu ns)\n", timer_overhead);
+}
+
+static inline guint64 elapsed_since(guint64 start) {
+  guint64 elapsed = rule_profiler_now() - start;
+  return elapsed > timer_overhead ? elapsed - timer_overhead : 0;
+}
+
+static guint64 cost_key(const char *layer, const char *name) {
+  guint64 h = 14695981039346656037ull;
+  for (const char *p = layer; *p; p++) {
+    h ^= (guchar)*p;
+    h *= 1099511628211ull;
+  }
+  for (const char *p = name; *p; p++) {
+    h ^= (guchar)*p;
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h ? h : 1;
+}
+
+void rule_profiler_record_rule(const char *layer, const char *rule, guint64 start) {
+  guint64 elapsed = elapsed_since(start);
+  guint64 key = cost_key(layer, rule);
+
+  // Same claiming scheme as the hit counters; a full table drops samples
+  guint i = (guint)key & (RULE_TABLE_SIZE - 1);
+  for (guint probe = 0; probe < MAX_PROBES; probe++, i = (i + 1) & (RULE_TABLE_SIZE - 1)) {
+    CostSlot *slot = &rule_slots[i];
+    guint64 current = __atomic_load_n(&slot->key, __ATOMIC_ACQUIRE);
+    if (current == 0) {
+      if (__atomic_compare_exchange_n(&slot->key, &current, key, FALSE, __ATOMIC_ACQ_REL,
+                                      __ATOMIC_ACQUIRE)) {
+        slot->layer = layer;
+        __atomic_store_n(&slot->name, g_strdup(rule), __ATOMIC_RELEASE);
+        current = key;
+      }
+    }
+    if (current != key) continue;
+
+    __atomic_fetch_add(&slot->evaluations, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&slot->nanoseconds, elapsed, __ATOMIC_RELAXED);
+    return;
+  }
+}
+
+void rule_profiler_record_url(const char *url, guint64 start) {
+  guint64 elapsed = elapsed_since(start);
+  if (__atomic_load_n(&n_top_urls, __ATOMIC_RELAXED) == TOP_URLS && elapsed <= __atomic_load_n(&cheapest_url, __ATOMIC_RELAXED)) {
+    return;
+  }
+
+  G_LOCK(top_urls);
+  guint slot = n_top_urls;
+  for (guint i = 0; i < n_top_urls; i++) {
+    if (strcmp(top_urls[i].name, url) == 0) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot == TOP_URLS) {
+    // Evict the cheapest URL
+    slot = 0;
+    for (guint i = 1; i < n_top_urls; i++) {
+      if (top_urls[i].nanoseconds < top_urls[slot].nanoseconds) slot = i;
+    }
+    g_free((gchar *)top_urls[slot].name);
+    top_urls[slot].name = NULL;
+  }
+  if (slot == n_top_urls) __atomic_store_n(&n_top_urls, n_top_urls + 1, __ATOMIC_RELAXED);
+  if (!top_urls[slot].name) {
+    top_urls[slot].layer = NULL;
+    top_urls[slot].name = g_strdup(url);
+    top_urls[slot].evaluations = 0;
+    top_urls[slot].nanoseconds = 0;
+  }
+  top_urls[slot].evaluations++;
+  top_urls[slot].nanoseconds += elapsed;
+
+  guint64 cheapest = G_MAXUINT64;
+  for (guint i = 0; i < n_top_urls; i++) {
+    cheapest = MIN(cheapest, top_urls[i].nanoseconds);
+  }
+  __atomic_store_n(&cheapest_url, cheapest, __ATOMIC_RELAXED);
+  G_UNLOCK(top_urls);
+}
+
+static gint compare_cost(gconstpointer a, gconstpointer b) {
+  guint64 ca = ((const RuleCost *)a)->nanoseconds;
+  guint64 cb = ((const RuleCost *)b)->nanoseconds;
+  return ca < cb ? 1 : (ca > cb ? -1 : 0);
+}
+
+GArray* rule_profiler_get_rules() {
+  GArray *result = g_array_new(FALSE, FALSE, sizeof(RuleCost));
+  for (guint i = 0; i < RULE_TABLE_SIZE; i++) {
+    const char *name = __atomic_load_n(&rule_slots[i].name, __ATOMIC_ACQUIRE);
+    if (!name) continue;
+
+    RuleCost entry;
+    entry.layer = rule_slots[i].layer;
+    entry.name = name;
+    entry.evaluations = __atomic_load_n(&rule_slots[i].evaluations, __ATOMIC_RELAXED);
+    entry.nanoseconds = __atomic_load_n(&rule_slots[i].nanoseconds, __ATOMIC_RELAXED);
+    g_array_append_val(result, entry);
+  }
+  g_array_sort(result, compare_cost);
+  return result;
+}
+
+static void clear_url_cost(gpointer data) {
+  g_free((gchar *)((RuleCost *)data)->name);
+}
+
+// URL names are copied too: an evicted entry frees its name
+GArray* rule_profiler_get_urls() {
+  GArray *result = g_array_new(FALSE, FALSE, sizeof(RuleCost));
+  g_array_set_clear_func(result, clear_url_cost);
+  G_LOCK(top_urls);
+  for (guint i = 0; i < n_top_urls; i++) {
+    RuleCost entry = top_urls[i];
+    entry.name = g_strdup(entry.name);
+    g_array_append_val(result, entry);
+  }
+  G_UNLOCK(top_urls);
+  g_array_sort(result, compare_cost);
+  return result;
+}
+
+static void append_costs(GString *out, GArray *costs, guint limit) {
+  for (guint i = 0; i < costs->len && i < limit; i++) {
+    const RuleCost *entry = &g_array_index(costs, RuleCost, i);
+    g_string_append_printf(out, "%lu\t%lu\t%.1f\t%s\t%s\n", entry->nanoseconds, entry->evaluations,
+                           entry->evaluations ? (double)entry->nanoseconds / entry->evaluations : 0.0,
+                           entry->layer ? entry->layer : "url", entry->name);
+  }
+}
+
+gboolean rule_profiler_write_report(const char *path) {
+  GString *out = g_string_new("# total ns\tevaluations\tns/evaluation\tlayer\trule\n");
+  GArray *rules = rule_profiler_get_rules();
+  append_costs(out, rules, rules->len);
+  g_array_unref(rules);
+
+  g_string_append(out, "# total ns\tdecisions\tns/decision\t\turl\n");
+  GArray *urls = rule_profiler_get_urls();
+  append_costs(out, urls, urls->len);
+  g_array_unref(urls);
+
+  gboolean ok = g_file_set_contents(path, out->str, out->len, NULL);
+  g_string_free(out, TRUE);
+  if (ok) g_print("Rule Profiler: Wrote report to %s\n", path);
+  return ok;
+}
+
+void rule_profiler_log_report(guint count) {
+  GString *out = g_string_new(NULL);
+  GArray *rules = rule_profiler_get_rules();
+  g_print("Rule Profiler: %u most expensive of %u rules\n", MIN(count, rules->len), rules->len);
+  append_costs(out, rules, count);
+  g_array_unref(rules);
+  g_print("%s", out->str);
+
+  g_string_truncate(out, 0);
+  GArray *urls = rule_profiler_get_urls();
+  g_print("Rule Profiler: %u most expensive URLs\n", MIN(count, urls->len));
+  append_costs(out, urls, count);
+  g_array_unref(urls);
+  g_print("%s", out->str);
+  g_string_free(out, TRUE);
+}
@@ -0,0 +1,52 @@
+#ifndef RULE_PROFILER_H
+#define RULE_PROFILER_H
+
+#include <glib.h>
+
+// Opt-in cost profiler for the blocking rules. With VAXP_PROFILE_RULES set
+// in the environment, every EasyList filter test and every pass of the
+// other layers is timed, and so is each request decided without the cache.
+// Rules are ranked by cumulative time to catch badly anchored or
+// wildcard-heavy filters after a list update. Off, the hooks cost one
+// predicted branch.
+
+// Profiling switch, read from the environment by rule_profiler_init
+extern gboolean rule_profiler_active;
+
+// Read VAXP_PROFILE_RULES and calibrate the clock. Safe to call again.
+void rule_profiler_init();
+
+static inline gboolean rule_profiler_enabled() {
+  return G_UNLIKELY(rule_profiler_active);
+}
+
+// Monotonic clock in nanoseconds, the start time passed to the recorders
+guint64 rule_profiler_now();
+
+// Charge the time since start to one evaluation of rule in layer (a
+// static layer name). The rule text is copied the first time it is seen.
+void rule_profiler_record_rule(const char *layer, const char *rule, guint64 start);
+
+// Charge the time since start to a request URL. Only the most expensive
+// URLs are kept.
+void rule_profiler_record_url(const char *url, guint64 start);
+
+// Cost of a rule or URL
+typedef struct {
+  const char *layer;    // NULL for URLs
+  const char *name;     // owned by the profiler, never freed
+  guint64 evaluations;
+  guint64 nanoseconds;
+} RuleCost;
+
+// Copy the rule or URL costs, most expensive first. Free with g_array_unref.
+GArray* rule_profiler_get_rules();
+GArray* rule_profiler_get_urls();
+
+// Write both rankings as TSV to path
+gboolean rule_profiler_write_report(const char *path);
+
+// Print the count most expensive rules and URLs
+void rule_profiler_log_report(guint count);
+
+#endif // RULE_PROFILER_H
@@ -0,0 +1,115 @@
+#include "rule_stats.h"
+#include <string.h>
+
+#define RULE_TABLE_SIZE 16384   // power of two
+#define DOMAIN_TABLE_SIZE 8192  // power of two
+#define MAX_PROBES 64
+
+typedef struct {
+  guint64 key;          // 0 marks a free slot
+  guint64 hits;
+  gint layer;
+  gchar *name;          // published by the thread that claimed the slot
+} HitSlot;
+
+static HitSlot rule_slots[RULE_TABLE_SIZE];
+static HitSlot domain_slots[DOMAIN_TABLE_SIZE];
+static guint64 dropped_hits = 0;
+
+guint64 rule_stats_key(gint kind, const char *name, gsize len) {
+  guint64 h = 14695981039346656037ull ^ (guint64)(guint32)kind;
+  for (gsize i = 0; i < len; i++) {
+    h ^= (guchar)name[i];
+    h *= 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return h ? h : 1;
+}
+
+// Slot holding key. With claim set, a free slot on the probe path is taken
+// and *claimed tells the caller to name it.
+static HitSlot* find_slot(HitSlot *slots, guint size, guint64 key, gboolean claim,
+                          gboolean *claimed) {
+  guint i = (guint)key & (size - 1);
+  for (guint probe = 0; probe < MAX_PROBES; probe++, i = (i + 1) & (size - 1)) {
+    guint64 current = __atomic_load_n(&slots[i].key, __ATOMIC_ACQUIRE);
+    if (current == key) return &slots[i];
+    if (current != 0) continue;
+    if (!claim) return NULL;
+
+    if (__atomic_compare_exchange_n(&slots[i].key, &current, key, FALSE, __ATOMIC_ACQ_REL,
+                                    __ATOMIC_ACQUIRE)) {
+      *claimed = TRUE;
+      return &slots[i];
+    }
+    // Another thread took the slot first, possibly for the same key
+    if (current == key) return &slots[i];
+  }
+  return NULL;
+}
+
+static void record(HitSlot *slots, guint size, guint64 key, gint layer, const char *name,
+                   gsize len) {
+  gboolean claimed = FALSE;
+  HitSlot *slot = find_slot(slots, size, key, name != NULL, &claimed);
+  if (!slot) {
+    __atomic_fetch_add(&dropped_hits, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  if (claimed) {
+    slot->layer = layer;
+    __atomic_store_n(&slot->name, g_strndup(name, len), __ATOMIC_RELEASE);
+  }
+  __atomic_fetch_add(&slot->hits, 1, __ATOMIC_RELAXED);
+}
+
+void rule_stats_record_rule(guint64 key, gint layer, const char *rule) {
+  record(rule_slots, RULE_TABLE_SIZE, key, layer, rule, rule ? strlen(rule) : 0);
+}
+
+void rule_stats_record_domain(guint64 key, const char *domain, gsize len) {
+  record(domain_slots, DOMAIN_TABLE_SIZE, key, 0, domain, len);
+}
+
+static gint compare_hits(gconstpointer a, gconstpointer b) {
+  guint64 ha = ((const RuleHits *)a)->hits;
+  guint64 hb = ((const RuleHits *)b)->hits;
+  return ha < hb ? 1 : (ha > hb ? -1 : 0);
+}
+
+// Copy the named slots; a slot claimed but not yet named is skipped
+static GArray* snapshot_table(const HitSlot *slots, guint size) {
+  GArray *result = g_array_new(FALSE, FALSE, sizeof(RuleHits));
+  for (guint i = 0; i < size; i++) {
+    const char *name = __atomic_load_n(&slots[i].name, __ATOMIC_ACQUIRE);
+    if (!name) continue;
+
+    RuleHits entry;
+    entry.layer = slots[i].layer;
+    entry.name = name;
+    entry.hits = __atomic_load_n(&slots[i].hits, __ATOMIC_RELAXED);
+    g_array_append_val(result, entry);
+  }
+  g_array_sort(result, compare_hits);
+  return result;
+}
+
+GArray* rule_stats_get_rules() {
+  return snapshot_table(rule_slots, RULE_TABLE_SIZE);
+}
+
+GArray* rule_stats_get_domains() {
+  return snapshot_table(domain_slots, DOMAIN_TABLE_SIZE);
+}
+
+guint64 rule_stats_get_hits(guint64 key) {
+  gboolean claimed = FALSE;
+  const HitSlot *slot = find_slot(rule_slots, RULE_TABLE_SIZE, key, FALSE, &claimed);
+  return slot ? __atomic_load_n(&slot->hits, __ATOMIC_RELAXED) : 0;
+}
+
+guint64 rule_stats_get_dropped() {
+  return __atomic_load_n(&dropped_hits, __ATOMIC_RELAXED);
+}
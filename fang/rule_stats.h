@@ -0,0 +1,41 @@
+#ifndef RULE_STATS_H
+#define RULE_STATS_H
+
+#include <glib.h>
+
+// Hit counters for blocking rules and blocked domains. Counters live in
+// fixed open-addressed tables: recording is one probe and a relaxed atomic
+// add, safe from any thread without locks. A slot is claimed the first
+// time its key is seen and never freed; once a table is full, further new
+// keys are only counted as dropped.
+
+// Counter key of a name within a kind (a BlockLayer for rules, 0 for
+// domains). Compute it once per decision and keep it with the verdict.
+guint64 rule_stats_key(gint kind, const char *name, gsize len);
+
+// Count a hit on a rule of layer. rule names the counter on its first
+// hit; pass NULL when the key was recorded before (cached verdicts).
+void rule_stats_record_rule(guint64 key, gint layer, const char *rule);
+
+// Count a blocked request to a registrable domain. Same naming as above.
+void rule_stats_record_domain(guint64 key, const char *domain, gsize len);
+
+// Counter in a snapshot
+typedef struct {
+  gint layer;           // BlockLayer of a rule, 0 for domains
+  const char *name;     // owned by the table, never freed
+  guint64 hits;
+} RuleHits;
+
+// Copy the rule or domain counters, most hits first. Free with
+// g_array_unref.
+GArray* rule_stats_get_rules();
+GArray* rule_stats_get_domains();
+
+// Hits recorded under key, 0 if none
+guint64 rule_stats_get_hits(guint64 key);
+
+// Hits lost because a table was full
+guint64 rule_stats_get_dropped();
+
+#endif // RULE_STATS_H
@@ -0,0 +1,242 @@
+#include "scriptlets.h"
+#include "url_parser.h"
+#include <string.h>
+
+// Helpers shared by scriptlets, emitted once per script under their
+// one-letter name, in this order
+typedef struct {
+  char name;
+  const char *body;
+} ScriptletHelper;
+
+static const ScriptletHelper HELPERS[] = {
+  // P(text): RegExp for "/regex/flags" or a literal; "" and "*" match anything
+  { 'P', "function(s){if(!s||s==='*')return/^/;var m=/^\\/(.+)\\/([gimsu]*)$/.exec(s);"
+         "if(m)try{return new RegExp(m[1],m[2])}catch(e){return/^(?!)/}"
+         "return new RegExp(s.replace(/[.*+?^${}()|[\\]\\\\]/g,'\\\\$&'))}" },
+  // T(chain, leaf): call leaf(owner, prop) for "a.b.c" once its owner exists
+  { 'T', "function(c,leaf){function t(o,p){var k=p[0];if(p.length===1){try{leaf(o,k)}catch(e){}return}"
+         "var v=o[k];if(v instanceof Object){t(v,p.slice(1));return}"
+         "try{Object.defineProperty(o,k,{configurable:true,get:function(){return v},"
+         "set:function(a){v=a;if(a instanceof Object)t(a,p.slice(1))}})}catch(e){}}"
+         "t(window,c.split('.'))}" },
+  // M(needle): matcher of request details for "url:x method:POST ..." or a URL part
+  { 'M', "function(n){var ps=[];String(n).split(/\\s+/).forEach(function(t){if(!t)return;"
+         "var i=t.indexOf(':'),k='url',v=t;if(/^(url|method|body|mode|credentials|cache|redirect|"
+         "referrer|referrerPolicy|integrity|keepalive)$/.test(t.slice(0,i))){k=t.slice(0,i);v=t.slice(i+1)}"
+         "ps.push([k,P(v)])});return function(d){for(var i=0;i<ps.length;i++){var x=d[ps[i][0]];"
+         "if(x===undefined||!ps[i][1].test(String(x)))return false}return true}}" },
+  // D(timer, needle, delay): replace callbacks of matching timers by no-ops
+  { 'D', "function(name,n,d){n=n||'';d=d||'';if(!n&&!d)return;var nn=n.charAt(0)==='!';if(nn)n=n.slice(1);"
+         "var dn=d.charAt(0)==='!';if(dn)d=d.slice(1);var re=P(n),dv=d===''?null:parseInt(d,10);"
+         "window[name]=new Proxy(window[name],{apply:function(f,self,a){"
+         "if(re.test(String(a[0]))!==nn&&(dv===null||(a[1]===dv)!==dn))a[0]=function(){};"
+         "return Reflect.apply(f,self,a)}})}" },
+  // B(timer, needle, delay, boost): scale the delay of matching timers
+  { 'B', "function(name,n,d,b){var re=P(n),dv=d==='*'?null:(parseInt(d,10)||1000);b=parseFloat(b);"
+         "if(!isFinite(b))b=0.05;b=Math.min(50,Math.max(0.001,b));"
+         "window[name]=new Proxy(window[name],{apply:function(f,self,a){"
+         "if((dv===null||a[1]===dv)&&re.test(String(a[0])))a[1]*=b;return Reflect.apply(f,self,a)}})}" },
+  // W(run): run now, once the document is parsed and after DOM changes, batched
+  { 'W', "function(run){var t=0;var go=function(){t=0;try{run()}catch(e){}};go();"
+         "if(document.readyState==='loading')document.addEventListener('DOMContentLoaded',go);"
+         "new MutationObserver(function(){if(!t)t=setTimeout(go,50)})"
+         ".observe(document,{childList:true,subtree:true})}" },
+};
+
+#define N_HELPERS (sizeof(HELPERS) / sizeof(HELPERS[0]))
+
+struct Scriptlet {
+  const char *name;
+  const char *aliases;        // space-separated
+  const char *helpers;        // HELPERS it calls, with their own dependencies
+  const char *body;
+};
+
+static const Scriptlet SCRIPTLETS[] = {
+  { "set-constant", "set", "T",
+    "function(c,raw){if(!c)return;var v,n=Number(raw);if(raw==='undefined')v=undefined;"
+    "else if(raw==='false')v=false;else if(raw==='true')v=true;else if(raw==='null')v=null;"
+    "else if(raw==='noopFunc')v=function(){};else if(raw==='trueFunc')v=function(){return true};"
+    "else if(raw==='falseFunc')v=function(){return false};else if(raw===''||raw==='emptyStr')v='';"
+    "else if(raw==='{}'||raw==='emptyObj')v={};else if(raw==='[]'||raw==='emptyArr')v=[];"
+    "else if(raw==='yes'||raw==='no')v=raw;else if(/^-?\\d+$/.test(raw)&&Math.abs(n)<=32767)v=n;else return;"
+    "T(c,function(o,k){Object.defineProperty(o,k,{configurable:true,get:function(){return v},"
+    "set:function(){}})})}" },
+  { "abort-on-property-read", "aopr", "T",
+    "function(c){if(!c)return;T(c,function(o,k){Object.defineProperty(o,k,{configurable:true,"
+    "get:function(){throw new ReferenceError(k)},set:function(){}})})}" },
+  { "abort-on-property-write", "aopw", "T",
+    "function(c){if(!c)return;T(c,function(o,k){var v=o[k];Object.defineProperty(o,k,{configurable:true,"
+    "get:function(){return v},set:function(){throw new ReferenceError(k)}})})}" },
+  { "abort-current-script", "acs abort-current-inline-script acis", "P",
+    "function(c,n){if(!c)return;var re=P(n),p=c.split('.'),o=window,k;while(p.length>1){o=o[p.shift()];"
+    "if(!(o instanceof Object))return}k=p[0];var d=Object.getOwnPropertyDescriptor(o,k),v=o[k];"
+    "var chk=function(){var s=document.currentScript;"
+    "if(s instanceof HTMLScriptElement&&re.test(s.src||s.textContent))throw new ReferenceError(k)};"
+    "try{Object.defineProperty(o,k,{configurable:true,get:function(){chk();return d&&d.get?d.get.call(this):v},"
+    "set:function(a){chk();if(d&&d.set)d.set.call(this,a);else v=a}})}catch(e){}}" },
+  { "no-setTimeout-if", "nostif prevent-setTimeout setTimeout-defuser", "PD",
+    "function(n,d){D('setTimeout',n,d)}" },
+  { "no-setInterval-if", "nosiif prevent-setInterval setInterval-defuser", "PD",
+    "function(n,d){D('setInterval',n,d)}" },
+  { "nano-setTimeout-booster", "nano-stb", "PB",
+    "function(n,d,b){B('setTimeout',n,d,b)}" },
+  { "nano-setInterval-booster", "nano-sib", "PB",
+    "function(n,d,b){B('setInterval',n,d,b)}" },
+  { "no-xhr-if", "prevent-xhr", "PM",
+    "function(n){if(!n)return;var m=M(n),X=XMLHttpRequest.prototype,o=X.open,s=X.send;"
+    "X.open=function(method,url){this.__vaxpBlock=m({method:String(method).toUpperCase(),url:String(url)});"
+    "return o.apply(this,arguments)};X.send=function(){if(!this.__vaxpBlock)return s.apply(this,arguments);"
+    "var x=this;Object.defineProperties(x,{readyState:{value:4},status:{value:200},statusText:{value:'OK'},"
+    "responseText:{value:''},response:{value:''}});setTimeout(function(){"
+    "['readystatechange','load','loadend'].forEach(function(t){x.dispatchEvent(new Event(t))})},1)}}" },
+  { "no-fetch-if", "prevent-fetch", "PM",
+    "function(n){if(!n)return;var m=M(n);window.fetch=new Proxy(window.fetch,{apply:function(f,self,a){"
+    "var r=a[0],i=a[1]||{},q=r instanceof Request;"
+    "if(m({url:q?r.url:String(r),method:String(i.method||(q?r.method:'GET')).toUpperCase()}))"
+    "return Promise.resolve(new Response(''));return Reflect.apply(f,self,a)}})}" },
+  { "addEventListener-defuser", "aeld prevent-addEventListener", "P",
+    "function(t,n){if(!t&&!n)return;var tr=P(t),hr=P(n);var p=EventTarget.prototype;"
+    "p.addEventListener=new Proxy(p.addEventListener,{apply:function(f,self,a){var h=a[1];"
+    "var s=typeof h==='function'?String(h):(h&&typeof h.handleEvent==='function'?String(h.handleEvent):'');"
+    "if(tr.test(String(a[0]))&&hr.test(s))return;return Reflect.apply(f,self,a)}})}" },
+  { "remove-attr", "ra", "W",
+    "function(at,sel){if(!at)return;var l=at.split(/\\s*\\|\\s*/),s=sel||l.map(function(a){return'['+a+']'}).join(',');"
+    "W(function(){document.querySelectorAll(s).forEach(function(e){l.forEach(function(a){e.removeAttribute(a)})})})}" },
+  { "remove-class", "rc", "W",
+    "function(cl,sel){if(!cl)return;var l=cl.split(/\\s*\\|\\s*/),s=sel||l.map(function(c){return'.'+c}).join(',');"
+    "W(function(){document.querySelectorAll(s).forEach(function(e){l.forEach(function(c){e.classList.remove(c)})})})}" },
+  { "set-attr", "", "W",
+    "function(sel,at,v){if(!sel||!at)return;v=v||'';var cp=/^\\[.+\\]$/.test(v)?v.slice(1,-1):null;"
+    "if(cp===null&&!/^(true|false|-?\\d{1,5})?$/.test(v))return;W(function(){"
+    "document.querySelectorAll(sel).forEach(function(e){var x=cp===null?v:e.getAttribute(cp);"
+    "if(x!==null&&e.getAttribute(at)!==x)e.setAttribute(at,x)})})}" },
+  { "remove-node-text", "rmnt", "P",
+    "function(nn,n){if(!nn||!n)return;var re=P(n);nn=nn.toLowerCase();"
+    "var chk=function(x){if(x.nodeName.toLowerCase()===nn&&re.test(x.textContent))x.textContent=''};"
+    "new MutationObserver(function(rs){rs.forEach(function(r){r.addedNodes.forEach(function(x){chk(x);"
+    "if(x.nodeType===1&&nn.charAt(0)!=='#')x.querySelectorAll(nn).forEach(chk)})})})"
+    ".observe(document,{childList:true,subtree:true})}" },
+  { "json-prune", "", "",
+    "function(pr,nd){if(!pr)return;var rm=pr.split(/ +/),rq=nd?nd.split(/ +/):[];"
+    "var walk=function(o,p,del){var k=p.split('.'),l=k.pop();for(var i=0;i<k.length;i++){"
+    "if(!(o instanceof Object))return false;o=o[k[i]]}if(!(o instanceof Object)||!(l in o))return false;"
+    "if(del)delete o[l];return true};JSON.parse=new Proxy(JSON.parse,{apply:function(f,self,a){"
+    "var r=Reflect.apply(f,self,a);if(rq.every(function(p){return walk(r,p,false)}))"
+    "rm.forEach(function(p){walk(r,p,true)});return r}})}" },
+  { "set-cookie", "", "",
+    "function(n,v,p){if(!n||!/^(true|false|yes|y|no|n|ok|on|off|accept|accepted|reject|rejected|allow|allowed|"
+    "deny|denied|necessary|required|hide|hidden|dismiss|dismissed|-?\\d{1,5})$/i.test(v||''))return;"
+    "var c=encodeURIComponent(n)+'='+encodeURIComponent(v);"
+    "if(document.cookie.split(/;\\s*/).indexOf(c)<0)document.cookie=c+(p==='none'?'':'; path=/')}" },
+  { "set-local-storage-item", "", "",
+    "function(k,v){if(!k)return;try{if(v==='$remove$'){localStorage.removeItem(k);return}"
+    "var m={'undefined':'undefined','false':'false','true':'true','null':'null','emptyObj':'{}',"
+    "'emptyArr':'[]','':'','yes':'yes','no':'no','on':'on','off':'off'};"
+    "var x=Object.prototype.hasOwnProperty.call(m,v)?m[v]:(/^\\d{1,5}$/.test(v)?v:null);"
+    "if(x!==null)localStorage.setItem(k,x)}catch(e){}}" },
+  { "cookie-remover", "", "P",
+    "function(n){var re=P(n);var rm=function(){document.cookie.split(';').forEach(function(c){"
+    "var k=c.split('=')[0].trim();if(!k||!re.test(k))return;var ex='=; expires=Thu, 01 Jan 1970 00:00:00 GMT; path=/',"
+    "d=location.hostname.split('.');document.cookie=k+ex;for(var i=0;i<d.length-1;i++)"
+    "document.cookie=k+ex+'; domain=.'+d.slice(i).join('.')})};rm();window.addEventListener('beforeunload',rm)}" },
+  { "refresh-defuser", "", "",
+    "function(){var run=function(){var m=document.querySelector('meta[http-equiv=\"refresh\" i]');if(m)m.remove()};"
+    "if(document.readyState==='loading')document.addEventListener('DOMContentLoaded',run,{once:true});else run()}" },
+  { "noeval", "", "",
+    "function(){window.eval=new Proxy(window.eval,{apply:function(){}})}" },
+  { "no-window-open-if", "nowoif window.open-defuser prevent-window-open", "P",
+    "function(n){n=n||'';var nn=n.charAt(0)==='!';if(nn)n=n.slice(1);var re=P(n);"
+    "window.open=new Proxy(window.open,{apply:function(f,self,a){if(re.test(String(a[0]))!==nn)return null;"
+    "return Reflect.apply(f,self,a)}})}" },
+};
+
+#define N_SCRIPTLETS (sizeof(SCRIPTLETS) / sizeof(SCRIPTLETS[0]))
+
+const Scriptlet* scriptlet_lookup(const char *name, gsize len) {
+  if (len > 3 && memcmp(name + len - 3, ".js", 3) == 0) len -= 3;
+  for (guint i = 0; i < N_SCRIPTLETS; i++) {
+    if ((strlen(SCRIPTLETS[i].name) == len && memcmp(SCRIPTLETS[i].name, name, len) == 0) ||
+        url_word_in_list(SCRIPTLETS[i].aliases, name, len)) {
+      return &SCRIPTLETS[i];
+    }
+  }
+  return NULL;
+}
+
+const char* scriptlet_get_name(const Scriptlet *scriptlet) {
+  return scriptlet->name;
+}
+
+// JSON string literal, also valid JavaScript
+static void append_js_string(GString *out, const char *text) {
+  g_string_append_c(out, '"');
+  for (const guchar *p = (const guchar *)text; *p; p++) {
+    if (*p == '"' || *p == '\\') {
+      g_string_append_c(out, '\\');
+      g_string_append_c(out, *p);
+    } else if (*p < 0x20 || (*p == 0xe2 && p[1] == 0x80 && (p[2] == 0xa8 || p[2] == 0xa9))) {
+      // Control characters, and U+2028/U+2029 which end lines in older engines
+      if (*p == 0xe2) {
+        g_string_append_printf(out, "\\u%04x", p[2] == 0xa8 ? 0x2028 : 0x2029);
+        p += 2;
+      } else {
+        g_string_append_printf(out, "\\u%04x", *p);
+      }
+    } else {
+      g_string_append_c(out, *p);
+    }
+  }
+  g_string_append_c(out, '"');
+}
+
+gchar* scriptlet_build_script(const char * const *calls, guint n_calls) {
+  gint slots[N_SCRIPTLETS];
+  gboolean helpers[N_HELPERS] = { FALSE };
+  guint n_used = 0;
+  for (guint i = 0; i < N_SCRIPTLETS; i++) slots[i] = -1;
+
+  GString *invocations = g_string_new(NULL);
+  for (guint i = 0; i < n_calls; i++) {
+    gchar **parts = g_strsplit(calls[i], "\t", -1);
+    const Scriptlet *scriptlet = parts[0] ? scriptlet_lookup(parts[0], strlen(parts[0])) : NULL;
+    if (scriptlet) {
+      guint index = scriptlet - SCRIPTLETS;
+      if (slots[index] < 0) {
+        slots[index] = n_used++;
+        for (guint h = 0; h < N_HELPERS; h++) {
+          helpers[h] |= strchr(scriptlet->helpers, HELPERS[h].name) != NULL;
+        }
+      }
+      g_string_append_printf(invocations, "try{s%d(", slots[index]);
+      for (int a = 1; parts[a] != NULL; a++) {
+        if (a > 1) g_string_append_c(invocations, ',');
+        append_js_string(invocations, parts[a]);
+      }
+      g_string_append(invocations, ")}catch(e){}\n");
+    }
+    g_strfreev(parts);
+  }
+
+  if (n_used == 0) {
+    g_string_free(invocations, TRUE);
+    return NULL;
+  }
+
+  GString *script = g_string_new("(function(){'use strict';\n");
+  for (guint h = 0; h < N_HELPERS; h++) {
+    if (helpers[h]) g_string_append_printf(script, "var %c=%s;\n", HELPERS[h].name, HELPERS[h].body);
+  }
+  for (guint i = 0; i < N_SCRIPTLETS; i++) {
+    if (slots[i] >= 0) g_string_append_printf(script, "var s%d=%s;\n", slots[i], SCRIPTLETS[i].body);
+  }
+  g_string_append_len(script, invocations->str, invocations->len);
+  g_string_append(script, "})();\n");
+  g_string_free(invocations, TRUE);
+  return g_string_free(script, FALSE);
+}
+
+guint scriptlet_get_count() {
+  return N_SCRIPTLETS;
+}
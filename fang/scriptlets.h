@@ -0,0 +1,29 @@
+#ifndef SCRIPTLETS_H
+#define SCRIPTLETS_H
+
+#include <glib.h>
+
+// Bundled scriptlets for "example.com##+js(name, args...)" filters: small
+// pre-minified functions neutralizing a page script (set-constant,
+// abort-on-property-read, no-fetch-if, json-prune, ...) by the uBlock
+// Origin names and aliases. trusted-* scriptlets and those rewriting page
+// code are not bundled; filters using them are skipped.
+typedef struct Scriptlet Scriptlet;
+
+// Scriptlet by name or alias, with or without ".js"; NULL if not bundled
+const Scriptlet* scriptlet_lookup(const char *name, gsize len);
+
+// Canonical name ("set-constant" for "set")
+const char* scriptlet_get_name(const Scriptlet *scriptlet);
+
+// Script running calls in order at document start (free with g_free).
+// Each call is a canonical name followed by its arguments, separated by
+// tabs. Only the scriptlets and helpers the calls use are included; each
+// call is isolated so one failing does not stop the others. NULL if no
+// call names a bundled scriptlet.
+gchar* scriptlet_build_script(const char * const *calls, guint n_calls);
+
+// Number of bundled scriptlets
+guint scriptlet_get_count();
+
+#endif // SCRIPTLETS_H
@@ -0,0 +1,148 @@
+#include "site_allowlist.h"
+#include <string.h>
+
+// Longest domain name
+#define MAX_DOMAIN_LEN 253
+
+// Domains, owned by the table. Readers take the lock shared; an empty
+// list is seen through site_count without locking at all.
+static GHashTable *sites = NULL;
+static GRWLock sites_lock;
+static gint site_count = 0;
+
+// Entries end up in content blocker JSON and URL patterns, so only plain
+// host names are accepted
+static gboolean is_domain_text(const char *text) {
+  gsize len = strlen(text);
+  if (len == 0 || len > MAX_DOMAIN_LEN) return FALSE;
+  for (gsize i = 0; i < len; i++) {
+    if (!g_ascii_isalnum(text[i]) && text[i] != '-' && text[i] != '.' && text[i] != '_') return FALSE;
+  }
+  return TRUE;
+}
+
+static GHashTable* get_sites() {
+  if (!sites) {
+    sites = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  }
+  return sites;
+}
+
+guint site_allowlist_load(const char *path) {
+  gchar *contents = NULL;
+  g_file_get_contents(path, &contents, NULL, NULL);
+
+  g_rw_lock_writer_lock(&sites_lock);
+  GHashTable *table = get_sites();
+  g_hash_table_remove_all(table);
+  gchar **lines = g_strsplit(contents ? contents : "", "\n", -1);
+  for (int i = 0; lines[i] != NULL; i++) {
+    gchar *line = g_strstrip(lines[i]);
+    if (line[0] == '#' || !is_domain_text(line)) continue;
+    g_hash_table_add(table, g_ascii_strdown(line, -1));
+  }
+  g_strfreev(lines);
+  g_atomic_int_set(&site_count, (gint)g_hash_table_size(table));
+  g_rw_lock_writer_unlock(&sites_lock);
+
+  g_free(contents);
+  return site_allowlist_get_count();
+}
+
+gboolean site_allowlist_save(const char *path) {
+  gchar **domains = site_allowlist_get_domains();
+  GString *out = g_string_new("# Sites with blocking turned off, one registrable domain per line\n");
+  for (int i = 0; domains[i] != NULL; i++) {
+    g_string_append_printf(out, "%s\n", domains[i]);
+  }
+  g_strfreev(domains);
+
+  GError *error = NULL;
+  gboolean ok = g_file_set_contents(path, out->str, out->len, &error);
+  if (!ok) {
+    g_warning("Site Allowlist: Cannot write %s: %s", path, error->message);
+    g_error_free(error);
+  }
+  g_string_free(out, TRUE);
+  return ok;
+}
+
+gchar* site_allowlist_domain_for_uri(const char *uri) {
+  if (!uri) return NULL;
+  ParsedUrl url;
+  gboolean parsed = url_parser_parse(&url, uri);
+  gchar *domain = parsed && url.domain.len ? g_strndup(url_span_lower(&url, url.domain), url.domain.len)
+                                           : NULL;
+  url_parser_clear(&url);
+  return domain;
+}
+
+gboolean site_allowlist_add(const char *domain) {
+  if (!domain || !is_domain_text(domain)) return FALSE;
+
+  g_rw_lock_writer_lock(&sites_lock);
+  gboolean added = g_hash_table_add(get_sites(), g_ascii_strdown(domain, -1));
+  g_atomic_int_set(&site_count, (gint)g_hash_table_size(sites));
+  g_rw_lock_writer_unlock(&sites_lock);
+  return added;
+}
+
+gboolean site_allowlist_remove(const char *domain) {
+  if (!domain) return FALSE;
+
+  gchar *key = g_ascii_strdown(domain, -1);
+  g_rw_lock_writer_lock(&sites_lock);
+  gboolean removed = g_hash_table_remove(get_sites(), key);
+  g_atomic_int_set(&site_count, (gint)g_hash_table_size(sites));
+  g_rw_lock_writer_unlock(&sites_lock);
+  g_free(key);
+  return removed;
+}
+
+gboolean site_allowlist_contains_domain(const char *domain, gsize len) {
+  if (g_atomic_int_get(&site_count) == 0 || !domain || len == 0 || len > MAX_DOMAIN_LEN) {
+    return FALSE;
+  }
+
+  // Domain spans of a parsed URL are not terminated
+  char key[MAX_DOMAIN_LEN + 1];
+  memcpy(key, domain, len);
+  key[len] = '\0';
+
+  g_rw_lock_reader_lock(&sites_lock);
+  gboolean found = sites && g_hash_table_contains(sites, key);
+  g_rw_lock_reader_unlock(&sites_lock);
+  return found;
+}
+
+gboolean site_allowlist_contains(const ParsedUrl *url) {
+  if (!url) return FALSE;
+  return site_allowlist_contains_domain(url_span_lower(url, url->domain), url->domain.len);
+}
+
+// g_ptr_array_sort passes pointers to the elements
+static gint compare_domains(gconstpointer a, gconstpointer b) {
+  return strcmp(*(const char * const *)a, *(const char * const *)b);
+}
+
+gchar** site_allowlist_get_domains() {
+  g_rw_lock_reader_lock(&sites_lock);
+  GPtrArray *domains = g_ptr_array_new();
+  if (sites) {
+    GHashTableIter iter;
+    gpointer key;
+    g_hash_table_iter_init(&iter, sites);
+    while (g_hash_table_iter_next(&iter, &key, NULL)) {
+      g_ptr_array_add(domains, g_strdup((const char *)key));
+    }
+  }
+  g_rw_lock_reader_unlock(&sites_lock);
+
+  g_ptr_array_sort(domains, compare_domains);
+  g_ptr_array_add(domains, NULL);
+  return (gchar **)g_ptr_array_free(domains, FALSE);
+}
+
+guint site_allowlist_get_count() {
+  return (guint)g_atomic_int_get(&site_count);
+}
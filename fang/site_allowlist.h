@@ -0,0 +1,41 @@
+#ifndef SITE_ALLOWLIST_H
+#define SITE_ALLOWLIST_H
+
+#include "url_parser.h"
+
+// Sites the user turned blocking off for, stored as registrable domains
+// ("example.co.uk") in a hash set, so a page is checked with one lookup
+// before any blocking layer runs. The browser edits the list; web
+// processes reload it from the same file when told it changed.
+
+// Name of the allowlist file in the adblock data directory
+#define SITE_ALLOWLIST_FILE "site_allowlist.txt"
+
+// Load the allowlist file, replacing the current entries. A missing file
+// is an empty list. Returns the number of sites.
+guint site_allowlist_load(const char *path);
+
+// Write the entries, one domain per line
+gboolean site_allowlist_save(const char *path);
+
+// Registrable domain of a page URL (free with g_free), NULL if it has no host
+gchar* site_allowlist_domain_for_uri(const char *uri);
+
+// Add or remove a registrable domain. Returns FALSE if nothing changed or
+// domain is not a plain host name.
+gboolean site_allowlist_add(const char *domain);
+gboolean site_allowlist_remove(const char *domain);
+
+// Check if blocking is off on the page at url. Safe from any thread.
+gboolean site_allowlist_contains(const ParsedUrl *url);
+
+// Same check for a lowercase registrable domain
+gboolean site_allowlist_contains_domain(const char *domain, gsize len);
+
+// Sorted copy of the entries (free with g_strfreev)
+gchar** site_allowlist_get_domains();
+
+// Number of sites
+guint site_allowlist_get_count();
+
+#endif // SITE_ALLOWLIST_H
@@ -0,0 +1,210 @@
+#include "snapshot.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+// Bump whenever a section layout, the filters the engines accept, or what
+// they store for them change
+#define SNAPSHOT_VERSION 6
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+#define SNAPSHOT_ALIGN 8
+
+static const char SNAPSHOT_MAGIC[8] = { 'V', 'X', 'B', 'S', 'N', 'A', 'P', '\0' };
+
+typedef struct {
+  char magic[8];
+  guint32 version;
+  guint32 byte_order;     // files from another architecture are rejected
+  guint32 kind;
+  guint32 n_sections;
+  guint64 source_key;
+} SnapshotHeader;
+
+typedef struct {
+  guint32 id;
+  guint32 reserved;
+  guint64 offset;         // from the start of the file
+  guint64 length;
+} SnapshotSection;
+
+struct SnapshotWriter {
+  SnapshotKind kind;
+  guint64 source_key;
+  GArray *sections;       // offsets relative to data until saved
+  GString *data;
+};
+
+struct Snapshot {
+  GMappedFile *file;
+  const char *data;
+  const SnapshotSection *sections;
+  guint32 n_sections;
+};
+
+static guint64 key_add_bytes(guint64 key, const void *data, gsize len) {
+  const guchar *p = (const guchar *)data;
+  for (gsize i = 0; i < len; i++) {
+    key ^= p[i];
+    key *= 1099511628211ull;
+  }
+  return key;
+}
+
+guint64 snapshot_key_add_string(guint64 key, const char *s) {
+  if (!s) s = "";
+  // Include the terminator so ("ab", "c") and ("a", "bc") differ
+  return key_add_bytes(key, s, strlen(s) + 1);
+}
+
+guint64 snapshot_key_add_file(guint64 key, const char *path) {
+  key = snapshot_key_add_string(key, path);
+
+  GStatBuf st;
+  gint64 stamp[2] = { -1, -1 };
+  if (path && g_stat(path, &st) == 0) {
+    stamp[0] = (gint64)st.st_size;
+    stamp[1] = (gint64)st.st_mtime;
+  }
+  return key_add_bytes(key, stamp, sizeof(stamp));
+}
+
+gchar* snapshot_build_path(const char *name) {
+  return g_strdup_printf("%s/.local/share/vaxp-browser/adblock/%s", g_get_home_dir(), name);
+}
+
+SnapshotWriter* snapshot_writer_new(SnapshotKind kind, guint64 source_key) {
+  SnapshotWriter *writer = g_new0(SnapshotWriter, 1);
+  writer->kind = kind;
+  writer->source_key = source_key;
+  writer->sections = g_array_new(FALSE, FALSE, sizeof(SnapshotSection));
+  writer->data = g_string_new(NULL);
+  return writer;
+}
+
+static void pad(GString *data) {
+  while (data->len % SNAPSHOT_ALIGN != 0) {
+    g_string_append_c(data, '\0');
+  }
+}
+
+void snapshot_writer_add(SnapshotWriter *writer, guint32 section, gconstpointer data, gsize len) {
+  if (!writer) return;
+
+  pad(writer->data);
+  SnapshotSection entry;
+  entry.id = section;
+  entry.reserved = 0;
+  entry.offset = writer->data->len;
+  entry.length = len;
+  g_array_append_val(writer->sections, entry);
+  if (len > 0) {
+    g_string_append_len(writer->data, (const char *)data, len);
+  }
+}
+
+gboolean snapshot_writer_save(SnapshotWriter *writer, const char *path) {
+  if (!writer || !path) return FALSE;
+
+  SnapshotHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+  header.version = SNAPSHOT_VERSION;
+  header.byte_order = SNAPSHOT_BYTE_ORDER;
+  header.kind = writer->kind;
+  header.n_sections = writer->sections->len;
+  header.source_key = writer->source_key;
+
+  GString *out = g_string_sized_new(writer->data->len + 4096);
+  g_string_append_len(out, (const char *)&header, sizeof(header));
+  gsize table_pos = out->len;
+  g_string_append_len(out, writer->sections->data,
+                      writer->sections->len * sizeof(SnapshotSection));
+  pad(out);
+
+  // Sections were laid out relative to the data block
+  gsize data_pos = out->len;
+  SnapshotSection *table = (SnapshotSection *)(void *)(out->str + table_pos);
+  for (guint i = 0; i < writer->sections->len; i++) {
+    table[i].offset += data_pos;
+  }
+  g_string_append_len(out, writer->data->str, writer->data->len);
+
+  gchar *dir = g_path_get_dirname(path);
+  g_mkdir_with_parents(dir, 0700);
+  g_free(dir);
+
+  // Written to a temporary file and renamed over the old snapshot
+  GError *error = NULL;
+  gboolean ok = g_file_set_contents(path, out->str, out->len, &error);
+  if (!ok) {
+    g_warning("Snapshot: Failed to write %s: %s", path, error->message);
+    g_error_free(error);
+  }
+  g_string_free(out, TRUE);
+  return ok;
+}
+
+void snapshot_writer_free(SnapshotWriter *writer) {
+  if (!writer) return;
+  g_array_free(writer->sections, TRUE);
+  g_string_free(writer->data, TRUE);
+  g_free(writer);
+}
+
+Snapshot* snapshot_open(const char *path, SnapshotKind kind, guint64 source_key) {
+  if (!path) return NULL;
+
+  GMappedFile *file = g_mapped_file_new(path, FALSE, NULL);
+  if (!file) return NULL;
+
+  const char *data = g_mapped_file_get_contents(file);
+  gsize length = g_mapped_file_get_length(file);
+  const SnapshotHeader *header = (const SnapshotHeader *)(const void *)data;
+
+  gboolean valid = data && length >= sizeof(SnapshotHeader) &&
+                   memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 &&
+                   header->version == SNAPSHOT_VERSION &&
+                   header->byte_order == SNAPSHOT_BYTE_ORDER &&
+                   header->kind == (guint32)kind &&
+                   header->source_key == source_key &&
+                   header->n_sections <= (length - sizeof(SnapshotHeader)) / sizeof(SnapshotSection);
+
+  const SnapshotSection *sections = NULL;
+  if (valid) {
+    sections = (const SnapshotSection *)(const void *)(data + sizeof(SnapshotHeader));
+    for (guint32 i = 0; valid && i < header->n_sections; i++) {
+      valid = sections[i].offset % SNAPSHOT_ALIGN == 0 &&
+              sections[i].offset <= length &&
+              sections[i].length <= length - sections[i].offset;
+    }
+  }
+
+  if (!valid) {
+    g_mapped_file_unref(file);
+    return NULL;
+  }
+
+  Snapshot *snapshot = g_new0(Snapshot, 1);
+  snapshot->file = file;
+  snapshot->data = data;
+  snapshot->sections = sections;
+  snapshot->n_sections = header->n_sections;
+  return snapshot;
+}
+
+gconstpointer snapshot_get_section(const Snapshot *snapshot, guint32 section, gsize *len) {
+  if (!snapshot) return NULL;
+
+  for (guint32 i = 0; i < snapshot->n_sections; i++) {
+    if (snapshot->sections[i].id == section) {
+      if (len) *len = (gsize)snapshot->sections[i].length;
+      return snapshot->data + snapshot->sections[i].offset;
+    }
+  }
+  return NULL;
+}
+
+void snapshot_close(Snapshot *snapshot) {
+  if (!snapshot) return;
+  g_mapped_file_unref(snapshot->file);
+  g_free(snapshot);
+}
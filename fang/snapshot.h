@@ -0,0 +1,52 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <glib.h>
+
+// Versioned binary snapshot of compiled blocking tables. A snapshot is a
+// header, a section table and 8-byte aligned sections holding flat arrays
+// that reference each other by offset, so it can be used straight from a
+// read-only mapping. Processes mapping the same file share its pages.
+typedef struct Snapshot Snapshot;
+typedef struct SnapshotWriter SnapshotWriter;
+
+// What a snapshot file holds
+typedef enum {
+  SNAPSHOT_KIND_ABP_ENGINE = 1,
+  SNAPSHOT_KIND_DOMAIN_SET = 2
+} SnapshotKind;
+
+// Initial value of a source key
+#define SNAPSHOT_KEY_INIT 14695981039346656037ull
+
+// Fold a string, or a file's path, size and modification time, into the
+// key describing a snapshot's inputs
+guint64 snapshot_key_add_string(guint64 key, const char *s);
+guint64 snapshot_key_add_file(guint64 key, const char *path);
+
+// Path of a snapshot file in the adblock data directory (free with g_free)
+gchar* snapshot_build_path(const char *name);
+
+// Start a snapshot of the given kind built from inputs described by key
+SnapshotWriter* snapshot_writer_new(SnapshotKind kind, guint64 source_key);
+
+// Append a section. The data is copied.
+void snapshot_writer_add(SnapshotWriter *writer, guint32 section, gconstpointer data, gsize len);
+
+// Write the snapshot atomically; readers keep their old mapping
+gboolean snapshot_writer_save(SnapshotWriter *writer, const char *path);
+
+// Free writer
+void snapshot_writer_free(SnapshotWriter *writer);
+
+// Map a snapshot. Returns NULL if the file is missing, corrupt, of another
+// kind or format version, or was built from different inputs.
+Snapshot* snapshot_open(const char *path, SnapshotKind kind, guint64 source_key);
+
+// Get a section's data and length, or NULL if the snapshot lacks it
+gconstpointer snapshot_get_section(const Snapshot *snapshot, guint32 section, gsize *len);
+
+// Unmap snapshot
+void snapshot_close(Snapshot *snapshot);
+
+#endif // SNAPSHOT_H
@@ -41,6 +41,7 @@ BrowserTab* create_new_tab(BrowserApp *app, const gchar *uri) {
         webkit_user_content_manager_add_filter(manager, filter);
     }
   }
+  adblocker_setup_web_view(app, tab->web_view);
   
   // Create tab label with close button
   GtkBox *label_box = GTK_BOX(gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 5));
@@ -249,6 +250,12 @@ void on_title_changed(WebKitWebView *web_view, GParamSpec *spec, BrowserApp *app
 }
 
 void on_load_changed(WebKitWebView *web_view, WebKitLoadEvent load_event, BrowserApp *app) {
+  // Element hiding and scriptlets follow the page to its host, in background
+  // tabs too
+  if (load_event != WEBKIT_LOAD_FINISHED) {
+    adblocker_update_site_filters(app, web_view);
+  }
+  
   BrowserTab *tab = NULL;
   GList *iter;
   
@@ -306,11 +313,21 @@ gboolean on_decide_policy(WebKitWebView *web_view, WebKitPolicyDecision *decisio
     WebKitURIRequest *request = webkit_navigation_action_get_request(action);
     const char *uri = webkit_uri_request_get_uri(request);
     
-    // Check if URL should be blocked
-    if (should_block_request(uri)) {
+    // Check if URL should be blocked as a page navigation. The decision does
+    // not tell the main frame from a subframe, so every navigation is judged
+    // as a document; the web extension checks frame loads again with their
+    // real type. A document is its own first party: the page being left has
+    // no say in $domain= or $third-party.
+    RequestContext context;
+    context.uri = uri;
+    context.first_party = uri;
+    context.type = ABP_TYPE_DOCUMENT;
+    context.third_party = 0;
+    if (should_block_request_context(&context, NULL)) {
       app->blocked_requests_count++;
       if (app->blocked_requests_count % 100 == 0) {
         g_print("Network Blocker: Blocked %lu requests\n", app->blocked_requests_count);
+        network_blocker_log_cache_stats();
       }
       webkit_policy_decision_ignore(decision);
       return TRUE;
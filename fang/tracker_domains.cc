@@ -1,373 +1,181 @@
 #include "tracker_domains.h"
+#include "domain_set.h"
+#include "snapshot.h"
+#include "perfect_hash.h"
+#include <glib.h>
 #include <string.h>
-#include <strings.h>
 
-// Enhanced comprehensive list of 400+ tracker, ad, and analytics domains
-// Based on EasyList, EasyPrivacy, Fanboy Lists, and industry standards
-// https://easylist.to/
-const char *TRACKER_DOMAINS[] = {
-  // ========== GOOGLE (EasyList/EasyPrivacy) ==========
-  "doubleclick.net",
-  "googlesyndication.com",
-  "google-analytics.com",
-  "googleadservices.com",
-  "googletagmanager.com",
-  "googletagservices.com",
-  "2mdn.net",
-  "admob.com",
-  "adservice.google.com",
-  "adsense.google.com",
-  "imasdk.googleapis.com",
-  "pagead.l.google.com",
-  "pagead.googlesyndication.com",
-  "tpc.googlesyndication.com",
-  "csi.gstatic.com",
-  
-  // ========== FACEBOOK/META ==========
-  "facebook.net",
-  "facebook.com/tr",
-  "connect.facebook.net",
-  "fbcdn.net/tr",
-  "instagram.com/logging",
-  "instagram.net",
-  "whatsapp.net/contact",
-  "liverail.com",
-  "atdmt.com",
-  
-  // ========== AMAZON ==========
-  "amazon-adsystem.com",
-  "amazonaax.com",
-  "assoc-amazon.com",
-  "aax-us-east.amazon-adsystem.com",
-  "aax-us-west.amazon-adsystem.com",
-  "aax-eu-west.amazon-adsystem.com",
-  
-  // ========== MAJOR AD NETWORKS (EasyList) ==========
-  "adnxs.com",
-  "adsrvr.org",
-  "advertising.com",
-  "adform.net",
-  "adtech.de",
-  "adtechus.com",
-  "criteo.com",
-  "criteo.net",
-  "pubmatic.com",
-  "openx.net",
-  "rubiconproject.com",
-  "indexww.com",
-  "smartadserver.com",
-  "spotxchange.com",
-  "contextweb.com",
-  "casalemedia.com",
-  "33across.com",
-  "gumgum.com",
-  "sharethrough.com",
-  "bidswitch.net",
-  "sovrn.com",
-  "lijit.com",
-  "connexity.net",
-  "zemanta.com",
-  "outbrain.com",
-  "taboola.com",
-  "revcontent.com",
-  "mgid.com",
-  "adblade.com",
-  "gravity.com",
-  "nativo.com",
-  
-  // ========== ANALYTICS & TRACKING (EasyPrivacy) ==========
-  "scorecardresearch.com",
-  "quantserve.com",
-  "moatads.com",
-  "bluekai.com",
-  "crwdcntrl.net",
-  "mathtag.com",
-  "rlcdn.com",
-  "semasio.net",
-  "exelator.com",
-  "krxd.net",
-  "parsely.com",
-  "chartbeat.com",
-  "newrelic.com",
-  "nr-data.net",
-  "omniture.com",
-  "2o7.net",
-  "omtrdc.net",
-  "demdex.net",
-  "everesttech.net",
-  "adobedtm.com",
-  
-  // ========== SESSION RECORDING & HEATMAPS ==========
-  "hotjar.com",
-  "mouseflow.com",
-  "inspectlet.com",
-  "clicktale.net",
-  "sessioncam.com",
-  "smartlook.com",
-  "loggly.com",
-  "fullstory.com",
-  "crazyegg.com",
-  
-  // ========== A/B TESTING & OPTIMIZATION ==========
-  "optimizely.com",
-  "vwo.com",
-  "convert.com",
-  "kameleoon.com",
-  "abtasty.com",
-  "ab-tasty.com",
-  "unbounce.com",
-  "instapage.com",
-  "leadpages.com",
-  
-  // ========== VIDEO TRACKING (EasyList) ==========
-  "teads.tv",
-  "stickyadstv.com",
-  "videohub.tv",
-  "brightcove.net",
-  "fwmrm.net",
-  "innovid.com",
-  "tubemogul.com",
-  "apivideo.com",
-  
-  // ========== SOCIAL MEDIA TRACKING (Fanboy Lists) ==========
-  "twitter.com/i/adsct",
-  "ads-twitter.com",
-  "analytics.twitter.com",
-  "t.co/tracking",
-  "linkedin.com/px",
-  "linkedin.com/analytics",
-  "snap.licdn.com",
-  "ct.pinterest.com",
-  "reddit.com/api/v1/pixel",
-  "redditmedia.com/gtm",
-  "reddit.com/r/reddit.com",
-  "tiktok.com/analytics",
-  "youtube.com/s/player",
-  "youtube.com/generate_204",
-  
-  // ========== DATA BROKERS & PROFILING ==========
-  "acxiom.com",
-  "axciom.com",
-  "datalogix.com",
-  "epsilon.com",
-  "liveramp.com",
-  "neustar.biz",
-  "exelator.com",
-  "tapad.com",
-  "placeiq.com",
-  
-  // ========== MOBILE APP TRACKING ==========
-  "appsflyer.com",
-  "branch.io",
-  "adjust.com",
-  "kochava.com",
-  "singular.net",
-  "tenjin.com",
-  "tune.com",
-  "apsalar.com",
-  "localytics.com",
-  "urbanairship.com",
-  "leanplum.com",
-  "braze.com",
-  "appboy.com",
-  "clevertap.com",
-  "moengage.com",
-  "webengage.com",
-  "amplitude.com",
-  "mixpanel.com",
-  "segment.com",
-  "segment.io",
-  
-  // ========== PUSH NOTIFICATIONS ==========
-  "onesignal.com",
-  "pushwoosh.com",
-  "pushcrew.com",
-  "subscribers.com",
-  "webpushr.com",
-  "pushy.me",
-  "oneall.com",
-  
-  // ========== FINGERPRINTING SERVICES ==========
-  "fingerprintjs.com",
-  "iovation.com",
-  "threatmetrix.com",
-  "siftscience.com",
-  "perimeterx.com",
-  "imperva.com",
-  "cloudflare.com",
-  
-  // ========== AFFILIATE NETWORKS ==========
-  "awin1.com",
-  "commission-junction.com",
-  "cj.com",
-  "linksynergy.com",
-  "shareasale.com",
-  "pepperjam.com",
-  "rakuten.com",
-  "impact.com",
-  "partnerize.com",
-  "flexlinks.com",
-  "tradetracker.com",
-  "tradedoubler.com",
-  
-  // ========== RETARGETING & REMARKETING ==========
-  "adroll.com",
-  "perfectaudience.com",
-  "retargetly.com",
-  "chango.com",
-  "fetchback.com",
-  "rocket-fuel.com",
-  "turn.com",
-  "nexac.com",
-  "sakura.ad",
-  
-  // ========== MOBILE ADVERTISING ==========
-  "applovin.com",
-  "vungle.com",
-  "chartboost.com",
-  "tapjoy.com",
-  "inmobi.com",
-  "millennialmedia.com",
-  "mobfox.com",
-  "smaato.com",
-  "startapp.com",
-  "flurry.com",
-  
-  // ========== POP-UPS & REDIRECT NETWORKS ==========
-  "popads.net",
-  "popcash.net",
-  "propellerads.com",
-  "adcash.com",
-  "exoclick.com",
-  "trafficjunky.net",
-  "plugrush.com",
-  "juicyads.com",
-  "redtube-advertising.com",
-  
-  // ========== CONTENT DISTRIBUTION NETWORKS (CDN) ==========
-  "cloudflare.com",
-  "akamai.com",
-  "cloudfront.amazonaws.com",
-  "fastly.com",
-  "edgecast.com",
-  
-  // ========== MICROSOFT/WINDOWS ADVERTISING ==========
-  "advertising.microsoft.com",
-  "ads.microsoft.com",
-  "bat.bing.com",
-  "clarity.ms",
-  "atdmt.com",
-  "gemini.yahoo.com",
-  "ads.yahoo.com",
-  
-  // ========== CHINESE AD NETWORKS ==========
-  "baidu.com/union",
-  "tanx.com",
-  "alimama.com",
-  "mmstat.com",
-  "umeng.com",
-  "cnzz.com",
-  "tencent.com/analytics",
-  "qq.com/analytics",
-  
-  // ========== RUSSIAN AD NETWORKS ==========
-  "yandex.ru/ads",
-  "adfox.ru",
-  "begun.ru",
-  "adriver.ru",
-  "doubleclick.ru",
-  
-  // ========== EUROPEAN AD NETWORKS ==========
-  "adition.com",
-  "stroeer.de",
-  "plista.com",
-  "ligatus.com",
-  "nuggad.net",
-  "tradedoubler.com",
-  
-  // ========== GLOBAL TRACKERS ==========
-  "addthis.com",
-  "sharethis.com",
-  "viglink.com",
-  "skimlinks.com",
-  "apmebf.com",
-  "serving-sys.com",
-  "adserver.com",
-  "adserve.com",
-  "adsystem.com",
-  "adtech.com",
-  "yieldmanager.com",
-  "admeld.com",
-  "admixer.net",
-  "adsafeprotected.com",
-  "doubleverify.com",
-  "integral-marketing.com",
-  "voicefive.com",
-  "analytics.yahoo.com",
-  
-  // ========== VERIFICATION & FRAUD PREVENTION ==========
-  "adidas.com/verify",
-  "fraud-detection.com",
-  "device-fingerprint.com",
-  "verify-user.com",
-  
-  // ========== EMAIL TRACKING ==========
-  "open.track.com",
-  "track.email",
-  "email-tracking.com",
-  "readnotify.com",
-  "bananatag.com",
-  "mailtrack.io",
-  "sidekick.mailchimp.com",
-  
-  // ========== COOKIE CONSENT & GDPR ==========
-  "cookieconsent.com",
-  "onetrust.com",
-  "trustarc.com",
-  "consentmanager.de",
-  "consentmanager.net",
-  
-  // ========== MEASUREMENT & REPORTING ==========
-  "chartio.com",
-  "tableau.com",
-  "powerbi.microsoft.com",
-  "looker.com",
-  "google.com/analytics",
-  
-  // ========== DYNAMIC PRICING & PERSONALIZATION ==========
-  "evergage.com",
-  "contentsquare.com",
-  "contentsquare-prod.com",
-  "contentsquare.fr",
-  
-  // ========== ADDITIONAL HIGH-RISK DOMAINS ==========
-  "privacy-dashboard.com",
-  "tracking-prevention.com",
-  "conversion-tracking.com",
-  "user-behavior.com",
-  "audience-targeting.com",
-  "data-collection.com",
-  "profile-sync.com",
-  "rtb-sync.com",
-  "bid-request.com",
-  "programmatic.com",
-  
-  NULL  // Sentinel value
-};
+// Built-in domain of the generated table. n_paths is 0 when the whole
+// domain is listed, otherwise its entries are paths[0 .. n_paths).
+typedef struct {
+  const char *domain;   // NULL for an empty slot
+  guint8 len;
+  guint16 paths;
+  guint16 n_paths;
+} BuiltinDomain;
+
+// Path-restricted built-in entry, e.g. "facebook.com/tr"
+typedef struct {
+  const char *text;
+  guint16 prefix_len;   // length of the path part
+} BuiltinPath;
+
+// TRACKER_DOMAINS and its perfect-hash table, compiled from
+// fang/lists/tracker_domains.txt by tools/gen_tables.py
+#include "tracker_domains_data.inc"
+
+// Built-in entry matching a lowercase host (or a path under it), or NULL.
+// One probe per label, whatever the size of the list.
+static const char* builtin_domain_match(const char *host, gsize host_len, const char *path,
+                                        gsize path_len) {
+  gsize start = 0;
+  while (start < host_len) {
+    const char *label = host + start;
+    gsize len = host_len - start;
+    guint32 slot = perfect_hash_slot(label, len, TRACKER_DOMAINS_DISPLACEMENTS,
+                                     TRACKER_DOMAINS_BUCKET_COUNT, TRACKER_DOMAINS_TABLE_SIZE);
+    const BuiltinDomain *entry = &TRACKER_DOMAINS_TABLE[slot];
+
+    if (entry->domain && entry->len == len && memcmp(entry->domain, label, len) == 0) {
+      if (entry->n_paths == 0) return entry->domain;
+      for (guint i = entry->paths; i < (guint)entry->paths + entry->n_paths; i++) {
+        const BuiltinPath *prefix = &TRACKER_DOMAINS_PATHS[i];
+        if (path && path_len >= prefix->prefix_len &&
+            g_ascii_strncasecmp(path, prefix->text + len, prefix->prefix_len) == 0) {
+          return prefix->text;
+        }
+      }
+    }
 
-// Count tracker domains
-const int TRACKER_DOMAINS_COUNT = sizeof(TRACKER_DOMAINS) / sizeof(TRACKER_DOMAINS[0]) - 1;
+    const char *dot = (const char *)memchr(label, '.', len);
+    if (!dot) break;
+    start = (gsize)(dot - host) + 1;
+  }
+  return NULL;
+}
+
+// Suffix set of the loaded blocklists, minus what the built-in table covers
+static DomainSet *tracker_set = NULL;
 
-// Check if URL contains a tracker domain
+static DomainSet* get_tracker_set() {
+  if (!tracker_set) {
+    tracker_set = domain_set_new();
+  }
+  return tracker_set;
+}
+
+// Look up the URL's host label by label: O(number of labels), matching
+// only the exact domain or its subdomains
+const char* tracker_domain_match(const ParsedUrl *url) {
+  if (!url || url->host.len == 0) return NULL;
+
+  // Path-restricted entries see the rest of the URL after the host
+  const char *host = url_span_lower(url, url->host);
+  gsize path_start = url->host.start + url->host.len;
+  path_start += strcspn(url->url + path_start, "/?#");
+  const char *path = url->url + path_start;
+  gsize path_len = url->len - path_start;
+
+  const char *entry = builtin_domain_match(host, url->host.len, path, path_len);
+  if (entry) return entry;
+  return domain_set_match(get_tracker_set(), host, url->host.len, path, path_len);
+}
+
+// Check if URL's host is a tracker domain
 // Returns 1 if tracker found, 0 otherwise
-int is_tracker_domain(const char *url) {
-  if (!url) return 0;
+int is_tracker_domain(const ParsedUrl *url) {
+  return tracker_domain_match(url) != NULL;
+}
+
+// Add one entry of a list file: a domain, or "||example.com^" with no options
+static void add_list_entry(DomainSet *set, gchar *entry) {
+  if (g_str_has_prefix(entry, "||")) {
+    entry += 2;
+    gsize len = strlen(entry);
+    if (len == 0 || entry[len - 1] != '^') return;
+    entry[len - 1] = '\0';
+  }
+
+  if (strcmp(entry, "localhost") == 0 || strcmp(entry, "0.0.0.0") == 0) return;
   
-  for (int i = 0; TRACKER_DOMAINS[i] != NULL; i++) {
-    if (strcasestr(url, TRACKER_DOMAINS[i]) != NULL) {
-      return 1;
+  // Domains under a built-in entry would never be reached
+  if (!strchr(entry, '/') && builtin_domain_match(entry, strlen(entry), NULL, 0)) return;
+  domain_set_add(set, entry);
+}
+
+int tracker_domains_load_file(const char *path) {
+  gchar *contents = NULL;
+  if (!g_file_get_contents(path, &contents, NULL, NULL)) {
+    return 0;
+  }
+
+  DomainSet *set = get_tracker_set();
+  guint before = domain_set_size(set);
+  gchar **lines = g_strsplit(contents, "\n", -1);
+
+  for (int i = 0; lines[i] != NULL; i++) {
+    gchar *line = lines[i];
+    
+    // Trailing "# comment"; a '#' inside a field is not one ("##" hiding rules)
+    for (gchar *hash = strchr(line, '#'); hash; hash = strchr(hash + 1, '#')) {
+      if (hash == line || hash[-1] == ' ' || hash[-1] == '\t') {
+        *hash = '\0';
+        break;
+      }
+    }
+    g_strstrip(line);
+    if (line[0] == '\0' || line[0] == '!' || line[0] == '[') continue;
+
+    gchar **fields = g_strsplit_set(line, " \t", -1);
+    gint n_fields = 0;
+    for (int j = 0; fields[j] != NULL; j++) {
+      if (fields[j][0] != '\0') fields[n_fields++] = fields[j];
+      else g_free(fields[j]);
     }
+    fields[n_fields] = NULL;
+    
+    // Hosts file format: "0.0.0.0 example.com www.example.com"
+    if (n_fields > 1 && g_hostname_is_ip_address(fields[0])) {
+      for (int j = 1; j < n_fields; j++) add_list_entry(set, fields[j]);
+    } else if (n_fields > 0) {
+      add_list_entry(set, fields[0]);
+    }
+    g_strfreev(fields);
   }
-  
-  return 0;
+
+  g_strfreev(lines);
+  g_free(contents);
+  return (int)(domain_set_size(set) - before);
+}
+
+int tracker_domains_load_cached(const char *path) {
+  // The built-in list decides which entries of the file are kept
+  guint64 key = SNAPSHOT_KEY_INIT;
+  for (int i = 0; TRACKER_DOMAINS[i] != NULL; i++) {
+    key = snapshot_key_add_string(key, TRACKER_DOMAINS[i]);
+  }
+  key = snapshot_key_add_file(key, path);
+
+  gchar *snapshot_path = snapshot_build_path("tracker_domains.snapshot");
+  DomainSet *mapped = domain_set_open_snapshot(snapshot_path, key);
+  if (mapped) {
+    domain_set_free(tracker_set);
+    tracker_set = mapped;
+    g_print("Tracker Domains: Mapped snapshot %s\n", snapshot_path);
+  } else {
+    tracker_domains_load_file(path);
+    domain_set_save_snapshot(get_tracker_set(), snapshot_path, key);
+  }
+  g_free(snapshot_path);
+
+  gsize prefilter_size = 0;
+  double prefilter_fpr = 0.0;
+  domain_set_get_prefilter_stats(get_tracker_set(), &prefilter_size, &prefilter_fpr);
+  g_print("Tracker Domains: Prefilter uses %.1f KiB, %.2f%% false positives\n",
+          prefilter_size / 1024.0, prefilter_fpr * 100.0);
+  return tracker_domains_get_count();
+}
+
+int tracker_domains_get_count() {
+  return (int)(TRACKER_DOMAINS_COUNT + domain_set_size(get_tracker_set()));
 }
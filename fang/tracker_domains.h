@@ -1,12 +1,32 @@
 #ifndef TRACKER_DOMAINS_H
 #define TRACKER_DOMAINS_H
 
-// Comprehensive list of tracker and ad domains
-// This list includes 200+ known tracking and advertising domains
+#include "url_parser.h"
+
+// Built-in tracker and ad domains (NULL-terminated), generated from
+// fang/lists/tracker_domains.txt into a perfect-hash table that needs no
+// initialization. Blocklist files are loaded into a suffix set next to it.
 extern const char *TRACKER_DOMAINS[];
-extern const int TRACKER_DOMAINS_COUNT;
+extern const guint TRACKER_DOMAINS_COUNT;
+
+// Check if a URL's host is a tracker domain or one of its subdomains
+int is_tracker_domain(const ParsedUrl *url);
+
+// Same as is_tracker_domain, returning the matching entry or NULL
+const char* tracker_domain_match(const ParsedUrl *url);
+
+// Load additional domains from a blocklist file (plain domains, hosts file
+// lines or "||domain^" rules). Domains the built-in list already covers
+// are skipped. Returns the number of domains added.
+int tracker_domains_load_file(const char *path);
+
+// Load a blocklist file through a compiled snapshot in the adblock data
+// directory, rebuilding it when the file or the built-in list changed.
+// Returns the number of built-in and loaded domains. Once mapped, the set
+// is read-only and tracker_domains_load_file adds nothing.
+int tracker_domains_load_cached(const char *path);
 
-// Check if a URL contains a tracker domain
-int is_tracker_domain(const char *url);
+// Number of built-in and loaded domains
+int tracker_domains_get_count();
 
 #endif // TRACKER_DOMAINS_H
@@ -11,6 +11,7 @@
 
 // Forward declaration
 typedef struct FingerprintProfile FingerprintProfile;
+typedef struct CosmeticIndex CosmeticIndex;
 
 // Tab structure
 typedef struct {
@@ -57,6 +58,15 @@ typedef struct {
   GList *active_filters; // List of WebKitUserContentFilter*
   gboolean adblock_enabled;
   gboolean privacy_enabled;
+  GtkCheckMenuItem *site_allowed_item;  // "Disable AdBlocker on This Site"
+  
+  // Element hiding: one stylesheet for every page plus one per site
+  CosmeticIndex *cosmetic_index;
+  WebKitUserStyleSheet *generic_style_sheet;
+  GHashTable *site_style_sheets;  // host -> WebKitUserStyleSheet*, NULL if nothing to hide
+  gboolean lazy_cosmetics;        // generic selectors with a class or id go on demand
+  WebKitUserScript *cosmetic_script;  // reports the class and id names of pages
+  GHashTable *site_scripts;       // host -> WebKitUserScript* of its scriptlets, NULL if none
   
   // Anti-fingerprinting
   FingerprintProfile *current_profile;
@@ -64,6 +74,11 @@ typedef struct {
   gint rotation_interval_seconds;  // 5 for aggressive rotation, 0 for per-session
   gboolean webrtc_leak_protection;
   
+  // Live filter list reloads
+  GPtrArray *filter_monitors;  // GFileMonitor per filter list
+  gboolean rules_reloading;
+  gboolean rules_reload_pending;
+  
   // Enhanced blocking statistics
   guint64 blocked_requests_count;
   time_t session_start_time;
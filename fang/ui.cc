@@ -78,6 +78,12 @@ GtkMenuBar* create_menu_bar(BrowserApp *app) {
   g_signal_connect(adblock_item, "toggled", G_CALLBACK(on_adblock_toggled), app);
   gtk_menu_shell_append(GTK_MENU_SHELL(privacy_menu), adblock_item);
   
+  GtkWidget *site_allowed_item = gtk_check_menu_item_new_with_label("Disable AdBlocker on This Site");
+  g_signal_connect(site_allowed_item, "toggled", G_CALLBACK(on_site_allowed_toggled), app);
+  gtk_menu_shell_append(GTK_MENU_SHELL(privacy_menu), site_allowed_item);
+  app->site_allowed_item = GTK_CHECK_MENU_ITEM(site_allowed_item);
+  g_signal_connect(privacy_menu, "show", G_CALLBACK(on_privacy_menu_shown), app);
+  
   GtkWidget *privacy_item = gtk_check_menu_item_new_with_label("Enable Anti-Fingerprinting");
   gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(privacy_item), app->privacy_enabled);
   g_signal_connect(privacy_item, "toggled", G_CALLBACK(on_privacy_toggled), app);
@@ -186,6 +192,27 @@ void on_adblock_toggled(GtkCheckMenuItem *item, BrowserApp *app) {
   }
 }
 
+static const char* get_current_uri(BrowserApp *app) {
+  if (!app->current_tab || !app->current_tab->web_view) return NULL;
+  return webkit_web_view_get_uri(app->current_tab->web_view);
+}
+
+// The site check item follows the current tab
+void on_privacy_menu_shown(GtkWidget *menu, BrowserApp *app) {
+  const char *uri = get_current_uri(app);
+  gtk_widget_set_sensitive(GTK_WIDGET(app->site_allowed_item), uri && g_str_has_prefix(uri, "http"));
+  g_signal_handlers_block_by_func(app->site_allowed_item, (gpointer)on_site_allowed_toggled, app);
+  gtk_check_menu_item_set_active(app->site_allowed_item, adblocker_is_site_allowed(app, uri));
+  g_signal_handlers_unblock_by_func(app->site_allowed_item, (gpointer)on_site_allowed_toggled, app);
+}
+
+void on_site_allowed_toggled(GtkCheckMenuItem *item, BrowserApp *app) {
+  const char *uri = get_current_uri(app);
+  if (uri) {
+    adblocker_set_site_allowed(app, uri, gtk_check_menu_item_get_active(item));
+  }
+}
+
 void on_privacy_toggled(GtkCheckMenuItem *item, BrowserApp *app) {
   gboolean active = gtk_check_menu_item_get_active(item);
   privacy_enable(app, active);
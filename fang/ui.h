@@ -23,5 +23,7 @@ gboolean on_window_state_changed(GtkWidget *widget, GdkEventWindowState *event,
 // Privacy callbacks
 void on_adblock_toggled(GtkCheckMenuItem *item, BrowserApp *app);
 void on_privacy_toggled(GtkCheckMenuItem *item, BrowserApp *app);
+void on_site_allowed_toggled(GtkCheckMenuItem *item, BrowserApp *app);
+void on_privacy_menu_shown(GtkWidget *menu, BrowserApp *app);
 
 #endif // UI_H
@@ -0,0 +1,203 @@
+#include "url_parser.h"
+#include "public_suffix.h"
+#include <string.h>
+
+typedef enum {
+  STATE_AUTHORITY,
+  STATE_PATH,
+  STATE_QUERY,
+  STATE_FRAGMENT
+} ParseState;
+
+static inline char fold(char c) {
+  return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static inline gboolean is_scheme_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '+' || c == '-' || c == '.';
+}
+
+static inline UrlSpan make_span(gsize start, gsize end) {
+  UrlSpan span;
+  span.start = (guint32)start;
+  span.len = end > start ? (guint32)(end - start) : 0;
+  return span;
+}
+
+// Registrable domain through the Public Suffix List, or the whole host for
+// IP addresses and hosts that are themselves public suffixes
+static UrlSpan registrable_domain(const char *lower, UrlSpan host) {
+  const char *p = lower + host.start;
+  gsize len = host.len;
+  if (len == 0 || p[0] == '[') return host;
+
+  gboolean numeric = TRUE;
+  for (gsize i = 0; i < len && numeric; i++) {
+    numeric = p[i] == '.' || (p[i] >= '0' && p[i] <= '9');
+  }
+  if (numeric) return host;
+
+  gsize domain_len = 0;
+  const char *domain = public_suffix_registrable_domain(p, len, &domain_len);
+  if (!domain) return host;
+  return make_span(host.start + (domain - p), host.start + len);
+}
+
+gboolean url_parser_parse(ParsedUrl *parsed, const char *url) {
+  parsed->url = url ? url : "";
+  parsed->len = strlen(parsed->url);
+  parsed->heap = NULL;
+  parsed->scheme = parsed->host = parsed->domain = make_span(0, 0);
+  parsed->path = parsed->extension = parsed->query = make_span(0, 0);
+
+  char *lower = parsed->buffer;
+  if (parsed->len >= sizeof(parsed->buffer)) {
+    parsed->heap = (char *)g_malloc(parsed->len + 1);
+    lower = parsed->heap;
+  }
+  parsed->lower = lower;
+
+  // One pass lowercases the URL and records the component boundaries
+  const char *s = parsed->url;
+  gsize len = parsed->len;
+  gsize host_start = 0, host_end = 0;
+  gsize path_start = len, path_end = len;
+  gsize query_start = len, query_end = len;
+  gsize last_slash = len, last_dot = len;
+  gboolean in_brackets = FALSE;
+
+  // Scheme characters are also host characters, so a URL without a scheme
+  // ("example.com/x") simply continues as authority
+  gsize i = 0;
+  while (i < len && is_scheme_char(fold(s[i]))) {
+    lower[i] = fold(s[i]);
+    i++;
+  }
+  ParseState state = STATE_AUTHORITY;
+  if (i > 0 && i < len && s[i] == ':') {
+    parsed->scheme = make_span(0, i);
+    lower[i++] = ':';
+    if (i + 1 < len && s[i] == '/' && s[i + 1] == '/') {
+      lower[i] = lower[i + 1] = '/';
+      i += 2;
+      host_start = i;
+    } else {
+      // Opaque URL (data:, about:, blob:): everything is path
+      path_start = last_slash = i;
+      state = STATE_PATH;
+    }
+  }
+  gboolean has_authority = state == STATE_AUTHORITY;
+
+  for (; i < len; i++) {
+    char c = fold(s[i]);
+    lower[i] = c;
+
+    switch (state) {
+      case STATE_AUTHORITY:
+        if (c == '/' || c == '?' || c == '#') {
+          if (!host_end) host_end = i;
+          path_start = path_end = i;
+          if (c == '/') {
+            last_slash = i;
+            state = STATE_PATH;
+          } else if (c == '?') {
+            query_start = i + 1;
+            state = STATE_QUERY;
+          } else {
+            query_end = i;
+            state = STATE_FRAGMENT;
+          }
+        } else if (c == '@') {
+          host_start = i + 1;
+          host_end = 0;
+        } else if (c == '[' && i == host_start) {
+          in_brackets = TRUE;
+        } else if (c == ']') {
+          in_brackets = FALSE;
+        } else if (c == ':' && !in_brackets && !host_end) {
+          host_end = i;
+        }
+        break;
+
+      case STATE_PATH:
+        if (c == '/') {
+          last_slash = i;
+          last_dot = len;
+        } else if (c == '.') {
+          last_dot = i;
+        } else if (c == '?' || c == '#') {
+          path_end = i;
+          if (c == '?') {
+            query_start = i + 1;
+            state = STATE_QUERY;
+          } else {
+            state = STATE_FRAGMENT;
+          }
+        }
+        break;
+
+      case STATE_QUERY:
+        if (c == '#') {
+          query_end = i;
+          state = STATE_FRAGMENT;
+        }
+        break;
+
+      case STATE_FRAGMENT:
+        break;
+    }
+  }
+  lower[len] = '\0';
+
+  if (state == STATE_AUTHORITY && !host_end) host_end = len;
+  if (state == STATE_PATH) path_end = len;
+
+  if (has_authority) {
+    if (host_end < host_start) host_end = host_start;
+    while (host_end > host_start && lower[host_end - 1] == '.') host_end--;
+    parsed->host = make_span(host_start, host_end);
+    parsed->domain = registrable_domain(lower, parsed->host);
+  }
+  if (path_start < path_end) {
+    parsed->path = make_span(path_start, path_end);
+    if (last_dot < path_end && last_dot > last_slash && last_dot + 1 < path_end) {
+      parsed->extension = make_span(last_dot + 1, path_end);
+    }
+  }
+  if (query_start < len) {
+    parsed->query = make_span(query_start, query_end);
+  }
+
+  return parsed->host.len > 0;
+}
+
+void url_parser_clear(ParsedUrl *parsed) {
+  if (!parsed) return;
+  g_free(parsed->heap);
+  parsed->heap = NULL;
+}
+
+gboolean url_span_equals(const ParsedUrl *parsed, UrlSpan span, const char *text) {
+  gsize len = strlen(text);
+  return span.len == len && memcmp(parsed->lower + span.start, text, len) == 0;
+}
+
+gboolean url_host_in_domain(const char *host, gsize len, const char *domain) {
+  gsize domain_len = strlen(domain);
+  if (domain_len > len || g_ascii_strncasecmp(host + len - domain_len, domain, domain_len) != 0) {
+    return FALSE;
+  }
+  return domain_len == len || host[len - domain_len - 1] == '.';
+}
+
+gboolean url_word_in_list(const char *list, const char *word, gsize len) {
+  for (const char *p = list; *p; ) {
+    const char *end = strchr(p, ' ');
+    gsize n = end ? (gsize)(end - p) : strlen(p);
+    if (n == len && memcmp(p, word, len) == 0) return TRUE;
+    if (!end) break;
+    p = end + 1;
+  }
+  return FALSE;
+}
@@ -0,0 +1,53 @@
+#ifndef URL_PARSER_H
+#define URL_PARSER_H
+
+#include <glib.h>
+
+// URLs up to this length are parsed without allocating
+#define URL_PARSER_BUFFER_SIZE 2048
+
+// Part of a URL: offset and length in both url and lower
+typedef struct {
+  guint32 start;
+  guint32 len;
+} UrlSpan;
+
+// URL split once into the fields the blocking layers need. Spans that are
+// absent have length 0.
+typedef struct {
+  const char *url;      // original URL, not copied
+  const char *lower;    // ASCII-lowercased copy of url, NUL-terminated
+  gsize len;
+  UrlSpan scheme;       // "https"
+  UrlSpan host;         // "ads.example.co.uk", without userinfo, port or trailing dot
+  UrlSpan domain;       // registrable domain of host, "example.co.uk"
+  UrlSpan path;         // "/js/ad.min.js", up to '?' or '#'
+  UrlSpan extension;    // "js", after the last '.' of the last path segment
+  UrlSpan query;        // "a=1&b=2", without the '?'
+
+  char buffer[URL_PARSER_BUFFER_SIZE];
+  char *heap;           // lowercase copy of longer URLs
+} ParsedUrl;
+
+// Parse url in one pass. Returns FALSE if it has no host.
+// The fields stay valid while url is alive; call url_parser_clear after.
+gboolean url_parser_parse(ParsedUrl *parsed, const char *url);
+
+// Release memory held for long URLs
+void url_parser_clear(ParsedUrl *parsed);
+
+// Pointer to a span in the lowercase copy
+static inline const char* url_span_lower(const ParsedUrl *parsed, UrlSpan span) {
+  return parsed->lower + span.start;
+}
+
+// Compare a span of the lowercase copy with a lowercase string
+gboolean url_span_equals(const ParsedUrl *parsed, UrlSpan span, const char *text);
+
+// Host equals domain or is one of its subdomains, ignoring case
+gboolean url_host_in_domain(const char *host, gsize len, const char *domain);
+
+// Word is one of the names in a space-separated list
+gboolean url_word_in_list(const char *list, const char *word, gsize len);
+
+#endif // URL_PARSER_H
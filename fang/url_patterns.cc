@@ -0,0 +1,7 @@
+#include "url_patterns.h"
+#include <stddef.h>
+
+// BLOCKED_URL_PATTERNS and BLOCKED_SCRIPT_PATTERNS, compiled from
+// fang/lists/url_patterns.txt and fang/lists/script_patterns.txt by
+// tools/gen_tables.py
+#include "url_patterns_data.inc"
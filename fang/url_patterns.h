@@ -0,0 +1,14 @@
+#ifndef URL_PATTERNS_H
+#define URL_PATTERNS_H
+
+#include <glib.h>
+
+// URL substrings blocked anywhere in a request URL (NULL-terminated)
+extern const char *BLOCKED_URL_PATTERNS[];
+extern const guint BLOCKED_URL_PATTERNS_COUNT;
+
+// Script names blocked in URLs of .js files (NULL-terminated)
+extern const char *BLOCKED_SCRIPT_PATTERNS[];
+extern const guint BLOCKED_SCRIPT_PATTERNS_COUNT;
+
+#endif // URL_PATTERNS_H
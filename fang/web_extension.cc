@@ -0,0 +1,131 @@
+#include "web_extension.h"
+#include "network_blocker.h"
+#include "adblockplus_integration.h"
+#include "snapshot.h"
+#include "rule_profiler.h"
+#include "site_allowlist.h"
+#include "redirect_resources.h"
+#include <unistd.h>
+#include <webkit2/webkit-web-extension.h>
+#include <string.h>
+
+// Blocking state of this web process, set from the browser
+static gboolean blocking_enabled = TRUE;
+static guint64 blocked_requests_count = 0;
+
+// Runs for every request the page issues, including redirects. Returning
+// TRUE cancels the request; blocked requests with a stand-in resource are
+// sent to the browser's resource scheme instead.
+static gboolean on_send_request(WebKitWebPage *web_page, WebKitURIRequest *request,
+                                WebKitURIResponse *redirected_response, gpointer user_data) {
+  if (!blocking_enabled) return FALSE;
+
+  const char *uri = webkit_uri_request_get_uri(request);
+  if (!uri) return FALSE;
+
+  // The main resource was already checked by on_decide_policy
+  const char *page_uri = webkit_web_page_get_uri(web_page);
+  if (page_uri && strcmp(uri, page_uri) == 0) return FALSE;
+
+  // WebKit sends Sec-Fetch-Dest on HTTP requests; without it the blocker
+  // guesses the type from the URL
+  SoupMessageHeaders *headers = webkit_uri_request_get_http_headers(request);
+  RequestContext context;
+  context.uri = uri;
+  context.first_party = page_uri;
+  context.type = headers ? network_blocker_type_from_destination(
+                               soup_message_headers_get_one(headers, "Sec-Fetch-Dest"))
+                         : 0;
+  context.third_party = -1;
+  BlockMatch match;
+  if (!should_block_request_context(&context, &match)) return FALSE;
+
+  blocked_requests_count++;
+  if (blocked_requests_count % 100 == 0) {
+    g_print("Web Extension: Blocked %lu subresource requests\n", blocked_requests_count);
+    network_blocker_log_cache_stats();
+  }
+
+  const RedirectResource *resource = redirect_resource_for_request(
+      uri, context.type, match.layer == BLOCK_LAYER_EASYLIST ? match.rule : NULL);
+  if (resource) {
+    gchar *target = redirect_resource_build_uri(resource);
+    webkit_uri_request_set_uri(request, target);
+    g_free(target);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static void on_page_created(WebKitWebExtension *extension, WebKitWebPage *web_page,
+                            gpointer user_data) {
+  g_signal_connect(web_page, "send-request", G_CALLBACK(on_send_request), NULL);
+}
+
+static void load_site_allowlist() {
+  gchar *path = snapshot_build_path(SITE_ALLOWLIST_FILE);
+  site_allowlist_load(path);
+  g_free(path);
+}
+
+static void on_rules_reloaded(GObject *source, GAsyncResult *result, gpointer user_data) {
+  if (adblockplus_reload_finish(result, NULL)) {
+    network_blocker_invalidate_cache();
+  }
+}
+
+static gboolean on_user_message(WebKitWebExtension *extension, WebKitUserMessage *message,
+                                gpointer user_data) {
+  const char *name = webkit_user_message_get_name(message);
+  if (g_strcmp0(name, WEB_EXTENSION_MESSAGE_RELOAD) == 0) {
+    adblockplus_reload_async(on_rules_reloaded, NULL);
+    return TRUE;
+  }
+  if (g_strcmp0(name, WEB_EXTENSION_MESSAGE_ALLOWLIST) == 0) {
+    load_site_allowlist();
+    return TRUE;
+  }
+  if (g_strcmp0(name, WEB_EXTENSION_MESSAGE_DUMP_STATS) == 0) {
+    gchar *file = g_strdup_printf("rule_stats-%d.tsv", (int)getpid());
+    gchar *path = snapshot_build_path(file);
+    network_blocker_dump_stats(path);
+    g_free(path);
+    g_free(file);
+    if (rule_profiler_enabled()) {
+      file = g_strdup_printf("rule_profile-%d.tsv", (int)getpid());
+      path = snapshot_build_path(file);
+      rule_profiler_write_report(path);
+      g_free(path);
+      g_free(file);
+    }
+    return TRUE;
+  }
+  if (g_strcmp0(name, WEB_EXTENSION_MESSAGE_SET_ENABLED) != 0) {
+    return FALSE;
+  }
+
+  GVariant *parameters = webkit_user_message_get_parameters(message);
+  if (parameters && g_variant_is_of_type(parameters, G_VARIANT_TYPE_BOOLEAN)) {
+    blocking_enabled = g_variant_get_boolean(parameters);
+    network_blocker_invalidate_cache();
+  }
+  return TRUE;
+}
+
+// Entry point called by WebKit when the web process starts. The compiled
+// filter snapshots are memory-mapped, so every web process shares the
+// browser's tables instead of parsing the lists again.
+extern "C" G_MODULE_EXPORT void webkit_web_extension_initialize_with_user_data(
+    WebKitWebExtension *extension, GVariant *user_data) {
+  if (user_data && g_variant_is_of_type(user_data, G_VARIANT_TYPE_BOOLEAN)) {
+    blocking_enabled = g_variant_get_boolean(user_data);
+  }
+
+  adblockplus_init();
+  network_blocker_init();
+  load_site_allowlist();
+
+  g_signal_connect(extension, "page-created", G_CALLBACK(on_page_created), NULL);
+  g_signal_connect(extension, "user-message-received", G_CALLBACK(on_user_message), NULL);
+  g_print("Web Extension: Subresource blocking %s\n", blocking_enabled ? "enabled" : "disabled");
+}
@@ -0,0 +1,28 @@
+#ifndef WEB_EXTENSION_H
+#define WEB_EXTENSION_H
+
+// Shared between the browser and the blocker web extension, which WebKit
+// loads into every web process to match subresource requests there.
+
+// Directory holding the extension library, relative to the working directory
+#define WEB_EXTENSION_DIR "web-extensions"
+
+// Message telling running web processes to turn blocking on or off. Its
+// parameter is a boolean GVariant; new processes get the same value as
+// their initialization user data.
+#define WEB_EXTENSION_MESSAGE_SET_ENABLED "blocker-set-enabled"
+
+// Message telling running web processes that the filter lists changed and
+// the browser has written a new compiled snapshot to map
+#define WEB_EXTENSION_MESSAGE_RELOAD "blocker-reload"
+
+// Message telling running web processes that the browser rewrote the site
+// allowlist file and they should load it again
+#define WEB_EXTENSION_MESSAGE_ALLOWLIST "blocker-allowlist-changed"
+
+// Message asking running web processes to write their rule hit counters
+// next to the browser's, as rule_stats-<pid>.tsv, and their rule costs as
+// rule_profile-<pid>.tsv when profiling
+#define WEB_EXTENSION_MESSAGE_DUMP_STATS "blocker-dump-stats"
+
+#endif // WEB_EXTENSION_H
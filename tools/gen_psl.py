@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+# Compile the Public Suffix List into a perfect-hash table for
+# fang/public_suffix.cc. Every rule and every suffix of a rule gets exactly
+# one slot, found through one displacement lookup, so a host is resolved
+# with one probe per label and no allocation.
+#
+# Usage: gen_psl.py public_suffix_list.dat fang/public_suffix_data.inc
+import sys
+
+# Entry flags, mirrored in fang/public_suffix.cc
+PSL_RULE = 1        # "example.com" is a public suffix
+PSL_WILDCARD = 2    # "*.example.com": every child of the key is one
+PSL_EXCEPTION = 4   # "!www.example.com": the key is not one
+
+FNV_OFFSET = 0x811c9dc5
+FNV_PRIME = 0x01000193
+GOLDEN = 0x9e3779b9
+MASK = 0xffffffff
+
+
+def fnv1a(data):
+    h = FNV_OFFSET
+    for b in data:
+        h = ((h ^ b) * FNV_PRIME) & MASK
+    return h
+
+
+def mix(h):
+    # murmur3 finalizer
+    h ^= h >> 16
+    h = (h * 0x85ebca6b) & MASK
+    h ^= h >> 13
+    h = (h * 0xc2b2ae35) & MASK
+    h ^= h >> 16
+    return h
+
+
+def slot_of(h, d, size):
+    # multiply-shift range reduction, so the table needs no power-of-two size
+    return (mix(h ^ ((d * GOLDEN) & MASK)) * size) >> 32
+
+
+def to_ascii(rule):
+    labels = []
+    for label in rule.split("."):
+        try:
+            label.encode("ascii")
+            labels.append(label)
+        except UnicodeEncodeError:
+            labels.append("xn--" + label.encode("punycode").decode("ascii"))
+    return ".".join(labels).lower()
+
+
+def load_rules(path):
+    entries = {}
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.strip().split()[0] if line.strip() else ""
+            if not line or line.startswith("//"):
+                continue
+            flag = PSL_RULE
+            if line.startswith("!"):
+                flag, line = PSL_EXCEPTION, line[1:]
+            elif line.startswith("*."):
+                flag, line = PSL_WILDCARD, line[2:]
+            key = to_ascii(line)
+            entries[key] = entries.get(key, 0) | flag
+
+    # Intermediate suffixes let a lookup stop at the first label that no
+    # rule continues from
+    for key in list(entries):
+        labels = key.split(".")
+        for i in range(1, len(labels)):
+            entries.setdefault(".".join(labels[i:]), 0)
+    return entries
+
+
+def build_table(keys):
+    size = int(len(keys) * 1.1) + 1
+    n_buckets = 1
+    while n_buckets * 4 < len(keys):
+        n_buckets *= 2
+
+    hashes = {k: fnv1a(k.encode("ascii")) for k in keys}
+    buckets = [[] for _ in range(n_buckets)]
+    for k in keys:
+        buckets[hashes[k] & (n_buckets - 1)].append(k)
+
+    slots = [None] * size
+    displacements = [0] * n_buckets
+    for b in sorted(range(n_buckets), key=lambda b: -len(buckets[b])):
+        members = buckets[b]
+        if not members:
+            break
+        for d in range(1 << 16):
+            taken = set()
+            for k in members:
+                s = slot_of(hashes[k], d, size)
+                if slots[s] is not None or s in taken:
+                    break
+                taken.add(s)
+            else:
+                for k in members:
+                    slots[slot_of(hashes[k], d, size)] = k
+                displacements[b] = d
+                break
+        else:
+            sys.exit("gen_psl: no displacement for bucket %d" % b)
+    return slots, displacements
+
+
+def c_string(data):
+    out = []
+    for ch in data:
+        out.append(ch if ch not in '"\\' else "\\" + ch)
+    return "".join(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: gen_psl.py public_suffix_list.dat output.inc")
+    entries = load_rules(sys.argv[1])
+    keys = sorted(entries)
+    slots, displacements = build_table(keys)
+
+    # Only keys that no other key ends with are stored; the rest point into
+    # the tail of a longer one ("co.uk" inside "blogspot.co.uk")
+    parents = set()
+    for k in keys:
+        labels = k.split(".")
+        for i in range(1, len(labels)):
+            parents.add(".".join(labels[i:]))
+    pool = []
+    offsets = {}
+    pos = 0
+    for k in keys:
+        if k in parents:
+            continue
+        pool.append(k)
+        start = 0
+        while True:
+            offsets.setdefault(k[start:], pos + start)
+            dot = k.find(".", start)
+            if dot < 0:
+                break
+            start = dot + 1
+        pos += len(k)
+    if any(len(k) > 255 for k in keys) or pos >= 1 << 21:
+        sys.exit("gen_psl: table too large for packed entries")
+
+    with open(sys.argv[2], "w") as out:
+        out.write("// Generated by tools/gen_psl.py from the Public Suffix List. Do not edit.\n")
+        out.write("// %d entries\n\n" % len(keys))
+        out.write("#define PSL_TABLE_SIZE %du\n" % len(slots))
+        out.write("#define PSL_BUCKET_COUNT %du\n\n" % len(displacements))
+        out.write("static const char PSL_POOL[] =\n")
+        line = ""
+        for k in pool:
+            if len(line) + len(k) > 72:
+                out.write('  "%s"\n' % c_string(line))
+                line = ""
+            line += k
+        out.write('  "%s";\n\n' % c_string(line))
+        out.write("static const guint16 PSL_DISPLACEMENTS[PSL_BUCKET_COUNT] = {\n")
+        for i in range(0, len(displacements), 12):
+            out.write("  " + ", ".join(str(d) for d in displacements[i:i + 12]) + ",\n")
+        out.write("};\n\n")
+        # Each slot packs pool offset << 11 | length << 3 | flags; empty
+        # slots are 0
+        out.write("static const guint32 PSL_ENTRIES[PSL_TABLE_SIZE] = {\n")
+        packed = [0 if k is None else (offsets[k] << 11) | (len(k) << 3) | entries[k] for k in slots]
+        for i in range(0, len(packed), 8):
+            out.write("  " + ", ".join("0x%08x" % v for v in packed[i:i + 8]) + ",\n")
+        out.write("};\n")
+    print("gen_psl: %d entries in %d slots" % (len(keys), len(slots)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+# Compile the built-in lists in fang/lists into static C++ tables, so they
+# need no initialization at startup and their sizes are known at compile
+# time. Each table is NAME:KIND:list.txt, where KIND is
+#
+#   strings    NAME[] (NULL-terminated) and its length NAME_COUNT
+#   domains    the same plus a perfect-hash table of the domains, looked up
+#              with one probe per host label (see fang/perfect_hash.h)
+#   selectors  the same plus NAME_CSS, one rule hiding every selector
+#
+# Lists hold one entry per line; blank lines and lines starting with "!"
+# are skipped.
+#
+# Usage: gen_tables.py output.inc NAME:KIND:list.txt...
+import sys
+
+from gen_psl import build_table, c_string
+
+# Longest domain a packed table slot can hold
+MAX_DOMAIN_LEN = 255
+
+
+def load_list(path):
+    entries = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            line = line.strip()
+            if line and not line.startswith("!"):
+                entries.append(line)
+    return entries
+
+
+def write_strings(out, name, entries):
+    # A constant rather than a macro, so a header can declare it extern
+    out.write("const guint %s_COUNT = %d;\n\n" % (name, len(entries)))
+    out.write("const char *%s[%s_COUNT + 1] = {\n" % (name, name))
+    for entry in entries:
+        out.write('  "%s",\n' % c_string(entry))
+    out.write("  NULL\n};\n\n")
+
+
+def split_domain(entry):
+    # Same normalization as domain_set_add: "*.x" and ".x" are suffix
+    # entries, a trailing "/" or "." is dropped
+    text = entry.lower()
+    if text.startswith("*."):
+        text = text[2:]
+    elif text.startswith("."):
+        text = text[1:]
+    slash = text.find("/")
+    if slash < 0 or slash == len(text) - 1:
+        return text.rstrip("/").rstrip("."), None
+    return text[:slash].rstrip("."), text
+
+
+def write_domains(out, name, entries):
+    write_strings(out, name, entries)
+
+    # A whole-domain entry supersedes path-restricted ones for the domain
+    paths = {}
+    whole = set()
+    for entry in entries:
+        domain, full = split_domain(entry)
+        if not domain or len(domain) > MAX_DOMAIN_LEN:
+            sys.exit("gen_tables: unusable domain %r in %s" % (entry, name))
+        if full is None:
+            whole.add(domain)
+        else:
+            paths.setdefault(domain, []).append(full)
+    keys = sorted(whole | set(paths))
+    slots, displacements = build_table(keys)
+
+    path_list = []
+    first_path = {}
+    for domain in keys:
+        if domain in whole:
+            continue
+        first_path[domain] = len(path_list)
+        path_list.extend(paths[domain])
+
+    out.write("#define %s_TABLE_SIZE %du\n" % (name, len(slots)))
+    out.write("#define %s_BUCKET_COUNT %du\n\n" % (name, len(displacements)))
+    out.write("static const guint16 %s_DISPLACEMENTS[%s_BUCKET_COUNT] = {\n" % (name, name))
+    for i in range(0, len(displacements), 12):
+        out.write("  " + ", ".join(str(d) for d in displacements[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+
+    # Path entries keep their full text, which is what a match reports
+    out.write("static const BuiltinPath %s_PATHS[] = {\n" % name)
+    for full in path_list:
+        out.write('  { "%s", %d },\n' % (c_string(full), len(full) - full.find("/")))
+    out.write("  { NULL, 0 }\n};\n\n")
+
+    out.write("static const BuiltinDomain %s_TABLE[%s_TABLE_SIZE] = {\n" % (name, name))
+    for domain in slots:
+        if domain is None:
+            out.write("  { NULL, 0, 0, 0 },\n")
+        elif domain in whole:
+            out.write('  { "%s", %d, 0, 0 },\n' % (c_string(domain), len(domain)))
+        else:
+            out.write('  { "%s", %d, %d, %d },\n' % (c_string(domain), len(domain),
+                                                    first_path[domain], len(paths[domain])))
+    out.write("};\n\n")
+    return len(keys)
+
+
+def write_selectors(out, name, entries):
+    write_strings(out, name, entries)
+    out.write("static const char %s_CSS[] =\n" % name)
+    line = ""
+    for i, selector in enumerate(entries):
+        part = selector + (", " if i + 1 < len(entries) else "")
+        if line and len(line) + len(part) > 72:
+            out.write('  "%s"\n' % c_string(line))
+            line = ""
+        line += part
+    out.write('  "%s"\n' % c_string(line))
+    out.write('  " { display: none !important; visibility: hidden !important; }";\n\n')
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit("usage: gen_tables.py output.inc NAME:KIND:list.txt...")
+
+    with open(sys.argv[1], "w") as out:
+        out.write("// Generated by tools/gen_tables.py from fang/lists. Do not edit.\n\n")
+        for spec in sys.argv[2:]:
+            name, kind, path = spec.split(":", 2)
+            entries = load_list(path)
+            out.write("// %s: %d entries from %s\n" % (name, len(entries), path))
+            if kind == "strings":
+                write_strings(out, name, entries)
+            elif kind == "domains":
+                keys = write_domains(out, name, entries)
+                print("gen_tables: %s: %d domains in a perfect-hash table" % (name, keys))
+            elif kind == "selectors":
+                write_selectors(out, name, entries)
+            else:
+                sys.exit("gen_tables: unknown table kind %r" % kind)
+
+
+if __name__ == "__main__":
+    main()
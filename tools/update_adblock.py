@@ -24,6 +24,44 @@ SOURCES = {
     ]
 }
 
+# Raw filter lists kept for the native AdblockPlus engine
+RAW_LISTS = {
+    "ads": "fang/easylist.txt",
+    "privacy": "fang/easyprivacy.txt",
+    "unbreak": "fang/unbreak.txt"
+}
+
+# Filter options content filters can express, as trigger fields. Filters
+# with any other option (redirect=, domain=, important, csp=, ...) are left
+# to the native engine: as a plain block rule they would block everywhere,
+# ahead of the web extension.
+LOAD_TYPES = {
+    "third-party": "third-party",
+    "3p": "third-party",
+    "~third-party": "first-party",
+    "first-party": "first-party",
+    "1p": "first-party"
+}
+RESOURCE_TYPES = {
+    "script": "script",
+    "image": "image",
+    "stylesheet": "style-sheet",
+    "css": "style-sheet",
+    "font": "font",
+    "media": "media",
+    "subdocument": "document",
+    "frame": "document",
+    "xmlhttprequest": "raw",
+    "xhr": "raw",
+    "websocket": "raw",
+    "other": "raw",
+    "ping": "ping",
+    "popup": "popup"
+}
+
+# Scriptlet filters of the other lists, which the browser runs itself
+SCRIPTLETS_FILE = "fang/scriptlets.txt"
+
 def download_list(url):
     print(f"Downloading {url}...")
     try:
@@ -33,11 +71,34 @@ def download_list(url):
         print(f"Error downloading {url}: {e}")
         return ""
 
+def is_scriptlet_rule(line):
+    return "##+js(" in line or "#@#+js(" in line
+
+def parse_options(options):
+    trigger = {}
+    types = set()
+    for option in options.split(","):
+        option = option.strip().lower()
+        if option in LOAD_TYPES:
+            trigger["load-type"] = [LOAD_TYPES[option]]
+        elif option in RESOURCE_TYPES:
+            types.add(RESOURCE_TYPES[option])
+        else:
+            return None
+    if types:
+        trigger["resource-type"] = sorted(types)
+    return trigger
+
 def parse_adblock_rule(line):
     line = line.strip()
     if not line or line.startswith("!") or line.startswith("["):
         return None
 
+    # Scriptlets and HTML filters are not CSS; a selector WebKit cannot
+    # parse fails the whole content filter
+    if is_scriptlet_rule(line) or "##^" in line:
+        return None
+
     # Handle element hiding rules: example.com##.ad
     if "##" in line:
         parts = line.split("##", 1)
@@ -71,10 +132,10 @@ def parse_adblock_rule(line):
     # Handle basic blocking rules
     # ||example.com^
     if line.startswith("||"):
-        pattern = line[2:]
-        # Remove options for now to get the domain/pattern
-        if "$" in pattern:
-            pattern = pattern.split("$")[0]
+        pattern, _, options = line[2:].partition("$")
+        option_trigger = parse_options(options) if options else {}
+        if option_trigger is None:
+            return None
         
         # Handle the ^ separator
         pattern = pattern.replace("^", "")
@@ -85,10 +146,10 @@ def parse_adblock_rule(line):
                  # Ensure lowercase and punycode for domains
                  domain = pattern.lower().encode('idna').decode('ascii')
                  return {
-                    "trigger": {
+                    "trigger": dict({
                         "url-filter": ".*",
                         "if-domain": [domain]
-                    },
+                    }, **option_trigger),
                     "action": {
                         "type": "block"
                     }
@@ -104,14 +165,16 @@ def parse_adblock_rule(line):
         
         # WebKit doesn't like some regex features. 
         # If it contains |, it might be problematic if not carefully constructed.
-        # For now, let's skip rules with | to avoid "Disjunctions are not supported" if that's the issue.
+        # Skip rules with | to avoid "Disjunctions are not supported"; the
+        # native engine still matches them (and /regex/ rules) from the raw
+        # lists saved below.
         if "|" in regex:
             return None
 
         return {
-            "trigger": {
+            "trigger": dict({
                 "url-filter": ".*" + regex + ".*"
-            },
+            }, **option_trigger),
             "action": {
                 "type": "block"
             }
@@ -123,17 +186,22 @@ def main():
     # Ensure output directory exists
     os.makedirs(os.path.dirname(OUTPUT_FILE), exist_ok=True)
 
+    scriptlet_rules = []
     for category, urls in SOURCES.items():
         category_rules = []
+        raw_contents = []
         print(f"Processing category: {category}...")
         
         for url in urls:
             content = download_list(url)
+            raw_contents.append(content)
             lines = content.splitlines()
             print(f"Processing {len(lines)} lines from {url}...")
             
             count = 0
             for line in lines:
+                if category not in RAW_LISTS and is_scriptlet_rule(line):
+                    scriptlet_rules.append(line.strip())
                 rule = parse_adblock_rule(line)
                 if rule:
                     category_rules.append(rule)
@@ -145,5 +213,17 @@ def main():
             json.dump(category_rules, f, indent=2)
         print(f"Saved {len(category_rules)} rules to {output_filename}")
 
+        if category in RAW_LISTS:
+            with open(RAW_LISTS[category], "w") as f:
+                f.write("\n".join(raw_contents))
+            print(f"Saved raw filter list to {RAW_LISTS[category]}")
+
+    # Raw lists carry their own scriptlet filters
+    with open(SCRIPTLETS_FILE, "w") as f:
+        f.write("! Scriptlet filters of the lists compiled to WebKit content filters, which\n")
+        f.write("! cannot express them. Written by tools/update_adblock.py.\n")
+        f.write("\n".join(scriptlet_rules) + "\n")
+    print(f"Saved {len(scriptlet_rules)} scriptlet filters to {SCRIPTLETS_FILE}")
+
 if __name__ == "__main__":
     main()